@@ -5,6 +5,12 @@
    Collisions are circumvented via "open addressing: linear probing", i.e. just keep walking down the 
    table and insert the new item into the leading empty slot.
 
+   There is also a concurrent mode (the conc_* functions) where the slots are read and written with
+   atomic operations, so any number of threads can look records up while others insert, replace and
+   delete them. A record that gets deleted or replaced may still be in use by a reader that found it
+   just before, so it's not freed right away but retired, and epoch-based reclamation frees it once
+   every thread has left the critical section it might have been found in.
+
 */
 
 
@@ -12,6 +18,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
 
 // fixed parameters
 #define MAX_NAME 256
@@ -36,6 +44,28 @@ person * hash_table[TABLE_SIZE];
 #define DELETED_NODE (person*)(0xFFFFFFFFFFFFFFFFUL)
 
 
+// epoch-based reclamation state for the concurrent mode
+#define MAX_THREADS 16
+
+uint64_t global_epoch = 0;
+
+// per thread: (epoch << 1) | 1 while inside a critical section, 0 outside
+uint64_t thread_epoch[MAX_THREADS];
+
+// per thread: records retired during each of the last three epochs ("limbo bags")
+typedef struct
+{
+    person **records;
+    int n, max;
+    uint64_t epoch;
+
+} limbo_bag;
+
+limbo_bag limbo[MAX_THREADS][3];
+
+uint64_t records_retired = 0, records_freed = 0;
+
+
 
 // hash function
 unsigned int hash(char *name)
@@ -142,7 +172,7 @@ person *hash_table_lookup(char *name)
         
         if(hash_table[try] != NULL && strncmp(hash_table[try]->name, name, MAX_NAME) == 0)
         {
-            return hash_table[index];
+            return hash_table[try];
         }
     }
 
@@ -187,6 +217,383 @@ person *hash_table_delete(char *name)
 
 
 
+/*
+    Concurrent mode
+*/
+
+// enter a critical section: records found before the matching ebr_exit() stay valid until then
+void ebr_enter(int tid)
+{
+    uint64_t e = __atomic_load_n(&global_epoch, __ATOMIC_ACQUIRE);
+
+    // the announcement has to be visible before any slot gets read
+    __atomic_store_n(&thread_epoch[tid], (e << 1) | 1, __ATOMIC_SEQ_CST);
+}
+
+
+void ebr_exit(int tid)
+{
+    __atomic_store_n(&thread_epoch[tid], 0, __ATOMIC_RELEASE);
+}
+
+
+// advance the global epoch if every thread inside a critical section has seen the current one
+void ebr_try_advance()
+{
+    uint64_t e = __atomic_load_n(&global_epoch, __ATOMIC_ACQUIRE);
+    int i;
+
+    for(i = 0; i < MAX_THREADS; i++)
+    {
+        uint64_t t = __atomic_load_n(&thread_epoch[i], __ATOMIC_SEQ_CST);
+
+        if((t & 1) && (t >> 1) != e) return;
+    }
+
+    __atomic_compare_exchange_n(&global_epoch, &e, e + 1, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED);
+}
+
+
+// free the records of tid's bags that were retired at least two epochs ago
+void ebr_reclaim(int tid)
+{
+    uint64_t e = __atomic_load_n(&global_epoch, __ATOMIC_ACQUIRE);
+    int b, i;
+
+    for(b = 0; b < 3; b++)
+    {
+        limbo_bag *bag = &limbo[tid][b];
+
+        if(bag->n == 0 || bag->epoch + 2 > e) continue;
+
+        for(i = 0; i < bag->n; i++)
+        {
+            free(bag->records[i]);
+        }
+
+        __atomic_fetch_add(&records_freed, bag->n, __ATOMIC_RELAXED);
+        bag->n = 0;
+    }
+}
+
+
+// hand over a record that was unlinked from the table, it gets freed once no reader can hold it anymore
+// (returns false if it can't be, then it's left allocated)
+bool ebr_retire(int tid, person *p)
+{
+    if(tid < 0 || tid >= MAX_THREADS)
+    {
+        printf("\n WARNING!!! Invalid thread id %i. Unable to retire %s. \n",tid,p->name);
+        return false;
+    }
+
+    // the global epoch after the unlink: a reader that can still hold p entered no later than this
+    // epoch, and the global epoch only gets two further once all of those have left
+    uint64_t e = __atomic_load_n(&global_epoch, __ATOMIC_ACQUIRE);
+    limbo_bag *bag = &limbo[tid][e % 3];
+
+    ebr_try_advance();
+    ebr_reclaim(tid);
+
+    // whatever was left in this bag is from three epochs ago, so it's been reclaimed just now
+    bag->epoch = e;
+
+    if(bag->n == bag->max)
+    {
+        int max = (bag->max > 0) ? 2 * bag->max : 64;
+        person **records = realloc(bag->records, max * sizeof(person *));
+
+        if(records == NULL)
+        {
+            printf("\n WARNING!!! Out of memory. Unable to retire %s. \n",p->name);
+            return false;
+        }
+
+        bag->records = records;
+        bag->max = max;
+    }
+
+    bag->records[bag->n++] = p;
+    __atomic_fetch_add(&records_retired, 1, __ATOMIC_RELAXED);
+
+    return true;
+}
+
+
+// free every retired record, only when no other thread is using the table anymore
+void ebr_drain()
+{
+    int t, b, i;
+
+    for(t = 0; t < MAX_THREADS; t++)
+    {
+        for(b = 0; b < 3; b++)
+        {
+            for(i = 0; i < limbo[t][b].n; i++)
+            {
+                free(limbo[t][b].records[i]);
+            }
+            records_freed += limbo[t][b].n;
+
+            free(limbo[t][b].records);
+            limbo[t][b] = (limbo_bag) {NULL, 0, 0, 0};
+        }
+    }
+}
+
+
+// p has to be allocated with malloc(), the table frees it after it gets deleted or replaced
+bool conc_insert(person *p)
+{
+    if(p == NULL) return false;
+
+    int index = hash(p->name);
+    int i;
+
+    for(i = 0; i < TABLE_SIZE; i++)
+    {
+        int try = (i + index) % TABLE_SIZE;
+        person *slot = __atomic_load_n(&hash_table[try], __ATOMIC_ACQUIRE);
+
+        // retry this slot if someone else got to it first
+        while(slot == NULL || slot == DELETED_NODE)
+        {
+            if(__atomic_compare_exchange_n(&hash_table[try], &slot, p, false, __ATOMIC_RELEASE, __ATOMIC_ACQUIRE)) return true;
+        }
+    }
+
+    printf("\n WARNING!!! Unable to insert %s. Ran out of empty slots. \n",p->name);
+    return false;
+}
+
+
+// wait-free: at most TABLE_SIZE slot reads, call it between ebr_enter() and ebr_exit(), the result is valid until the latter
+person *conc_lookup(char *name)
+{
+    int index = hash(name);
+    int i;
+
+    for(i = 0; i < TABLE_SIZE; i++)
+    {
+        int try = (i + index) % TABLE_SIZE;
+        person *slot = __atomic_load_n(&hash_table[try], __ATOMIC_ACQUIRE);
+
+        if(slot == NULL) break; // not found
+
+        if(slot == DELETED_NODE) continue;
+
+        if(strncmp(slot->name, name, MAX_NAME) == 0) return slot;
+    }
+
+    return NULL;
+}
+
+
+// swap the record of p->name for p, the old one is retired (returns false if name isn't in the table)
+bool conc_replace(int tid, person *p)
+{
+    int index = hash(p->name);
+    int i;
+
+    for(i = 0; i < TABLE_SIZE; i++)
+    {
+        int try = (i + index) % TABLE_SIZE;
+        person *slot = __atomic_load_n(&hash_table[try], __ATOMIC_ACQUIRE);
+
+        if(slot == NULL) break;
+
+        if(slot == DELETED_NODE || strncmp(slot->name, p->name, MAX_NAME) != 0) continue;
+
+        // names of records in a slot never change, so a failed swap means a concurrent replace or delete
+        while(slot != NULL && slot != DELETED_NODE)
+        {
+            if(__atomic_compare_exchange_n(&hash_table[try], &slot, p, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+            {
+                ebr_retire(tid, slot);
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    return false;
+}
+
+
+bool conc_delete(int tid, char *name)
+{
+    int index = hash(name);
+    int i;
+
+    for(i = 0; i < TABLE_SIZE; i++)
+    {
+        int try = (i + index) % TABLE_SIZE;
+        person *slot = __atomic_load_n(&hash_table[try], __ATOMIC_ACQUIRE);
+
+        if(slot == NULL) break;
+
+        if(slot == DELETED_NODE || strncmp(slot->name, name, MAX_NAME) != 0) continue;
+
+        if(__atomic_compare_exchange_n(&hash_table[try], &slot, DELETED_NODE, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        {
+            ebr_retire(tid, slot);
+            return true;
+        }
+
+        // lost to a concurrent replace (look again) or delete (gone)
+        if(slot == NULL || slot == DELETED_NODE) return false;
+        i--;
+    }
+
+    return false;
+}
+
+
+
+// concurrent demo: readers keep looking records up while several writers keep replacing them
+#define DEMO_READERS 3
+#define DEMO_WRITERS 3
+#define DEMO_UPDATES 100000 // per writer
+
+char *demo_names[] = {"Tanzid", "Andrew", "Kyle", "Matt", "Patrick"};
+bool demo_done = false;
+long demo_nbad = 0;
+
+person *new_person(char *name, int age)
+{
+    person *p = malloc(sizeof(person));
+
+    snprintf(p->name, MAX_NAME, "%s", name);
+    p->age = age;
+
+    return p;
+}
+
+
+void *demo_reader(void *arg)
+{
+    int tid = (int) (intptr_t) arg;
+    long nfound = 0, nbad = 0;
+    int i = 0;
+
+    while(!__atomic_load_n(&demo_done, __ATOMIC_ACQUIRE))
+    {
+        ebr_enter(tid);
+
+        char *name = demo_names[i++ % 5];
+        person *p = conc_lookup(name);
+
+        // a retired record must still be intact here
+        if(p != NULL)
+        {
+            nfound++;
+            if(strncmp(p->name, name, MAX_NAME) != 0 || p->age < 0) nbad++;
+        }
+
+        ebr_exit(tid);
+    }
+
+    printf(" Reader %i: %ld lookups found, %ld corrupted records. \n",tid,nfound,nbad);
+    __atomic_fetch_add(&demo_nbad, nbad, __ATOMIC_RELAXED);
+    return NULL;
+}
+
+
+// all writers replace any of the records, but only the owner of a name deletes and re-inserts it,
+// so a name is never in the table twice
+void *demo_writer(void *arg)
+{
+    int tid = (int) (intptr_t) arg;
+    int w = tid - DEMO_READERS;
+    int i;
+
+    for(i = 0; i < DEMO_UPDATES; i++)
+    {
+        int n = (i + w) % 5;
+        char *name = demo_names[n];
+
+        ebr_enter(tid);
+
+        // every 8th update of an own name deletes and re-inserts instead of replacing
+        if(n % DEMO_WRITERS == w && i % 8 == 7)
+        {
+            conc_delete(tid, name);
+            conc_insert(new_person(name, i));
+        }
+        else
+        {
+            person *p = new_person(name, i);
+
+            // the owner has it deleted just now
+            if(!conc_replace(tid, p)) free(p);
+        }
+
+        ebr_exit(tid);
+    }
+
+    return NULL;
+}
+
+
+// returns false if a reader saw a freed record or retired records went missing
+bool concurrent_demo()
+{
+    pthread_t readers[DEMO_READERS], writers[DEMO_WRITERS];
+    int i;
+
+    init_hash_table();
+
+    for(i = 0; i < 5; i++)
+    {
+        conc_insert(new_person(demo_names[i], 20 + i));
+    }
+
+    for(i = 0; i < DEMO_READERS; i++)
+    {
+        pthread_create(&readers[i], NULL, demo_reader, (void *) (intptr_t) i);
+    }
+
+    for(i = 0; i < DEMO_WRITERS; i++)
+    {
+        pthread_create(&writers[i], NULL, demo_writer, (void *) (intptr_t) (DEMO_READERS + i));
+    }
+
+    for(i = 0; i < DEMO_WRITERS; i++)
+    {
+        pthread_join(writers[i], NULL);
+    }
+
+    __atomic_store_n(&demo_done, true, __ATOMIC_RELEASE);
+
+    for(i = 0; i < DEMO_READERS; i++)
+    {
+        pthread_join(readers[i], NULL);
+    }
+
+    printf("\n %lu of %lu retired records freed while the readers were running. \n",records_freed,records_retired);
+
+    ebr_drain();
+
+    int nrecords = 0;
+    for(i = 0; i < TABLE_SIZE; i++)
+    {
+        if(hash_table[i] != NULL && hash_table[i] != DELETED_NODE)
+        {
+            free(hash_table[i]);
+            nrecords++;
+        }
+        hash_table[i] = NULL;
+    }
+
+    bool ok = (demo_nbad == 0 && records_freed == records_retired && nrecords == 5);
+    printf("\n %s \n\n",ok ? "All checks passed." : "Some checks FAILED.");
+
+    return ok;
+}
+
+
+
 int main()
 {
 
@@ -258,8 +665,12 @@ int main()
     hash_table_delete("Tom");
 
 
+    printf("\n Concurrent mode \n");
+    bool ok = concurrent_demo();
+
+
 
-    return 0;
+    return ok ? 0 : 1;
 
 }
 
@@ -0,0 +1,277 @@
+/*
+    Implementation of a separately chained hash table.
+
+    Every bucket holds the head of a singly linked list of the items that hash to it, so the table
+    keeps working (with chains of average length load) well above 100% load, and deletes unlink
+    and recycle a node instead of leaving tombstones behind. Nodes come from a pool (slab) inside
+    the table memory, allocated from a free list of released nodes, or else by bumping a counter
+    over the never used rest of the pool, so nothing is allocated with malloc() per item and
+    links are 64-bit node indices rather than pointers (the table can be copied or mapped anywhere).
+
+    With inline_first set, the first item of a chain is stored in the bucket itself, which saves
+    the pointer chase for the (common) chains of length 1 at the cost of larger buckets.
+
+    Memory layout of the table (starting at base_ptr):
+
+        [nbuckets][nvals_per_item][max_items][inline_first][free_head][nfresh][nitems][buckets ...][pool ...]
+
+    where a bucket is just [head] or, with inline_first, [status][next][key][values...], and a
+    pool node is [next][key][values...].
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <assert.h>
+
+# include "hash.h"
+# include "chain.h"
+
+
+#define CHAIN_HEADER_WORDS 7
+
+
+
+static inline uint64_t
+bucket_words(const uint64_t nvals_per_item, const bool inline_first)
+{
+    return inline_first ? 1 + nvals_per_item : 1;
+}
+
+
+static inline uint64_t *
+get_bucket(const chain_table_t *table, const uint64_t b)
+{
+    return table->buckets + b * bucket_words(*(table->nvals_per_item), *(table->inline_first));
+}
+
+
+// node from a link (link = node index + 1)
+static inline uint64_t *
+get_node(const chain_table_t *table, const uint64_t link)
+{
+    return table->pool + (link - 1) * *(table->nvals_per_item);
+}
+
+
+// link to the head of the chain of bucket b (the first node after the inline item, with inline_first)
+static inline uint64_t *
+head_link(const chain_table_t *table, const uint64_t b)
+{
+    uint64_t *bucket = get_bucket(table, b);
+
+    return *(table->inline_first) ? bucket + 1 : bucket;
+}
+
+
+static uint64_t
+alloc_node(chain_table_t *table)
+{
+    uint64_t link = *(table->free_head);
+
+    if(link != CHAIN_NIL)
+    {
+        *(table->free_head) = get_node(table, link)[0];
+        return link;
+    }
+
+    if(*(table->nfresh) < *(table->max_items)) return ++(*(table->nfresh));
+
+    return CHAIN_NIL;
+}
+
+
+static inline void
+free_node(chain_table_t *table, const uint64_t link)
+{
+    get_node(table, link)[0] = *(table->free_head);
+    *(table->free_head) = link;
+}
+
+
+uint64_t
+chain_table_bytes(const uint64_t nbuckets, const uint64_t max_items, const uint64_t nvals_per_item, const bool inline_first)
+{
+    return (CHAIN_HEADER_WORDS + nbuckets * bucket_words(nvals_per_item, inline_first) + max_items * nvals_per_item) * sizeof(uint64_t);
+}
+
+
+void
+init_chain_table(chain_table_t *table, void *base_ptr, const uint64_t nbuckets, const uint64_t max_items, const uint64_t nvals_per_item, const bool inline_first)
+{
+    uint64_t b;
+
+    if(base_ptr == NULL)
+    {
+        printf("\n Invalid base_ptr provided. Unable to initilize chained table. \n");
+        return;
+    }
+
+    if(nbuckets < 1 || nvals_per_item < 3)
+    {
+        printf("\n Invalid nbuckets or nvals_per_item. Unable to initilize chained table. \n");
+        return;
+    }
+
+    /* map table into memory via the base_ptr */
+    table->nbuckets       = base_ptr;
+    table->nvals_per_item = (uint64_t *) base_ptr + 1;
+    table->max_items      = (uint64_t *) base_ptr + 2;
+    table->inline_first   = (uint64_t *) base_ptr + 3;
+    table->free_head      = (uint64_t *) base_ptr + 4;
+    table->nfresh         = (uint64_t *) base_ptr + 5;
+    table->nitems         = (uint64_t *) base_ptr + 6;
+    table->buckets        = (uint64_t *) base_ptr + CHAIN_HEADER_WORDS;
+    table->pool           = table->buckets + nbuckets * bucket_words(nvals_per_item, inline_first);
+
+    *(table->nbuckets)       = nbuckets;
+    *(table->nvals_per_item) = nvals_per_item;
+    *(table->max_items)      = max_items;
+    *(table->inline_first)   = inline_first;
+    *(table->free_head)      = CHAIN_NIL;
+    *(table->nfresh)         = 0;
+    *(table->nitems)         = 0;
+
+    /* the pool is left alone, nodes are only touched once they get handed out */
+    for(b = 0; b < nbuckets; b++)
+    {
+        get_bucket(table, b)[0] = 0;
+        if(inline_first) get_bucket(table, b)[1] = CHAIN_NIL;
+    }
+
+}
+
+
+uint64_t *
+chain_lookup_item(const chain_table_t *table, const uint64_t key)
+{
+
+    assert(table != NULL);
+
+    uint64_t b = hash(key, *(table->nbuckets));
+    uint64_t *bucket = get_bucket(table, b);
+    uint64_t link, *node;
+
+    if(*(table->inline_first))
+    {
+        if(bucket[0] == 0) return NULL; // empty bucket, so no chain either
+        if(bucket[2] == key) return bucket + 3;
+    }
+
+    for(link = *head_link(table, b); link != CHAIN_NIL; link = node[0])
+    {
+        node = get_node(table, link);
+        if(node[1] == key) return node + 2;
+    }
+
+    return NULL;
+
+}
+
+
+bool
+chain_insert_item(chain_table_t *table, const uint64_t key, const uint64_t *values)
+{
+
+    assert(table != NULL);
+
+    uint64_t nvals_per_item = *(table->nvals_per_item);
+    uint64_t b = hash(key, *(table->nbuckets));
+    uint64_t *bucket = get_bucket(table, b);
+    uint64_t j, link, *vals, *head;
+
+    /* existing key, just update the values */
+    vals = chain_lookup_item(table, key);
+
+    if(vals == NULL && *(table->inline_first) && bucket[0] == 0)
+    {
+        bucket[0] = 1;
+        bucket[2] = key;
+        vals = bucket + 3;
+        (*(table->nitems))++;
+    }
+    else if(vals == NULL)
+    {
+        link = alloc_node(table);
+        if(link == CHAIN_NIL)
+        {
+            printf("\n Warning! Unable to insert new item with key: %lu. Ran out of pool nodes. \n",key);
+            return false;
+        }
+
+        /* push the new node onto the front of the chain */
+        head = head_link(table, b);
+        get_node(table, link)[0] = *head;
+        get_node(table, link)[1] = key;
+        *head = link;
+
+        vals = get_node(table, link) + 2;
+        (*(table->nitems))++;
+    }
+
+    for(j = 0; j < nvals_per_item - 2; j++)
+    {
+        vals[j] = values[j];
+    }
+
+    return true;
+
+}
+
+
+bool
+chain_delete_item(chain_table_t *table, const uint64_t key)
+{
+
+    assert(table != NULL);
+
+    uint64_t nvals_per_item = *(table->nvals_per_item);
+    uint64_t b = hash(key, *(table->nbuckets));
+    uint64_t *bucket = get_bucket(table, b);
+    uint64_t j, link, *node, *prev;
+
+    if(*(table->inline_first) && bucket[0] == 1 && bucket[2] == key)
+    {
+        link = bucket[1];
+
+        if(link == CHAIN_NIL)
+        {
+            bucket[0] = 0;
+        }
+        else
+        {
+            /* move the first chained item into the bucket */
+            node = get_node(table, link);
+            bucket[1] = node[0];
+            for(j = 0; j < nvals_per_item - 1; j++)
+            {
+                bucket[2 + j] = node[1 + j];
+            }
+            free_node(table, link);
+        }
+
+        (*(table->nitems))--;
+        return true;
+    }
+
+    if(*(table->inline_first) && bucket[0] == 0) return false;
+
+    for(prev = head_link(table, b); *prev != CHAIN_NIL; prev = &node[0])
+    {
+        link = *prev;
+        node = get_node(table, link);
+
+        if(node[1] == key)
+        {
+            *prev = node[0]; // unlink
+            free_node(table, link);
+            (*(table->nitems))--;
+            return true;
+        }
+    }
+
+    return false;
+
+}
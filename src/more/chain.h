@@ -0,0 +1,31 @@
+
+
+// separately chained hash table: buckets hold the head of a linked list of nodes from a node pool
+#define CHAIN_NIL 0 // end of a chain (links hold node index + 1)
+
+
+typedef struct chain_table_st
+{
+    uint64_t * nbuckets;       // number of buckets
+    uint64_t * nvals_per_item; // number of values per item (status + key + values, same as hashtable_t)
+    uint64_t * max_items;      // number of nodes in the pool (may be larger than nbuckets)
+    uint64_t * inline_first;   // 1 if the first item of every chain lives in the bucket itself
+    uint64_t * free_head;      // link to the first node of the pool's free list
+    uint64_t * nfresh;         // number of pool nodes that have been handed out at least once
+    uint64_t * nitems;         // number of items in the table
+    uint64_t * buckets;        // bucket array
+    uint64_t * pool;           // node pool
+
+} chain_table_t;
+
+
+// function prototypes
+uint64_t chain_table_bytes(const uint64_t nbuckets, const uint64_t max_items, const uint64_t nvals_per_item, const bool inline_first);
+
+void init_chain_table(chain_table_t *table, void *base_ptr, const uint64_t nbuckets, const uint64_t max_items, const uint64_t nvals_per_item, const bool inline_first);
+
+bool chain_insert_item(chain_table_t *table, const uint64_t key, const uint64_t *values);
+
+uint64_t *chain_lookup_item(const chain_table_t *table, const uint64_t key);
+
+bool chain_delete_item(chain_table_t *table, const uint64_t key);
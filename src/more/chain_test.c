@@ -0,0 +1,117 @@
+/*
+    Test driver for the separately chained hash table: fill the table to 150% load with
+    sequential keys, look everything up, then run a delete heavy insert/delete mix and check
+    that the pool doesn't leak nodes. Runs once without and once with inline first nodes.
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+# include "hash.h"
+# include "chain.h"
+
+
+#define NBUCKETS   10000
+#define MAX_ITEMS  15000
+#define ITEM_NVALS 3 // needs to be >= 3
+#define CHURN_OPS  1000000
+
+
+
+uint64_t
+run_test(const bool inline_first)
+{
+
+    chain_table_t my_table;
+
+    uint64_t nvals_per_item = ITEM_NVALS;
+    uint64_t table_bytes = chain_table_bytes(NBUCKETS, MAX_ITEMS, nvals_per_item, inline_first);
+    uint64_t nitems = MAX_ITEMS;
+    uint64_t i, ninserted = 0, nfound = 0, nwrong = 0;
+    void * base_ptr;
+
+    printf("\n Inline first node: %s, nbuckets = %u, max_items = %u, table_bytes = %lu \n",inline_first ? "yes" : "no",NBUCKETS,MAX_ITEMS,table_bytes);
+
+    base_ptr = malloc(table_bytes);
+
+    init_chain_table(&my_table, base_ptr, NBUCKETS, MAX_ITEMS, nvals_per_item, inline_first);
+
+
+    // testing...
+
+    for(i = 1; i <= nitems; i++)
+    {
+        uint64_t val = 3 * i;
+        ninserted += chain_insert_item(&my_table, i, &val);
+    }
+    printf("\n Inserted %lu of %lu items (load = %.2f) \n",ninserted,nitems,(double) *(my_table.nitems) / NBUCKETS);
+
+    for(i = 1; i <= nitems; i++)
+    {
+        uint64_t *vals = chain_lookup_item(&my_table, i);
+        if(vals != NULL)
+        {
+            nfound++;
+            if(vals[0] != 3 * i) nwrong++;
+        }
+    }
+    printf("\n Found %lu items (%lu with wrong values) \n",nfound,nwrong);
+
+    printf("\n Lookup of missing key %lu: %s \n",nitems + 1,chain_lookup_item(&my_table, nitems + 1) ? "found" : "not found");
+    nwrong += (ninserted != nitems || nfound != ninserted || chain_lookup_item(&my_table, nitems + 1) != NULL);
+
+    /* churn: replace a random live key by a new one, the table stays at 150% load the whole time */
+    uint64_t *live = malloc(nitems * sizeof(uint64_t));
+    uint64_t next_key = nitems + 1, ndeleted = 0;
+
+    for(i = 0; i < nitems; i++) live[i] = i + 1;
+
+    for(i = 0; i < CHURN_OPS; i++)
+    {
+        uint64_t r = rand() % nitems;
+        uint64_t val = 3 * next_key;
+
+        ndeleted += chain_delete_item(&my_table, live[r]);
+        chain_insert_item(&my_table, next_key, &val);
+        live[r] = next_key++;
+    }
+
+    uint64_t nwrong_before = nwrong;
+
+    nfound = nwrong = 0;
+    for(i = 0; i < nitems; i++)
+    {
+        uint64_t *vals = chain_lookup_item(&my_table, live[i]);
+        if(vals != NULL)
+        {
+            nfound++;
+            if(vals[0] != 3 * live[i]) nwrong++;
+        }
+    }
+    printf("\n Churn: %lu deletes, %lu items in the table, %lu live keys found (%lu with wrong values), %lu pool nodes ever used \n",
+           ndeleted,*(my_table.nitems),nfound,nwrong,*(my_table.nfresh));
+
+    nwrong += nwrong_before + (ndeleted != CHURN_OPS || nfound != nitems || *(my_table.nitems) != nitems || *(my_table.nfresh) > MAX_ITEMS);
+
+    free(live);
+    free(base_ptr);
+
+    return nwrong;
+}
+
+
+int main()
+{
+
+    uint64_t nwrong = 0;
+
+    nwrong += run_test(false);
+    nwrong += run_test(true);
+
+    printf("\n %s \n\n",(nwrong == 0) ? "All checks passed." : "Some checks FAILED.");
+
+	return (nwrong == 0) ? 0 : 1;
+}
@@ -0,0 +1,418 @@
+/*
+    Implementation of a bucketized cuckoo hash table.
+
+    Every key has exactly two candidate buckets (from two differently seeded murmur hashes) of
+    CUCKOO_WAYS slots each, so a lookup inspects at most two buckets, regardless of the load.
+    If both buckets are full on insert, a breadth-first search over the buckets of the resident
+    keys looks for the shortest chain of displacements that ends in a free slot, and the keys along
+    that chain are shifted into their alternate buckets. Items for which no such chain exists
+    go into a small stash that lookups check only when it is non-empty.
+
+    Memory layout of the table (starting at base_ptr):
+
+        [nbuckets][nvals_per_item][nstash][stash rows ...][bucket 0][bucket 1] ...
+
+    where a stash row is [status][key][values...] (nvals_per_item words, same as a hashtable_t item)
+    and a bucket is
+
+        [occupancy bits][key_0 ... key_3][values_0 ... values_3][padding]
+
+    The bucket array starts on a cache line boundary and buckets are padded to whole cache lines,
+    so the occupancy bits and keys of a bucket (40 bytes) always sit in its first cache line: a
+    lookup reads at most two cache lines to find a key, plus the one holding its values.
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <assert.h>
+
+# include "hash.h"
+# include "cuckoo.h"
+
+
+#define CUCKOO_SEED_1  0x0UL
+#define CUCKOO_SEED_2  0x9e3779b97f4a7c15UL
+#define CUCKOO_BFS_MAX 512  // max number of buckets visited by the displacement search
+
+
+
+// words of a bucket, rounded up to whole cache lines
+static inline uint64_t
+bucket_words(const uint64_t nvals_per_item)
+{
+    uint64_t line_words = PROBE_LINE_BYTES / sizeof(uint64_t);
+    uint64_t nwords = 1 + CUCKOO_WAYS + CUCKOO_WAYS * (nvals_per_item - 2);
+
+    return (nwords + line_words - 1) / line_words * line_words;
+}
+
+
+static inline uint64_t *
+get_bucket(const cuckoo_table_t *table, const uint64_t b)
+{
+    return table->buckets + b * bucket_words(*(table->nvals_per_item));
+}
+
+
+static inline uint64_t *
+bucket_values(const uint64_t *bucket, const uint64_t slot, const uint64_t nvals_per_item)
+{
+    return (uint64_t *) bucket + 1 + CUCKOO_WAYS + slot * (nvals_per_item - 2);
+}
+
+
+static inline uint64_t
+bucket_1(const cuckoo_table_t *table, const uint64_t key)
+{
+    return murmur_hash_64(key, CUCKOO_SEED_1) % *(table->nbuckets);
+}
+
+
+static inline uint64_t
+bucket_2(const cuckoo_table_t *table, const uint64_t key)
+{
+    return murmur_hash_64(key, CUCKOO_SEED_2) % *(table->nbuckets);
+}
+
+
+// index of the first free slot in the bucket (CUCKOO_WAYS if it's full)
+static inline int
+free_slot(const uint64_t *bucket)
+{
+    int s;
+    for(s = 0; s < CUCKOO_WAYS; s++)
+    {
+        if(!(bucket[0] & (1UL << s))) return s;
+    }
+    return CUCKOO_WAYS;
+}
+
+
+static void
+put_item(uint64_t *bucket, const int slot, const uint64_t key, const uint64_t *values, const uint64_t nvals_per_item)
+{
+    uint64_t j;
+    uint64_t *vals = bucket_values(bucket, slot, nvals_per_item);
+
+    bucket[0] |= (1UL << slot);
+    bucket[1 + slot] = key;
+    for(j = 0; j < nvals_per_item - 2; j++)
+    {
+        vals[j] = values[j];
+    }
+}
+
+
+// size in bytes of the memory region needed for a table of (at least) table_capacity items
+uint64_t
+cuckoo_table_bytes(const uint64_t table_capacity, const uint64_t nvals_per_item)
+{
+    uint64_t nbuckets = (table_capacity + CUCKOO_WAYS - 1) / CUCKOO_WAYS;
+
+    // room to move the bucket array up to the next cache line boundary
+    return (3 + CUCKOO_STASH_SIZE * nvals_per_item + nbuckets * bucket_words(nvals_per_item)) * sizeof(uint64_t) + PROBE_LINE_BYTES;
+}
+
+
+// initialization of an empty cuckoo hash table (base_ptr must point at cuckoo_table_bytes() bytes)
+void
+init_cuckoo_table(cuckoo_table_t *table, void *base_ptr, const uint64_t table_capacity, const uint64_t nvals_per_item)
+{
+    uint64_t b, i;
+
+    if(base_ptr == NULL)
+    {
+        printf("\n Invalid base_ptr provided. Unable to initilize cuckoo table. \n");
+        return;
+    }
+
+    if(table_capacity < 1 || nvals_per_item < 3)
+    {
+        printf("\n Invalid table_capacity or nvals_per_item. Unable to initilize cuckoo table. \n");
+        return;
+    }
+
+    /* map table into memory via the base_ptr */
+    table->nbuckets       = base_ptr;
+    table->nvals_per_item = (uint64_t *) base_ptr + 1;
+    table->nstash         = (uint64_t *) base_ptr + 2;
+    table->stash          = (uint64_t *) base_ptr + 3;
+    table->buckets        = table->stash + CUCKOO_STASH_SIZE * nvals_per_item;
+
+    // buckets start on a cache line boundary
+    uintptr_t misalignment = (uintptr_t) table->buckets % PROBE_LINE_BYTES;
+    if(misalignment != 0) table->buckets += (PROBE_LINE_BYTES - misalignment) / sizeof(uint64_t);
+
+    *(table->nbuckets)       = (table_capacity + CUCKOO_WAYS - 1) / CUCKOO_WAYS;
+    *(table->nvals_per_item) = nvals_per_item;
+    *(table->nstash)         = 0;
+
+    for(i = 0; i < CUCKOO_STASH_SIZE; i++)
+    {
+        table->stash[i * nvals_per_item] = 0;
+    }
+
+    for(b = 0; b < *(table->nbuckets); b++)
+    {
+        get_bucket(table, b)[0] = 0;
+    }
+
+}
+
+
+// find the item with given key and return a pointer to its values (NULL if not present)
+uint64_t *
+cuckoo_lookup_item(const cuckoo_table_t *table, const uint64_t key)
+{
+
+    assert(table != NULL);
+
+    uint64_t nvals_per_item = *(table->nvals_per_item);
+    uint64_t *bucket[2];
+    int k, s;
+
+    bucket[0] = get_bucket(table, bucket_1(table, key));
+    bucket[1] = get_bucket(table, bucket_2(table, key));
+
+    // both candidate buckets are independent, so get the second miss going right away
+    __builtin_prefetch(bucket[1], 0, 1);
+
+    for(k = 0; k < 2; k++)
+    {
+        for(s = 0; s < CUCKOO_WAYS; s++)
+        {
+            if((bucket[k][0] & (1UL << s)) && bucket[k][1 + s] == key)
+            {
+                return bucket_values(bucket[k], s, nvals_per_item);
+            }
+        }
+    }
+
+    if(*(table->nstash) > 0)
+    {
+        for(s = 0; s < CUCKOO_STASH_SIZE; s++)
+        {
+            uint64_t *p = table->stash + s * nvals_per_item;
+            if(p[0] == 1 && p[1] == key) return p + 2;
+        }
+    }
+
+    return NULL;
+
+}
+
+
+/*
+    Breadth-first search for a displacement path. Starting from the two candidate buckets of the
+    new key, every visited bucket queues the alternate buckets of its resident keys. The search
+    stops at the first bucket with a free slot, so the path found is the shortest one (within
+    CUCKOO_BFS_MAX visited buckets). The path is then carried out backwards from the free slot,
+    each key moving into its alternate bucket, which leaves a free slot in a candidate bucket of
+    the new key. Returns false if no path was found.
+*/
+
+typedef struct
+{
+    uint64_t bucket; // bucket index
+    int parent;      // queue position of the bucket we came from (-1 for the two candidate buckets)
+    int slot;        // slot in the parent bucket whose key moves into this bucket
+
+} bfs_node_t;
+
+
+// is bucket b already on the path from the candidate buckets to queue position n
+static bool
+on_path(const bfs_node_t *queue, int n, const uint64_t b)
+{
+    for(; n >= 0; n = queue[n].parent)
+    {
+        if(queue[n].bucket == b) return true;
+    }
+    return false;
+}
+
+
+static bool
+cuckoo_displace(cuckoo_table_t *table, const uint64_t key, const uint64_t *values)
+{
+    uint64_t nvals_per_item = *(table->nvals_per_item);
+    bfs_node_t queue[CUCKOO_BFS_MAX];
+    int head = 0, tail = 0;
+    int n, s;
+
+    queue[tail++] = (bfs_node_t) {.bucket = bucket_1(table, key), .parent = -1, .slot = -1};
+    queue[tail++] = (bfs_node_t) {.bucket = bucket_2(table, key), .parent = -1, .slot = -1};
+
+    while(head < tail)
+    {
+        n = head++;
+        uint64_t *bucket = get_bucket(table, queue[n].bucket);
+        int free = free_slot(bucket);
+
+        if(free < CUCKOO_WAYS)
+        {
+            /* walk back along the path, pulling every key one step forward into the freed slot */
+            while(queue[n].parent >= 0)
+            {
+                bfs_node_t *node = &queue[n];
+                uint64_t *from = get_bucket(table, queue[node->parent].bucket);
+                uint64_t *to   = get_bucket(table, node->bucket);
+
+                put_item(to, free, from[1 + node->slot], bucket_values(from, node->slot, nvals_per_item), nvals_per_item);
+                from[0] &= ~(1UL << node->slot);
+
+                free = node->slot;
+                n = node->parent;
+            }
+
+            put_item(get_bucket(table, queue[n].bucket), free, key, values, nvals_per_item);
+            return true;
+        }
+
+        for(s = 0; s < CUCKOO_WAYS && tail < CUCKOO_BFS_MAX; s++)
+        {
+            uint64_t resident = bucket[1 + s];
+            uint64_t alt = bucket_1(table, resident);
+            if(alt == queue[n].bucket) alt = bucket_2(table, resident);
+            if(on_path(queue, n, alt)) continue; // both hashes agree, or the path would loop back on itself
+
+            queue[tail++] = (bfs_node_t) {.bucket = alt, .parent = n, .slot = s};
+        }
+    }
+
+    return false;
+}
+
+
+// insert a new item into the table (overwrites the values if the key is already present)
+bool
+cuckoo_insert_item(cuckoo_table_t *table, const uint64_t key, const uint64_t *values)
+{
+
+    assert(table != NULL);
+
+    uint64_t nvals_per_item = *(table->nvals_per_item);
+    uint64_t j, s, *vals;
+    uint64_t *bucket;
+    int free;
+
+    /* existing key, just update the values */
+    vals = cuckoo_lookup_item(table, key);
+    if(vals != NULL)
+    {
+        for(j = 0; j < nvals_per_item - 2; j++)
+        {
+            vals[j] = values[j];
+        }
+        return true;
+    }
+
+    /* free slot in one of the two candidate buckets */
+    bucket = get_bucket(table, bucket_1(table, key));
+    free = free_slot(bucket);
+    if(free == CUCKOO_WAYS)
+    {
+        bucket = get_bucket(table, bucket_2(table, key));
+        free = free_slot(bucket);
+    }
+
+    if(free < CUCKOO_WAYS)
+    {
+        put_item(bucket, free, key, values, nvals_per_item);
+        return true;
+    }
+
+    /* make room by moving keys to their alternate buckets */
+    if(cuckoo_displace(table, key, values)) return true;
+
+    /* last resort, the stash */
+    for(s = 0; s < CUCKOO_STASH_SIZE; s++)
+    {
+        uint64_t *p = table->stash + s * nvals_per_item;
+        if(p[0] != 1)
+        {
+            p[0] = 1;
+            p[1] = key;
+            for(j = 0; j < nvals_per_item - 2; j++)
+            {
+                p[2 + j] = values[j];
+            }
+            (*(table->nstash))++;
+            return true;
+        }
+    }
+
+    printf("\n Warning! Unable to insert new item with key: %lu. No displacement path and the stash is full. \n",key);
+    return false;
+
+}
+
+
+// a bucket slot has just been freed, move a stashed item that belongs to this bucket back into it
+static void
+unstash(cuckoo_table_t *table, const uint64_t b)
+{
+    uint64_t nvals_per_item = *(table->nvals_per_item);
+    uint64_t s, *p;
+
+    for(s = 0; s < CUCKOO_STASH_SIZE; s++)
+    {
+        p = table->stash + s * nvals_per_item;
+
+        if(p[0] == 1 && (bucket_1(table, p[1]) == b || bucket_2(table, p[1]) == b))
+        {
+            uint64_t *bucket = get_bucket(table, b);
+            put_item(bucket, free_slot(bucket), p[1], p + 2, nvals_per_item);
+            p[0] = 0;
+            (*(table->nstash))--;
+            return;
+        }
+    }
+}
+
+
+bool
+cuckoo_delete_item(cuckoo_table_t *table, const uint64_t key)
+{
+
+    assert(table != NULL);
+
+    uint64_t nvals_per_item = *(table->nvals_per_item);
+    uint64_t b[2];
+    int k, s;
+
+    b[0] = bucket_1(table, key);
+    b[1] = bucket_2(table, key);
+
+    for(k = 0; k < 2; k++)
+    {
+        uint64_t *bucket = get_bucket(table, b[k]);
+
+        for(s = 0; s < CUCKOO_WAYS; s++)
+        {
+            if((bucket[0] & (1UL << s)) && bucket[1 + s] == key)
+            {
+                bucket[0] &= ~(1UL << s);
+                if(*(table->nstash) > 0) unstash(table, b[k]);
+                return true;
+            }
+        }
+    }
+
+    for(s = 0; s < CUCKOO_STASH_SIZE; s++)
+    {
+        uint64_t *p = table->stash + s * nvals_per_item;
+        if(p[0] == 1 && p[1] == key)
+        {
+            p[0] = 0;
+            (*(table->nstash))--;
+            return true;
+        }
+    }
+
+    return false;
+
+}
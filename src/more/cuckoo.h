@@ -0,0 +1,28 @@
+
+
+// bucketized cuckoo hash table (2 hash functions x CUCKOO_WAYS slots per bucket, plus a small stash)
+#define CUCKOO_WAYS       4
+#define CUCKOO_STASH_SIZE 8
+
+
+typedef struct cuckoo_table_st
+{
+    uint64_t * nbuckets;       // number of buckets (capacity = CUCKOO_WAYS * nbuckets)
+    uint64_t * nvals_per_item; // number of values per item (status + key + values, same as hashtable_t)
+    uint64_t * nstash;         // number of items currently in the stash
+    uint64_t * stash;          // stash items, CUCKOO_STASH_SIZE rows of nvals_per_item words
+    uint64_t * buckets;        // bucket array
+
+} cuckoo_table_t;
+
+
+// function prototypes
+uint64_t cuckoo_table_bytes(const uint64_t table_capacity, const uint64_t nvals_per_item);
+
+void init_cuckoo_table(cuckoo_table_t *table, void *base_ptr, const uint64_t table_capacity, const uint64_t nvals_per_item);
+
+bool cuckoo_insert_item(cuckoo_table_t *table, const uint64_t key, const uint64_t *values);
+
+uint64_t *cuckoo_lookup_item(const cuckoo_table_t *table, const uint64_t key);
+
+bool cuckoo_delete_item(cuckoo_table_t *table, const uint64_t key);
@@ -17,28 +17,51 @@
 
 
 
-// simple hash funciton (Cormen's multiplication method)
+// 64-bit MurMur hash 2 of a single 8-byte key (same mixing as murmur_hash_2.c)
+uint64_t 
+murmur_hash_64(const uint64_t key, const uint64_t seed)
+{
+    
+    // mixing constants
+    const uint64_t m = 0xc6a4a7935bd1e995;
+    const uint32_t r = 47;
+    
+    uint64_t k = key;
+    uint64_t hash_val = seed ^ (8 * m);
+    
+    k *= m;
+    k ^= k >> r;
+    k *= m; 
+        
+    hash_val ^= k;
+    hash_val *= m;
+
+    hash_val ^= hash_val >> r;
+    hash_val *= m;
+    hash_val ^= hash_val >> r;
+    
+    return hash_val;
+}
+
+
+// hash index of key into a table of the given capacity (seed = 0)
 uint64_t 
 hash(const uint64_t key, const uint64_t table_capacity)
 {
     
-    int64_t A = rand()*2718281;
-    int64_t n = 1+rand()*15;
-    int64_t x = floor(A*pow(2,32))*key;
-   
-    int64_t hash_val = abs((x >> (32-n)) % table_capacity);  
+    uint64_t hash_val = murmur_hash_64(key, 0);
     //printf("\n hash(%i) = %i \n", key, hash_val);
     
-    return hash_val;
+    return (hash_val % table_capacity);
 }
 
 
-// initialization of an empty hash table 
-void 
-init_hash_table(hashtable_t *table, const void *base_ptr, const uint64_t table_capacity, const uint64_t nvals_per_item)
+// initialization of an empty hash table whose slots are slot_nvals wide (>= nvals_per_item)
+static void 
+init_table_slots(hashtable_t *table, const void *base_ptr, const uint64_t table_capacity, const uint64_t nvals_per_item, const uint64_t slot_nvals)
 {
-    int i, j, offset;
-    uint64_t size_of_item = (1 + nvals_per_item) * sizeof(uint64_t) ; 
+    uint64_t i, j, offset;
+    uint64_t size_of_item = (1 + slot_nvals) * sizeof(uint64_t) ; 
  
     /* make sure we're getting a valid base_ptr */
     if(base_ptr == NULL)
@@ -62,6 +85,17 @@ init_hash_table(hashtable_t *table, const void *base_ptr, const uint64_t table_c
     table->capacity       = base_ptr;
     table->nvals_per_item = base_ptr + sizeof(uint64_t);
     table->items = malloc(sizeof(uint64_t *) * table_capacity); // allocate memory for an array of item pointers    
+    table->filter = NULL;
+    table->probe = PROBE_LINEAR;
+    table->expiry = NULL;
+    table->sweep = 0;
+    table->ntombstones = 0;
+    table->max_tombstones = (uint64_t) (TOMBSTONE_MAX_LOAD * table_capacity);
+    table->compact = 0;
+    table->gen = 0;
+    table->access = NULL;
+    table->nexpired = 0;
+    table->nvals = nvals_per_item - 2;
    
 
     //printf("\n table capacity pointer       = %p \n",table->capacity);
@@ -69,7 +103,7 @@ init_hash_table(hashtable_t *table, const void *base_ptr, const uint64_t table_c
     
     /* set table attributes */
     *(table->capacity) = table_capacity;   
-    *(table->nvals_per_item) = nvals_per_item;  
+    *(table->nvals_per_item) = slot_nvals;  
     
     
     for(i = 0; i< table_capacity; i++)
@@ -81,7 +115,7 @@ init_hash_table(hashtable_t *table, const void *base_ptr, const uint64_t table_c
         uint64_t *p = base_ptr + 3*sizeof(uint64_t) + offset;
 
 
-        for(j = 0; j < nvals_per_item; j++)
+        for(j = 0; j < slot_nvals; j++)
         {
             //uint64_t *p = base_ptr + 2*sizeof(uint64_t) + offset + (j+1)*sizeof(uint64_t);
             p[j] = (uint64_t) 0;
@@ -95,6 +129,23 @@ init_hash_table(hashtable_t *table, const void *base_ptr, const uint64_t table_c
 }
 
 
+// initialization of an empty hash table 
+void 
+init_hash_table(hashtable_t *table, const void *base_ptr, const uint64_t table_capacity, const uint64_t nvals_per_item)
+{
+    init_table_slots(table, base_ptr, table_capacity, nvals_per_item, nvals_per_item);
+}
+
+
+// initialization of an empty hash table in memory from hash_table_alloc(..., HASH_ALLOC_PAD_SLOTS): the slots
+// are padded_nvals(nvals_per_item) wide, but only the nvals_per_item - 2 values are copied in and out
+void 
+init_hash_table_padded(hashtable_t *table, const void *base_ptr, const uint64_t table_capacity, const uint64_t nvals_per_item)
+{
+    init_table_slots(table, base_ptr, table_capacity, nvals_per_item, padded_nvals(nvals_per_item));
+}
+
+
 // insert a new item into the table
 bool 
 insert_item(hashtable_t *table,  const uint64_t key, const uint64_t *values)
@@ -111,20 +162,27 @@ insert_item(hashtable_t *table,  const uint64_t key, const uint64_t *values)
     
     // hash the index for this new item
     uint64_t index = hash(key, capacity);
+    uint64_t step = probe_step(table, key);
+    uint64_t now = (table->expiry != NULL) ? hash_time_now() : 0;
     
     uint64_t i, j, try, slot_status;
     uint64_t *p; // = base_ptr + 3*sizeof(uint64_t);
 
+    if(table->expiry != NULL) expire_step(table, EXPIRE_SWEEP_SLOTS);
+
+    if(table->max_tombstones > 0 && table->ntombstones > table->max_tombstones) compact_step(table, COMPACT_STEP_SLOTS);
+
     
     /*starting at index, traverse down the table and place item in leading empty slot */
     for(i=0; i< capacity; i++)
     {
-        uint64_t try = (index + i) % capacity;
+        uint64_t try = probe_slot(table, index, step, i);
         
         p = base_ptr + 3*sizeof(uint64_t) + try*size_of_item;
 
         // get status of this slot
-        slot_status = p[0]; 
+        slot_status = slot_state(table, p); 
+        if(table->expiry != NULL && expire_item(table, p, try, now)) slot_status = 2;
         
         printf("\n try = %i, status = %i \n",try,slot_status);
         
@@ -134,13 +192,18 @@ insert_item(hashtable_t *table,  const uint64_t key, const uint64_t *values)
         {
             printf("\n Found empty slot at location %i \n",try);
  
-            p[0] = 1;   // set status to occupied
+            if(slot_status == 2) table->ntombstones--;
+
+            p[0] = status_word(table, 1);   // set status to occupied
             p[1] = key; // set key
-            for(j=0;j<nvals_per_item-2;j++)
+            for(j=0;j<table->nvals;j++)
             {
                p[2+j] = values[j]; // set remaining values
             }                
             
+            if(table->filter != NULL) filter_add(table, key);
+            if(table->expiry != NULL) table->expiry[try] = 0;
+            
             printf("\n Item has been inserted. \n");
             return true;
         }            
@@ -167,20 +230,30 @@ lookup_item(const hashtable_t *table, const uint64_t key)
     
     printf("\n Attempting to search for item with key = %i. \n",key);  
     
+    // absent keys are mostly rejected by the filter without touching the table
+    if(table->filter != NULL && !filter_may_contain(table, key))
+    {
+        printf("Item does not exist. \n");
+        return (-1);   
+    }
+    
     // hash index for this item
     uint64_t index = hash(key, capacity);
+    uint64_t step = probe_step(table, key);
+    uint64_t now = (table->expiry != NULL) ? hash_time_now() : 0;
     
     uint64_t  i, slot_status;
     uint64_t  *p;
     
     for(i=0; i< capacity; i++)
     {
-        uint64_t try = (index + i) % capacity;
+        uint64_t try = probe_slot(table, index, step, i);
         
         p = base_ptr + 3*sizeof(uint64_t) + try*size_of_item;
 
         // get status of this slot
-        slot_status = p[0]; 
+        slot_status = slot_state(table, p); 
+        if(table->expiry != NULL && item_expired(table, p, try, now)) slot_status = 2;
         
         //printf("\n try = %i, status = %i \n",try,slot_status);
 
@@ -204,7 +277,7 @@ lookup_item(const hashtable_t *table, const uint64_t key)
 
 
 bool 
-delete_item(const hashtable_t *table, const uint64_t key)
+delete_item(hashtable_t *table, const uint64_t key)
 {
 
     assert(table != NULL);
@@ -216,20 +289,31 @@ delete_item(const hashtable_t *table, const uint64_t key)
     
     printf("\n Attempting to delete item with key = %i. \n",key);  
     
+    if(table->expiry != NULL) expire_step(table, EXPIRE_SWEEP_SLOTS);
+
+    if(table->filter != NULL && !filter_may_contain(table, key))
+    {
+        printf("Item does not exist. \n");
+        return false;
+    }
+    
     // hash index for this item
     uint64_t index = hash(key, capacity);
+    uint64_t step = probe_step(table, key);
+    uint64_t now = (table->expiry != NULL) ? hash_time_now() : 0;
     
     uint64_t  i, slot_status;
     uint64_t  *p;
     
     for(i=0; i< capacity; i++)
     {
-        uint64_t try = (index + i) % capacity;
+        uint64_t try = probe_slot(table, index, step, i);
         
         p = base_ptr + 3*sizeof(uint64_t) + try*size_of_item;
 
         // get status of this slot
-        slot_status = p[0]; 
+        slot_status = slot_state(table, p); 
+        if(table->expiry != NULL && expire_item(table, p, try, now)) slot_status = 2;
         
         //printf("\n try = %i, status = %i \n",try,slot_status);
 
@@ -240,7 +324,11 @@ delete_item(const hashtable_t *table, const uint64_t key)
         if((slot_status == 1) && (p[1] == key)) 
         {
             printf("\n Deleting item with key = %i at location %i \n",key,try);
-            p[0] = 2; // set status to deleted
+            p[0] = status_word(table, 2); // set status to deleted
+            table->ntombstones++;
+
+            if(table->max_tombstones > 0 && table->ntombstones > table->max_tombstones) compact_step(table, COMPACT_STEP_SLOTS);
+
             return true;
         }            
         
@@ -255,3 +343,164 @@ delete_item(const hashtable_t *table, const uint64_t key)
 
 
 
+// find the item with given key and return a pointer to its values (NULL if not present)
+uint64_t *
+find_item(const hashtable_t *table, const uint64_t key)
+{
+
+    assert(table != NULL);
+
+    void *base_ptr = table->capacity;
+    uint64_t capacity = *(table->capacity);
+    uint64_t nvals_per_item = *(table->nvals_per_item);
+    uint64_t size_of_item = (1 + nvals_per_item) * sizeof(uint64_t); 
+    
+    if(table->filter != NULL && !filter_may_contain(table, key)) return NULL;
+    
+    uint64_t index = hash(key, capacity);
+    uint64_t step = probe_step(table, key);
+    uint64_t now = (table->expiry != NULL) ? hash_time_now() : 0;
+    
+    uint64_t  i, slot_status;
+    uint64_t  *p;
+    
+    for(i=0; i< capacity; i++)
+    {
+        uint64_t try = probe_slot(table, index, step, i);
+        
+        p = base_ptr + 3*sizeof(uint64_t) + try*size_of_item;
+
+        slot_status = slot_state(table, p); 
+        if(table->expiry != NULL && item_expired(table, p, try, now)) slot_status = 2;
+        
+        if(slot_status == 0) break;
+        
+        if((slot_status == 1) && (p[1] == key)) return p + 2;
+    }    
+    
+    return NULL;
+
+}
+
+
+// delete the item with given key, without the messages of delete_item(), returns false if it's not in the table
+bool
+erase_item(hashtable_t *table, const uint64_t key)
+{
+
+    if(table->expiry != NULL) expire_step(table, EXPIRE_SWEEP_SLOTS);
+
+    uint64_t *vals = find_item(table, key);
+
+    if(vals == NULL) return false;
+
+    vals[-2] = status_word(table, 2); // set status to deleted
+    table->ntombstones++;
+
+    if(table->max_tombstones > 0 && table->ntombstones > table->max_tombstones) compact_step(table, COMPACT_STEP_SLOTS);
+
+    return true;
+
+}
+
+
+/*
+    Single probe pass upsert: walk the cluster once looking for the key, remembering the leading
+    deleted slot on the way. If the key isn't there the new item goes into that deleted slot (or
+    else the empty slot that ended the walk) with its values zeroed. Returns a pointer to the 
+    values of the item, or NULL if the table is full.
+*/
+uint64_t *
+find_or_insert(hashtable_t *table, const uint64_t key, bool *inserted)
+{
+
+    assert(table != NULL);
+
+    void *base_ptr = table->capacity;
+    uint64_t capacity = *(table->capacity);
+    uint64_t nvals_per_item = *(table->nvals_per_item);
+    uint64_t size_of_item = (1 + nvals_per_item) * sizeof(uint64_t); 
+    
+    uint64_t index = hash(key, capacity);
+    uint64_t step = probe_step(table, key);
+    uint64_t now = (table->expiry != NULL) ? hash_time_now() : 0;
+    
+    uint64_t  i, j, try = 0, slot_status;
+    uint64_t  *p, *first_deleted = NULL, first_deleted_slot = 0;
+
+    if(inserted != NULL) *inserted = false;
+
+    if(table->expiry != NULL) expire_step(table, EXPIRE_SWEEP_SLOTS);
+
+    if(table->max_tombstones > 0 && table->ntombstones > table->max_tombstones) compact_step(table, COMPACT_STEP_SLOTS);
+    
+    for(i=0; i< capacity; i++)
+    {
+        try = probe_slot(table, index, step, i);
+        
+        p = base_ptr + 3*sizeof(uint64_t) + try*size_of_item;
+
+        slot_status = slot_state(table, p); 
+        if(table->expiry != NULL && expire_item(table, p, try, now)) slot_status = 2;
+        
+        if(slot_status == 0) break;
+        
+        if(slot_status == 2) 
+        {
+            if(first_deleted == NULL) 
+            {
+                first_deleted = p;
+                first_deleted_slot = try;
+            }
+            continue;
+        }
+        
+        if(p[1] == key) return p + 2;
+    }    
+
+    if(first_deleted != NULL) 
+    {
+        p = first_deleted;
+        try = first_deleted_slot;
+        table->ntombstones--;
+    }    
+    else if(i == capacity)
+    {
+        printf("\n Warning! Unable to insert new item with key: %lu. Ran out of empty slots. \n",key);
+        return NULL;
+    }
+    
+    p[0] = status_word(table, 1);   // set status to occupied
+    p[1] = key; // set key
+    for(j=0;j<nvals_per_item-2;j++)
+    {
+       p[2+j] = 0;
+    }                
+
+    if(table->filter != NULL) filter_add(table, key);
+    if(table->expiry != NULL) table->expiry[try] = 0;
+
+    if(inserted != NULL) *inserted = true;
+    
+    return p + 2;
+
+}
+
+
+// insert a new item, or overwrite the values of the existing item with this key
+uint64_t *
+insert_or_assign(hashtable_t *table, const uint64_t key, const uint64_t *values)
+{
+    
+    uint64_t j, *vals = find_or_insert(table, key, NULL);
+
+    if(vals == NULL) return NULL;
+
+    for(j=0;j<table->nvals;j++)
+    {
+       vals[j] = values[j];
+    }                
+
+    return vals;
+
+}
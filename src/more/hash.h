@@ -1,22 +1,564 @@
 
 
+// probe sequence policies
+typedef enum
+{
+    PROBE_LINEAR = 0,   // (index + i) % capacity
+    PROBE_QUADRATIC,    // triangular numbers, capacity must be a power of 2
+    PROBE_DOUBLE_HASH,  // stride from a second murmur hash of the key
+    PROBE_BUCKETED      // whole cache-line groups of slots, capacity must be a multiple of the group size
+    
+} probe_policy_t;
+
+
 // hash table struct
 typedef struct hashtable_st
 {
     uint64_t * capacity;       // max number of items
-    uint64_t * nvals_per_item; // number of values per item
+    uint64_t * nvals_per_item; // number of values per item (the slot width, see hash_table_alloc())
     uint64_t ** items;         // array of pointers 
+    uint64_t * filter;         // optional blocked bloom filter in front of the table (NULL if none)
+    probe_policy_t probe;      // probe sequence policy (PROBE_LINEAR unless changed with set_probe_policy)
+    uint64_t * expiry;         // optional per-slot expiration times, parallel to the slot array (NULL if none)
+    uint64_t sweep;            // next slot to be checked by the incremental expiry sweeper
+    uint64_t ntombstones;      // number of deleted slots
+    uint64_t max_tombstones;   // compaction kicks in above this many deleted slots (0 = never)
+    uint64_t compact;          // next slot to be checked by the incremental compaction
+    uint64_t gen;              // generation of the contents, bumped by hash_table_clear()
+    uint64_t * access;         // optional per-slot access words of a cache, moved along with their items (NULL if none)
+    uint64_t nexpired;         // number of items expiry has turned into deleted slots so far
+    uint64_t nvals;            // values copied in and out per item, *nvals_per_item - 2 unless the slots are padded
     
 } hashtable_t;
 
 
+// status words carry the generation they were written in (status | gen << SLOT_GEN_SHIFT), slots
+// written in an older generation read as empty, which is what lets hash_table_clear() run in O(1)
+#define SLOT_GEN_SHIFT 8
+#define SLOT_GEN_MAX   ((1UL << (64 - SLOT_GEN_SHIFT)) - 1)
+
+static inline uint64_t
+slot_state(const hashtable_t *table, const uint64_t *p)
+{
+    return ((p[0] >> SLOT_GEN_SHIFT) == table->gen) ? (p[0] & ((1UL << SLOT_GEN_SHIFT) - 1)) : 0;
+}
+
+static inline uint64_t
+status_word(const hashtable_t *table, const uint64_t status)
+{
+    return (table->gen << SLOT_GEN_SHIFT) | status;
+}
+
+// slot index of an item from a pointer to its values
+static inline uint64_t
+slot_of(const hashtable_t *table, const uint64_t *vals)
+{
+    uint64_t size_of_item = (1 + *(table->nvals_per_item)) * sizeof(uint64_t);
+
+    return ((const void *) (vals - 2) - ((const void *) table->capacity + 3*sizeof(uint64_t))) / size_of_item;
+}
+
+// status word of slot i, followed by the key and the values (the inverse of slot_of)
+static inline uint64_t *
+slot_item(const hashtable_t *table, const uint64_t i)
+{
+    uint64_t size_of_item = (1 + *(table->nvals_per_item)) * sizeof(uint64_t);
+
+    return (void *) table->capacity + 3*sizeof(uint64_t) + i*size_of_item;
+}
+
+
+// cluster statistics of a table, as reported by probe_stats()
+typedef struct probe_stats_st
+{
+    uint64_t nitems;            // occupied slots
+    uint64_t ndeleted;          // deleted slots (tombstones)
+    uint64_t nclusters;         // runs of consecutive non-empty slots
+    uint64_t max_cluster;       // longest such run
+    double   mean_cluster;
+    double   mean_probes;       // probes needed to find an item, averaged over all items
+    uint64_t max_probes;
+    double   mean_miss_probes;  // probes needed to find out a key is absent, averaged over all home slots
+    
+} probe_stats_t;
+
+
 // function prototypes 
+uint64_t murmur_hash_64(const uint64_t key, const uint64_t seed);
+
 uint64_t hash(const uint64_t key, const uint64_t table_capacity);
 
 void init_hash_table(hashtable_t *table, const void *base_ptr, const uint64_t table_capacity, const uint64_t nvals_per_item);
 
+void init_hash_table_padded(hashtable_t *table, const void *base_ptr, const uint64_t table_capacity, const uint64_t nvals_per_item);
+
 bool insert_item(hashtable_t *table,  const uint64_t key, const uint64_t *values);
 
 int64_t lookup_item(const hashtable_t *table, const uint64_t key);
 
-bool delete_item(const hashtable_t *table, const uint64_t key);
+bool delete_item(hashtable_t *table, const uint64_t key);
+
+uint64_t *find_item(const hashtable_t *table, const uint64_t key);
+
+uint64_t *find_or_insert(hashtable_t *table, const uint64_t key, bool *inserted);
+
+uint64_t *insert_or_assign(hashtable_t *table, const uint64_t key, const uint64_t *values);
+
+bool erase_item(hashtable_t *table, const uint64_t key);
+
+
+// parallel bulk build
+#define BUILD_MAX_LOAD 0.75 // load factor the bulk build sizes the table for
+
+void *hash_table_build(hashtable_t *table, const uint64_t *keys, const uint64_t *values, const uint64_t nitems, const uint64_t nvals_per_item, const int nthreads);
+
+
+// in-table aggregation (group-by), the value row of every key holds its accumulators
+typedef enum
+{
+    AGG_COUNT = 0,  // values[j] += 1 (deltas unused)
+    AGG_SUM,        // values[j] += deltas[j]
+    AGG_MIN,        // values[j] = min(values[j], deltas[j])
+    AGG_MAX         // values[j] = max(values[j], deltas[j])
+    
+} agg_op_t;
+
+
+typedef struct agg_local_st
+{
+    hashtable_t table;         // private pre-aggregation table of one thread
+    void * base_ptr;
+    hashtable_t * shared;      // table the partial aggregates are merged into
+    agg_op_t op;
+    uint64_t nitems;
+    uint64_t max_items;        // merge into the shared table once the private one holds this many keys
+    
+} agg_local_t;
+
+
+#define SLOT_BUSY 3 // status of a slot that is being claimed by another thread (atomic operations only)
+
+#if defined(__x86_64__) || defined(__i386__)
+#define cpu_relax() __builtin_ia32_pause()
+#else
+#define cpu_relax() 
+#endif
+
+uint64_t *find_or_insert_atomic(hashtable_t *table, const uint64_t key, const uint64_t *init_values, bool *inserted);
+
+uint64_t *aggregate_item(hashtable_t *table, const uint64_t key, const uint64_t *deltas, const agg_op_t op);
+
+uint64_t *aggregate_item_atomic(hashtable_t *table, const uint64_t key, const uint64_t *deltas, const agg_op_t op);
+
+bool init_agg_local(agg_local_t *local, hashtable_t *shared, const uint64_t capacity, const agg_op_t op);
+
+bool aggregate_local(agg_local_t *local, const uint64_t key, const uint64_t *deltas);
+
+bool flush_agg_local(agg_local_t *local);
+
+void free_agg_local(agg_local_t *local);
+
+
+// parallel merge of one table into another, keys found in both are resolved by the merge policy
+typedef enum
+{
+    MERGE_KEEP = 0,     // keep the values of the destination
+    MERGE_OVERWRITE,    // take the values of the source
+    MERGE_SUM           // dst values[j] += src values[j]
+
+} merge_policy_t;
+
+uint64_t merge_capacity(const hashtable_t *dst, const hashtable_t *src);
+
+void *hash_table_merge(hashtable_t *dst, const hashtable_t *src, const merge_policy_t policy, const int nthreads);
+
+
+// concurrent growable table, resized by cooperative migration once max_load is exceeded
+#define SLOT_MOVED_EMPTY 4  // old table slot that was empty when it got migrated (probes stop here, like at an empty slot)
+#define SLOT_MOVED       5  // old table slot whose item (or tombstone) has been migrated to the new table
+#define RESIZE_CHUNK     1024 // slots migrated per unit of migration work
+#define RESIZE_MAX_TABLES 64  // tables that can be around at once, ids are reused once a replaced table is released
+
+typedef struct conc_table_st
+{
+    hashtable_t * cur;         // current table
+    hashtable_t * next;        // table being migrated into (NULL when no resize is in progress)
+    uint64_t nvals_per_item;
+    double max_load;           // resize once this fraction of the current table's slots is taken
+    uint64_t nitems;
+    uint64_t resizing;         // set from the start of a resize until its migration is done
+    hashtable_t * tables[RESIZE_MAX_TABLES]; // table number n is in tables[n % RESIZE_MAX_TABLES]
+    uint64_t ntables;          // tables allocated so far
+
+    // migration into tables[t], kept per table so a thread holding on to an old table can't claim chunks of a later resize
+    uint64_t transfer[RESIZE_MAX_TABLES];  // next chunk of the source table to be claimed
+    uint64_t nmigrated[RESIZE_MAX_TABLES]; // number of chunks migrated so far
+    uint64_t nchunks[RESIZE_MAX_TABLES];   // number of chunks in the source table
+    uint64_t nused[RESIZE_MAX_TABLES];     // slots of tables[t] taken by items (deleted slots stay taken)
+    uint64_t users[RESIZE_MAX_TABLES];     // operations that have tables[t] pinned
+    uint64_t state[RESIZE_MAX_TABLES];     // TABLE_LIVE, TABLE_RETIRED once replaced, TABLE_FREED once released
+
+} conc_table_t;
+
+
+bool init_conc_table(conc_table_t *ct, const uint64_t table_capacity, const uint64_t nvals_per_item, const double max_load);
+
+bool conc_insert(conc_table_t *ct, const uint64_t key, const uint64_t *values);
+
+bool conc_lookup(conc_table_t *ct, const uint64_t key, uint64_t *values);
+
+bool conc_delete(conc_table_t *ct, const uint64_t key);
+
+void conc_help_resize(conc_table_t *ct);
+
+void free_conc_table(conc_table_t *ct);
+
+
+// blocked bloom filter (one 64-byte block per key) for rejecting lookups of absent keys
+uint64_t filter_bytes(const uint64_t table_capacity);
+
+void attach_filter(hashtable_t *table, void *filter_ptr, const uint64_t nbytes);
+
+void rebuild_filter(hashtable_t *table);
+
+void filter_add(const hashtable_t *table, const uint64_t key);
+
+bool filter_may_contain(const hashtable_t *table, const uint64_t key);
+
+
+// probe sequence policies
+#define PROBE_SEED       0x8445d61a4e774912UL  // seed of the second hash used for double hashing
+#define PROBE_LINE_BYTES 64
+
+bool set_probe_policy(hashtable_t *table, const probe_policy_t policy);
+
+void probe_stats(const hashtable_t *table, probe_stats_t *stats);
+
+void print_probe_stats(const hashtable_t *table);
+
+
+static inline uint64_t
+gcd_u64(uint64_t a, uint64_t b)
+{
+    while(b != 0)
+    {
+        uint64_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+
+// per-key constant of the probe sequence (the stride for double hashing, slots per group for bucketed probing)
+static inline uint64_t 
+probe_step(const hashtable_t *table, const uint64_t key)
+{
+    uint64_t capacity = *(table->capacity);
+    
+    if(table->probe == PROBE_DOUBLE_HASH)
+    {
+        if(capacity < 3) return 1;
+        
+        // the stride has to be coprime to the capacity for the sequence to visit every slot 
+        uint64_t step = 1 + murmur_hash_64(key, PROBE_SEED) % (capacity - 1);
+        if((capacity & (capacity - 1)) == 0) return step | 1;
+        while(gcd_u64(step, capacity) != 1) step = (step % (capacity - 1)) + 1;
+        return step;
+    }
+    
+    if(table->probe == PROBE_BUCKETED)
+    {
+        uint64_t group = PROBE_LINE_BYTES / ((1 + *(table->nvals_per_item)) * sizeof(uint64_t));
+        return (group > 1) ? group : 1;
+    }
+    
+    return 1;
+}
+
+
+// slot to try on the i-th step of the probe sequence starting at home slot index
+static inline uint64_t 
+probe_slot(const hashtable_t *table, const uint64_t index, const uint64_t step, const uint64_t i)
+{
+    uint64_t capacity = *(table->capacity);
+    
+    switch(table->probe)
+    {
+        case PROBE_QUADRATIC:
+            return (index + ((i * (i + 1)) >> 1)) & (capacity - 1);
+        
+        case PROBE_DOUBLE_HASH:
+            return (uint64_t) ((index + (unsigned __int128) i * step) % capacity);
+        
+        case PROBE_BUCKETED:
+        {
+            // all slots of the home group (starting at the home slot and wrapping within the group), then the following groups 
+            uint64_t start = index - index % step;
+            return (start + (i / step) * step + (index - start + i) % step) % capacity;
+        }
+        
+        default:
+            return (index + i) % capacity;
+    }
+}
+
+
+// key-only hash set (no status word or value row, empty/deleted slots are reserved key values)
+#define SET_EMPTY_KEY   0xFFFFFFFFFFFFFFFFUL
+#define SET_DELETED_KEY 0xFFFFFFFFFFFFFFFEUL
+
+typedef struct hashset_st
+{
+    uint64_t * capacity;       // max number of keys
+    uint64_t * keys;           // array of keys
+    
+} hashset_t;
+
+
+void init_hash_set(hashset_t *set, void *base_ptr, const uint64_t set_capacity);
+
+bool set_contains(const hashset_t *set, const uint64_t key);
+
+bool set_add(hashset_t *set, const uint64_t key);
+
+bool set_remove(hashset_t *set, const uint64_t key);
+
+uint64_t set_contains_batch(const hashset_t *set, const uint64_t *keys, const uint64_t nkeys, bool *found);
+
+uint64_t set_add_batch(hashset_t *set, const uint64_t *keys, const uint64_t nkeys);
+
+uint64_t set_remove_batch(hashset_t *set, const uint64_t *keys, const uint64_t nkeys);
+
+
+// iteration over occupied slots (item pointers returned by next_item point at the status word: p[1] = key, p+2 = values)
+typedef bool (*item_filter_t)(const uint64_t key, const uint64_t *values, void *arg);
+
+typedef void (*item_visit_t)(const uint64_t key, uint64_t *values, void *arg);
+
+typedef struct hash_cursor_st
+{
+    const hashtable_t * table;
+    uint64_t next;             // next slot to inspect
+    uint64_t end;              // one past the last slot of the range
+    item_filter_t filter;      // optional predicate (NULL visits every item)
+    void * arg;                // passed through to filter
+    uint64_t now;              // items that expired before this time are skipped
+    
+} hash_cursor_t;
+
+
+void init_cursor(hash_cursor_t *cursor, const hashtable_t *table, item_filter_t filter, void *arg);
+
+void init_cursor_range(hash_cursor_t *cursor, const hashtable_t *table, const uint64_t begin, const uint64_t end, item_filter_t filter, void *arg);
+
+uint64_t *next_item(hash_cursor_t *cursor);
+
+uint64_t scan_table_parallel(const hashtable_t *table, const int nthreads, item_filter_t filter, item_visit_t visit, void *arg);
+
+
+// per-item expiration (times in ns of CLOCK_MONOTONIC, expiration time 0 = never expires)
+#define EXPIRE_SWEEP_SLOTS 4 // slots checked by the incremental sweeper on every insert or delete
+
+uint64_t hash_time_now(void);
+
+void attach_expiry(hashtable_t *table, uint64_t *expiry);
+
+uint64_t *insert_with_ttl(hashtable_t *table, const uint64_t key, const uint64_t *values, const uint64_t ttl);
+
+bool set_item_ttl(hashtable_t *table, const uint64_t key, const uint64_t ttl);
+
+uint64_t expire_step(hashtable_t *table, const uint64_t nslots);
+
+
+// an expired item reads as absent, lookups and scans skip it without touching the table
+static inline bool
+item_expired(const hashtable_t *table, const uint64_t *p, const uint64_t slot, const uint64_t now)
+{
+    return slot_state(table, p) == 1 && table->expiry[slot] != 0 && table->expiry[slot] <= now;
+}
+
+// lazy expiry: inserts and deletes turn an expired item into a deleted slot as soon as they run into it
+static inline bool
+expire_item(hashtable_t *table, uint64_t *p, const uint64_t slot, const uint64_t now)
+{
+    if(!item_expired(table, p, slot, now)) return false;
+
+    p[0] = status_word(table, 2); // set status to deleted
+    table->ntombstones++;
+    table->nexpired++;
+    return true;
+}
+
+
+// aligned table allocation: every item starts on a cache line boundary (if its size divides or is a multiple of 64 bytes)
+#define HASH_ALLOC_PAGE      0x1 // page aligned mapping instead of the heap
+#define HASH_ALLOC_HUGE_THP  0x2 // transparent huge pages (madvise)
+#define HASH_ALLOC_HUGE_2MB  0x4 // explicit 2 MB huge pages (MAP_HUGETLB), falls back to HASH_ALLOC_HUGE_THP
+#define HASH_ALLOC_PAD_SLOTS 0x8 // pad slots to 16, 32 or a multiple of 64 bytes (initialize with init_hash_table_padded())
+
+uint64_t padded_nvals(const uint64_t nvals_per_item);
+
+void *hash_table_alloc(const uint64_t table_capacity, const uint64_t nvals_per_item, const int flags);
+
+void hash_table_free(void *base_ptr);
+
+
+// table images (the table memory written to a file as it is)
+bool hash_table_save(const hashtable_t *table, const char *path);
+
+void *hash_table_load(hashtable_t *table, const char *path);
+
+
+// O(1) clear (bumps the table generation) and a pool of cleared tables of one size for reuse
+#define TABLE_POOL_MAX 64 // tables kept by a pool, more are freed on release
+
+typedef struct hashtable_pool_st
+{
+    uint64_t capacity;         // capacity of the pooled tables
+    uint64_t nvals_per_item;
+    int alloc_flags;           // hash_table_alloc() flags
+    hashtable_t * free[TABLE_POOL_MAX];
+    int nfree;
+    uint64_t nallocated;       // tables of this pool currently allocated (in the pool or out)
+
+} hashtable_pool_t;
+
+void hash_table_clear(hashtable_t *table);
+
+void init_table_pool(hashtable_pool_t *pool, const uint64_t table_capacity, const uint64_t nvals_per_item, const int alloc_flags);
+
+hashtable_t *table_pool_acquire(hashtable_pool_t *pool);
+
+void table_pool_release(hashtable_pool_t *pool, hashtable_t *table);
+
+void free_table_pool(hashtable_pool_t *pool);
+
+
+// tombstone compaction: clears deleted slots in place, moving live items back towards their home slots
+#define TOMBSTONE_MAX_LOAD 0.125 // default max_tombstones, as a fraction of the capacity
+#define COMPACT_STEP_SLOTS 8     // slots compacted per insert or delete while over max_tombstones
+
+uint64_t compact_step(hashtable_t *table, const uint64_t nslots);
+
+uint64_t compact_table(hashtable_t *table);
+
+void erase_slot(hashtable_t *table, const uint64_t slot);
+
+
+// bounded cache mode: a full table evicts a victim chosen by a CLOCK hand or by sampled LRU
+typedef enum
+{
+    EVICT_CLOCK = 0,    // second chance: access bit per slot, hand sweeps the slot array
+    EVICT_SAMPLED_LRU   // last access tick per slot, evict the oldest of a few random samples
+    
+} evict_policy_t;
+
+
+typedef struct hashcache_st
+{
+    hashtable_t * table;
+    uint64_t * access;         // per-slot access bit (CLOCK) or last access tick (sampled LRU), capacity words
+    evict_policy_t policy;
+    uint64_t max_items;        // evict once an insert takes the cache past this many items
+    uint64_t nitems;
+    uint64_t hand;             // CLOCK hand
+    uint64_t stride;           // CLOCK hand step, coprime to the capacity so a sweep still visits every slot once
+    uint64_t tick;             // logical clock for sampled LRU
+    uint64_t rng;              // sample state for sampled LRU
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    uint64_t nexpired;         // expirations of the table already taken off nitems
+    
+} hashcache_t;
+
+
+void init_hash_cache(hashcache_t *cache, hashtable_t *table, uint64_t *access, const evict_policy_t policy, const double max_load);
+
+uint64_t *cache_get(hashcache_t *cache, const uint64_t key);
+
+uint64_t *cache_put(hashcache_t *cache, const uint64_t key, const uint64_t *values);
+
+bool cache_remove(hashcache_t *cache, const uint64_t key);
+
+void print_cache_stats(const hashcache_t *cache);
+
+
+// hardware performance counters (perf_event_open) around a stretch of table operations
+typedef enum
+{
+    PERF_CYCLES = 0,
+    PERF_INSTRUCTIONS,
+    PERF_L1D_MISSES,    // L1 data cache read misses
+    PERF_LLC_MISSES,    // last level cache read misses
+    PERF_DTLB_MISSES,   // data TLB read misses
+    PERF_BRANCH_MISSES,
+    PERF_NCOUNTERS
+
+} perf_counter_t;
+
+
+typedef struct hash_perf_st
+{
+    int fd[PERF_NCOUNTERS];            // -1 where the counter isn't available
+    int navailable;
+    uint64_t start[PERF_NCOUNTERS][3]; // value, time enabled, time running at hash_perf_start()
+    uint64_t t_start;
+    double counts[PERF_NCOUNTERS];     // counts of all start/stop stretches, scaled up for multiplexing
+    uint64_t ns;                       // wall time of all start/stop stretches
+
+} hash_perf_t;
+
+
+bool init_hash_perf(hash_perf_t *perf);
+
+void hash_perf_start(hash_perf_t *perf);
+
+void hash_perf_stop(hash_perf_t *perf);
+
+void hash_perf_reset(hash_perf_t *perf);
+
+void print_hash_perf(const hash_perf_t *perf, const char *label, const uint64_t nops);
+
+void free_hash_perf(hash_perf_t *perf);
+
+
+// high dynamic range histograms of latencies in ns, see hash_hist.c
+#define HIST_SUB_BITS 7
+#define HIST_SUB      (1UL << HIST_SUB_BITS)
+#define HIST_BUCKETS  ((64 - HIST_SUB_BITS + 1) * (HIST_SUB / 2) + HIST_SUB / 2)
+
+typedef struct hash_hist_st
+{
+    uint64_t count;
+    uint64_t max;
+    uint64_t buckets[HIST_BUCKETS];
+
+} hash_hist_t;
+
+
+// values below HIST_SUB have a bucket each, above that HIST_SUB / 2 buckets per power of 2
+static inline uint64_t
+hash_hist_index(const uint64_t value)
+{
+    if(value < HIST_SUB) return value;
+
+    uint64_t shift = 63 - __builtin_clzl(value) - (HIST_SUB_BITS - 1);
+
+    return shift * (HIST_SUB / 2) + (value >> shift);
+}
+
+static inline void
+hash_hist_record(hash_hist_t *h, const uint64_t value)
+{
+    h->buckets[hash_hist_index(value)]++;
+    h->count++;
+    if(value > h->max) h->max = value;
+}
+
+uint64_t hash_hist_value(const uint64_t i);
+
+void hash_hist_add(hash_hist_t *dst, const hash_hist_t *src);
+
+uint64_t hash_hist_quantile(const hash_hist_t *h, const double q);
@@ -0,0 +1,306 @@
+/*
+    In-table aggregation (group-by) for the generic hash table.
+
+    The nvals_per_item - 2 values of an item are used as accumulators: every aggregate call does a
+    single probe pass find-or-insert of the key and then folds the deltas into its value row in
+    place (count, sum, min or max). Three flavours:
+
+    aggregate_item()          single threaded, plain loads and stores.
+    aggregate_item_atomic()   any number of threads on one shared table. New keys claim their
+                              slot with a compare-and-swap of the status word (empty -> SLOT_BUSY
+                              -> occupied, values initialized in between), accumulation is an
+                              atomic fetch-add (count, sum) or a CAS loop (min, max).
+    aggregate_local()         every thread pre-aggregates into a small private table and merges
+                              it into the shared one with the atomic path whenever it fills up
+                              (and at the end, flush_agg_local()), which takes the contention off
+                              hot keys.
+
+    The atomic path never reuses deleted slots (two threads could otherwise insert the same key
+    at different tombstones) and doesn't maintain a filter or expiry array, so it requires a table
+    without either attached.
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <assert.h>
+
+# include "hash.h"
+
+
+#define AGG_LOCAL_MAX_LOAD 0.5 // private tables are merged once they are half full
+
+
+
+static inline void
+accumulate(uint64_t *vals, const uint64_t *deltas, const uint64_t nvals, const agg_op_t op)
+{
+    uint64_t j;
+
+    for(j = 0; j < nvals; j++)
+    {
+        switch(op)
+        {
+            case AGG_COUNT: vals[j] += 1; break;
+            case AGG_SUM:   vals[j] += deltas[j]; break;
+            case AGG_MIN:   if(deltas[j] < vals[j]) vals[j] = deltas[j]; break;
+            case AGG_MAX:   if(deltas[j] > vals[j]) vals[j] = deltas[j]; break;
+        }
+    }
+}
+
+
+static inline void
+accumulate_atomic(uint64_t *vals, const uint64_t *deltas, const uint64_t nvals, const agg_op_t op)
+{
+    uint64_t j, old;
+
+    for(j = 0; j < nvals; j++)
+    {
+        switch(op)
+        {
+            case AGG_COUNT:
+                __atomic_fetch_add(&vals[j], 1, __ATOMIC_RELAXED);
+                break;
+
+            case AGG_SUM:
+                __atomic_fetch_add(&vals[j], deltas[j], __ATOMIC_RELAXED);
+                break;
+
+            case AGG_MIN:
+                old = __atomic_load_n(&vals[j], __ATOMIC_RELAXED);
+                while(deltas[j] < old && !__atomic_compare_exchange_n(&vals[j], &old, deltas[j], true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+                break;
+
+            case AGG_MAX:
+                old = __atomic_load_n(&vals[j], __ATOMIC_RELAXED);
+                while(deltas[j] > old && !__atomic_compare_exchange_n(&vals[j], &old, deltas[j], true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+                break;
+        }
+    }
+}
+
+
+// value row of a newly inserted key: the first deltas (a count of 1 for AGG_COUNT)
+static inline void
+first_values(uint64_t *init, const uint64_t *deltas, const uint64_t nvals, const agg_op_t op)
+{
+    uint64_t j;
+
+    for(j = 0; j < nvals; j++)
+    {
+        init[j] = (op == AGG_COUNT) ? 1 : deltas[j];
+    }
+}
+
+
+uint64_t *
+aggregate_item(hashtable_t *table, const uint64_t key, const uint64_t *deltas, const agg_op_t op)
+{
+    uint64_t nvals = table->nvals;
+    bool inserted;
+    uint64_t *vals = find_or_insert(table, key, &inserted);
+
+    if(vals == NULL) return NULL;
+
+    if(inserted)
+    {
+        first_values(vals, deltas, nvals, op);
+    }
+    else
+    {
+        accumulate(vals, deltas, nvals, op);
+    }
+
+    return vals;
+}
+
+
+/*
+    Thread safe find-or-insert. A thread that finds an empty slot tries to claim it by swapping
+    its status from empty to SLOT_BUSY, writes key and init_values (zeros if NULL) and only then
+    publishes the item by setting the status to occupied. Threads that run into a busy slot wait
+    for it to be published, since it might be their own key.
+*/
+uint64_t *
+find_or_insert_atomic(hashtable_t *table, const uint64_t key, const uint64_t *init_values, bool *inserted)
+{
+    assert(table != NULL && table->filter == NULL && table->expiry == NULL);
+
+    void *base_ptr = table->capacity;
+    uint64_t capacity = *(table->capacity);
+    uint64_t nvals_per_item = *(table->nvals_per_item);
+    uint64_t size_of_item = (1 + nvals_per_item) * sizeof(uint64_t);
+
+    uint64_t index = hash(key, capacity);
+    uint64_t step = probe_step(table, key);
+
+    uint64_t empty = status_word(table, 0);
+    uint64_t i, j, word;
+    uint64_t *p;
+
+    if(inserted != NULL) *inserted = false;
+
+    for(i = 0; i < capacity; i++)
+    {
+        uint64_t try = probe_slot(table, index, step, i);
+
+        p = base_ptr + 3*sizeof(uint64_t) + try*size_of_item;
+
+        // compare and swap works on the whole status word, a slot of an older generation is just as empty
+        word = __atomic_load_n(&p[0], __ATOMIC_ACQUIRE);
+
+        while(word == empty || (word >> SLOT_GEN_SHIFT) != table->gen)
+        {
+            if(__atomic_compare_exchange_n(&p[0], &word, status_word(table, SLOT_BUSY), false, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE))
+            {
+                p[1] = key;
+                for(j = 0; j < table->nvals; j++)
+                {
+                    p[2 + j] = (init_values != NULL) ? init_values[j] : 0;
+                }
+                __atomic_store_n(&p[0], status_word(table, 1), __ATOMIC_RELEASE);
+
+                if(inserted != NULL) *inserted = true;
+                return p + 2;
+            }
+            // lost the race, word now holds what the winner put there
+        }
+
+        while(word == status_word(table, SLOT_BUSY))
+        {
+            cpu_relax();
+            word = __atomic_load_n(&p[0], __ATOMIC_ACQUIRE);
+        }
+
+        if(word == status_word(table, 1) && p[1] == key) return p + 2;
+    }
+
+    printf("\n Warning! Unable to insert new item with key: %lu. Ran out of empty slots. \n",key);
+    return NULL;
+}
+
+
+uint64_t *
+aggregate_item_atomic(hashtable_t *table, const uint64_t key, const uint64_t *deltas, const agg_op_t op)
+{
+    uint64_t nvals = table->nvals;
+    uint64_t init[nvals];
+    bool inserted;
+    uint64_t *vals;
+
+    first_values(init, deltas, nvals, op);
+
+    vals = find_or_insert_atomic(table, key, init, &inserted);
+
+    if(vals != NULL && !inserted) accumulate_atomic(vals, deltas, nvals, op);
+
+    return vals;
+}
+
+
+
+/*
+    Thread local pre-aggregation. Partial aggregates are merged with the op that combines them:
+    partial counts and sums add up, partial minima and maxima take the min and max again.
+*/
+
+bool
+init_agg_local(agg_local_t *local, hashtable_t *shared, const uint64_t capacity, const agg_op_t op)
+{
+    uint64_t nvals_per_item = shared->nvals + 2; // the private table isn't padded
+    uint64_t table_bytes = 2 * sizeof(uint64_t) + capacity * (1 + nvals_per_item) * sizeof(uint64_t);
+
+    *local = (agg_local_t) {.shared = shared, .op = op};
+
+    if(capacity < 1)
+    {
+        printf("\n Invalid capacity. Unable to initialize thread local aggregation. \n");
+        return false;
+    }
+
+    local->base_ptr = calloc(1, table_bytes);
+    if(local->base_ptr == NULL) return false;
+
+    init_hash_table(&local->table, local->base_ptr, capacity, nvals_per_item);
+
+    if(local->table.items == NULL)
+    {
+        free(local->base_ptr);
+        local->base_ptr = NULL;
+        return false;
+    }
+
+    local->max_items = (uint64_t) (AGG_LOCAL_MAX_LOAD * capacity);
+    if(local->max_items < 1) local->max_items = 1;
+
+    return true;
+}
+
+
+// merge the private table into the shared one and empty it, on failure the keys that couldn't be merged stay in the private table
+bool
+flush_agg_local(agg_local_t *local)
+{
+    hashtable_t *table = &local->table;
+    void *base_ptr = table->capacity;
+    uint64_t capacity = *(table->capacity);
+    uint64_t size_of_item = (1 + *(table->nvals_per_item)) * sizeof(uint64_t);
+    agg_op_t merge_op = (local->op == AGG_COUNT) ? AGG_SUM : local->op;
+    uint64_t i, nleft = 0, *p;
+
+    for(i = 0; i < capacity; i++)
+    {
+        p = base_ptr + 3*sizeof(uint64_t) + i*size_of_item;
+
+        if(slot_state(table, p) != 1) continue;
+
+        if(aggregate_item_atomic(local->shared, p[1], p + 2, merge_op) == NULL)
+        {
+            nleft++;
+            continue;
+        }
+
+        p[0] = status_word(table, 2); // merged, set status to deleted
+        table->ntombstones++;
+    }
+
+    if(nleft == 0) hash_table_clear(table);
+    local->nitems = nleft;
+
+    return nleft == 0;
+}
+
+
+bool
+aggregate_local(agg_local_t *local, const uint64_t key, const uint64_t *deltas)
+{
+    bool inserted;
+    uint64_t nvals = local->table.nvals;
+    uint64_t *vals = find_or_insert(&local->table, key, &inserted);
+
+    if(vals == NULL) return false;
+
+    if(inserted)
+    {
+        first_values(vals, deltas, nvals, local->op);
+        if(++local->nitems >= local->max_items) return flush_agg_local(local);
+    }
+    else
+    {
+        accumulate(vals, deltas, nvals, local->op);
+    }
+
+    return true;
+}
+
+
+void
+free_agg_local(agg_local_t *local)
+{
+    free(local->table.items);
+    free(local->base_ptr);
+    local->base_ptr = NULL;
+}
@@ -0,0 +1,173 @@
+/*
+    Test driver for in-table aggregation: several threads count, sum and take the minimum of the
+    same keys on shared tables, half of them with aggregate_item_atomic() and half through their
+    own thread local pre-aggregation, and the totals are checked against the single threaded
+    aggregate_item(). Then a flush into a shared table that runs full has to keep the keys it
+    couldn't merge.
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <pthread.h>
+
+# include "hash.h"
+
+
+#define TABLE_SIZE 8192
+#define ITEM_NVALS 3      // needs to be >= 3
+#define NTHREADS   8
+#define NKEYS      2000
+#define NROWS      400000 // rows aggregated by every thread
+
+
+
+hashtable_t sum_table = {NULL}, min_table = {NULL}, count_table = {NULL};
+uint64_t nfailed = 0;
+
+
+static void *
+agg_thread(void *arg)
+{
+    long id = (long) arg;
+    agg_local_t sums, counts;
+    uint64_t i;
+
+    if(!init_agg_local(&sums, &sum_table, 512, AGG_SUM) || !init_agg_local(&counts, &count_table, 512, AGG_COUNT))
+    {
+        __atomic_fetch_add(&nfailed, 1, __ATOMIC_RELAXED);
+        return NULL;
+    }
+
+    for(i = 0; i < NROWS; i++)
+    {
+        uint64_t key = (i * 7 + id) % NKEYS;
+        uint64_t delta = key + 1;
+        uint64_t low = i + id;
+        bool ok;
+
+        if(id % 2 == 0)
+        {
+            ok = aggregate_item_atomic(&sum_table, key, &delta, AGG_SUM) != NULL;
+            ok = ok && aggregate_item_atomic(&count_table, key, &delta, AGG_COUNT) != NULL;
+        }
+        else
+        {
+            ok = aggregate_local(&sums, key, &delta) && aggregate_local(&counts, key, &delta);
+        }
+
+        ok = ok && aggregate_item_atomic(&min_table, key, &low, AGG_MIN) != NULL;
+
+        if(!ok) __atomic_fetch_add(&nfailed, 1, __ATOMIC_RELAXED);
+    }
+
+    if(!flush_agg_local(&sums) || !flush_agg_local(&counts)) __atomic_fetch_add(&nfailed, 1, __ATOMIC_RELAXED);
+
+    free_agg_local(&sums);
+    free_agg_local(&counts);
+
+    return NULL;
+}
+
+
+
+int main()
+{
+
+    hashtable_t expected = {NULL}, expected_min = {NULL};
+
+    uint64_t table_capacity = TABLE_SIZE;
+    uint64_t nvals_per_item = ITEM_NVALS;
+    uint64_t table_bytes = 2 * sizeof(uint64_t) + table_capacity * (1 + nvals_per_item) * sizeof(uint64_t);
+    uint64_t i, key, nwrong = 0;
+    uint64_t *vals;
+    pthread_t threads[NTHREADS];
+    long t;
+    void * base_ptr[5];
+
+    for(i = 0; i < 5; i++) base_ptr[i] = calloc(1, table_bytes);
+
+    init_hash_table(&sum_table, base_ptr[0], table_capacity, nvals_per_item);
+    init_hash_table(&min_table, base_ptr[1], table_capacity, nvals_per_item);
+    init_hash_table(&count_table, base_ptr[2], table_capacity, nvals_per_item);
+    init_hash_table(&expected, base_ptr[3], table_capacity, nvals_per_item);
+    init_hash_table(&expected_min, base_ptr[4], table_capacity, nvals_per_item);
+
+
+    // testing...
+
+    for(t = 0; t < NTHREADS; t++) pthread_create(&threads[t], NULL, agg_thread, (void *) t);
+    for(t = 0; t < NTHREADS; t++) pthread_join(threads[t], NULL);
+
+    // the same rows single threaded, the per key count goes into the expected table
+    for(t = 0; t < NTHREADS; t++)
+    {
+        for(i = 0; i < NROWS; i++)
+        {
+            uint64_t low = i + t;
+            aggregate_item(&expected, (i * 7 + t) % NKEYS, NULL, AGG_COUNT);
+            aggregate_item(&expected_min, (i * 7 + t) % NKEYS, &low, AGG_MIN);
+        }
+    }
+
+    for(key = 0; key < NKEYS; key++)
+    {
+        uint64_t count = find_item(&expected, key)[0];
+
+        vals = find_item(&count_table, key);
+        nwrong += (vals == NULL || vals[0] != count);
+
+        vals = find_item(&sum_table, key);
+        nwrong += (vals == NULL || vals[0] != count * (key + 1));
+
+        vals = find_item(&min_table, key);
+        nwrong += (vals == NULL || vals[0] != find_item(&expected_min, key)[0]);
+    }
+    printf("\n %i threads, %i keys: %lu failed calls, %lu wrong aggregates \n",NTHREADS,NKEYS,nfailed,nwrong);
+    nwrong += nfailed;
+
+    // a shared table with room for 10 keys only: the flush keeps the other keys
+    hashtable_t small_table = {NULL};
+    agg_local_t local;
+    void * small_base = calloc(1, 2 * sizeof(uint64_t) + 10 * (1 + nvals_per_item) * sizeof(uint64_t));
+
+    init_hash_table(&small_table, small_base, 10, nvals_per_item);
+    nwrong += !init_agg_local(&local, &small_table, 256, AGG_SUM);
+
+    for(key = 0; key < 50; key++)
+    {
+        uint64_t delta = 1;
+        aggregate_local(&local, key, &delta);
+    }
+    nwrong += flush_agg_local(&local);
+    printf("\n Flush into a full table: %lu keys left in the private table \n",local.nitems);
+    nwrong += (local.nitems != 40);
+
+    uint64_t total = 0;
+    for(key = 0; key < 50; key++)
+    {
+        uint64_t *shared = find_item(&small_table, key), *kept = find_item(&local.table, key);
+        nwrong += ((shared == NULL) == (kept == NULL));
+        total += (shared != NULL) ? shared[0] : kept[0];
+    }
+    nwrong += (total != 50);
+    free_agg_local(&local);
+
+    // rejected capacity
+    nwrong += init_agg_local(&local, &small_table, 0, AGG_SUM);
+
+    printf("\n %s \n\n",(nwrong == 0) ? "All checks passed." : "Some checks FAILED.");
+
+    free(sum_table.items);
+    free(min_table.items);
+    free(count_table.items);
+    free(expected.items);
+    free(expected_min.items);
+    free(small_table.items);
+    for(i = 0; i < 5; i++) free(base_ptr[i]);
+    free(small_base);
+
+	return (nwrong == 0) ? 0 : 1;
+}
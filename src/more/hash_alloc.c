@@ -0,0 +1,172 @@
+/*
+    Aligned (and optionally huge page backed) allocation of the memory of a generic hash table.
+
+    Items sit at base_ptr + 2 words + i * size_of_item (the leading word of every item being the
+    unused one), so base_ptr is placed 2 words short of a cache line boundary: then every item
+    starts on a cache line boundary whenever the item size divides or is a multiple of 64 bytes,
+    which HASH_ALLOC_PAD_SLOTS arranges by making room for slots of padded_nvals() words. The
+    padding stays inside the table: init_hash_table_padded() lays the slots out that wide, while
+    value rows passed in and out keep their nvals_per_item - 2 words.
+
+    The cache line in front of base_ptr holds the bookkeeping hash_table_free() needs (where the
+    allocation starts, how long a mapping it is and how it was allocated):
+
+        [ ... ][magic][start][mapped bytes][flags][capacity][nvals_per_item][items ...]
+                                                         ^ base_ptr (64-byte boundary - 16 bytes)
+
+    Plain allocations use aligned_alloc(). HASH_ALLOC_PAGE and the huge page flags map the block
+    with mmap() instead: HASH_ALLOC_HUGE_THP asks for transparent huge pages with madvise(),
+    HASH_ALLOC_HUGE_2MB maps explicit 2 MB pages (MAP_HUGETLB, which needs pages reserved in
+    /proc/sys/vm/nr_hugepages) and falls back to transparent huge pages if that fails.
+*/
+
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+# include "hash.h"
+
+
+#define HASH_ALLOC_MAGIC 0x68617368616c6c6fUL // "hashallo"
+#define HUGE_PAGE_BYTES  (2UL << 20)
+
+
+
+static inline uint64_t
+round_up(const uint64_t n, const uint64_t to)
+{
+    return (n + to - 1) / to * to;
+}
+
+
+// smallest nvals_per_item >= nvals_per_item whose item size is 16, 32 or a multiple of 64 bytes
+uint64_t
+padded_nvals(const uint64_t nvals_per_item)
+{
+    uint64_t size_of_item = (1 + nvals_per_item) * sizeof(uint64_t);
+
+    if(size_of_item <= 16) size_of_item = 16;
+    else if(size_of_item <= 32) size_of_item = 32;
+    else size_of_item = round_up(size_of_item, PROBE_LINE_BYTES);
+
+    return size_of_item / sizeof(uint64_t) - 1;
+}
+
+
+/*
+    Allocate the memory for a table of table_capacity items and return its base_ptr for
+    init_hash_table() (NULL on failure). With HASH_ALLOC_PAD_SLOTS the memory is initialized with
+    init_hash_table_padded() and the same nvals_per_item instead.
+*/
+void *
+hash_table_alloc(const uint64_t table_capacity, const uint64_t nvals_per_item, const int flags)
+{
+    if(nvals_per_item < 3 || table_capacity < 1)
+    {
+        printf("\n Invalid table_capacity or nvals_per_item. Unable to allocate hash table. \n");
+        return NULL;
+    }
+
+    uint64_t slot_nvals = (flags & HASH_ALLOC_PAD_SLOTS) ? padded_nvals(nvals_per_item) : nvals_per_item;
+    uint64_t table_bytes = 2 * sizeof(uint64_t) + table_capacity * (1 + slot_nvals) * sizeof(uint64_t);
+    uint64_t block_bytes = PROBE_LINE_BYTES + round_up(table_bytes - 2 * sizeof(uint64_t), PROBE_LINE_BYTES);
+    uint64_t page_bytes = sysconf(_SC_PAGESIZE);
+    int mode = flags & (HASH_ALLOC_PAGE | HASH_ALLOC_HUGE_THP | HASH_ALLOC_HUGE_2MB);
+    void *block = NULL, *map = NULL;
+    uint64_t map_bytes = 0;
+
+    if(mode == 0)
+    {
+        block = aligned_alloc(PROBE_LINE_BYTES, block_bytes);
+    }
+
+    if(mode & HASH_ALLOC_HUGE_2MB)
+    {
+        block_bytes = round_up(block_bytes, HUGE_PAGE_BYTES);
+        map_bytes = block_bytes;
+        map = mmap(NULL, map_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+
+        if(map == MAP_FAILED)
+        {
+            printf("\n Warning! Unable to map %lu bytes of 2 MB huge pages, falling back to transparent huge pages. \n",block_bytes);
+            map = NULL;
+            mode = HASH_ALLOC_HUGE_THP;
+        }
+        block = map;
+    }
+
+    if(block == NULL && (mode & HASH_ALLOC_HUGE_THP))
+    {
+        // transparent huge pages only back 2 MB aligned stretches, so map 2 MB extra and align the block
+        block_bytes = round_up(block_bytes, HUGE_PAGE_BYTES);
+        map_bytes = block_bytes + HUGE_PAGE_BYTES;
+        map = mmap(NULL, map_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+        if(map == MAP_FAILED) map = NULL;
+
+        if(map != NULL)
+        {
+            block = (void *) round_up((uint64_t) map, HUGE_PAGE_BYTES);
+
+            if(madvise(block, block_bytes, MADV_HUGEPAGE) != 0)
+            {
+                printf("\n Warning! Transparent huge pages are not available, using normal pages. \n");
+            }
+        }
+    }
+    else if(block == NULL && mode != 0)
+    {
+        map_bytes = round_up(block_bytes, page_bytes);
+        map = mmap(NULL, map_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+        if(map == MAP_FAILED) map = NULL;
+        block = map;
+    }
+
+    if(block == NULL)
+    {
+        printf("\n Unable to allocate %lu bytes for the hash table. \n",block_bytes);
+        return NULL;
+    }
+
+    uint64_t *header = (uint64_t *) ((char *) block + PROBE_LINE_BYTES) - 6;
+
+    header[0] = HASH_ALLOC_MAGIC;
+    header[1] = (uint64_t) ((mode == 0) ? block : map);
+    header[2] = map_bytes;
+    header[3] = mode;
+
+    return header + 4;
+}
+
+
+// release a table allocated with hash_table_alloc() (call free() on table->items separately)
+void
+hash_table_free(void *base_ptr)
+{
+    if(base_ptr == NULL) return;
+
+    uint64_t *header = (uint64_t *) base_ptr - 4;
+
+    if(header[0] != HASH_ALLOC_MAGIC)
+    {
+        printf("\n Warning! Memory at %p was not allocated with hash_table_alloc(). \n",base_ptr);
+        return;
+    }
+
+    header[0] = 0;
+
+    if(header[3] == 0)
+    {
+        free((void *) header[1]);
+    }
+    else
+    {
+        munmap((void *) header[1], header[2]);
+    }
+}
@@ -0,0 +1,124 @@
+/*
+    Test driver for padded table allocation: a table of 5 word items gets 8 word (64 byte) slots,
+    every item has to start on a cache line boundary, and value rows still only have the caller's
+    width, in and out: inserts, atomic inserts, a table image and a merge into an unpadded table
+    must only ever copy those words (run under AddressSanitizer to catch a longer copy).
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+# include "hash.h"
+
+
+#define TABLE_SIZE 4096
+#define ITEM_NVALS 4 // needs to be >= 3, two values per item
+#define NITEMS     2000
+#define IMAGE_PATH "hash_alloc_test.img"
+
+
+
+static uint64_t
+check_values(const hashtable_t *table, const uint64_t factor)
+{
+    uint64_t key, nbad = 0;
+
+    for(key = 1; key <= NITEMS; key++)
+    {
+        uint64_t *vals = find_item((hashtable_t *) table, key);
+        nbad += (vals == NULL || vals[0] != factor * key || vals[1] != ~key);
+    }
+
+    return nbad;
+}
+
+
+
+int main()
+{
+
+    hashtable_t my_table = {NULL}, loaded = {NULL}, plain = {NULL};
+    hashtable_pool_t pool;
+
+    uint64_t table_capacity = TABLE_SIZE;
+    uint64_t nvals_per_item = ITEM_NVALS;
+    uint64_t key, nwrong = 0;
+    bool inserted;
+
+
+    // testing...
+
+    void * base_ptr = hash_table_alloc(table_capacity, nvals_per_item, HASH_ALLOC_PAD_SLOTS);
+    init_hash_table_padded(&my_table, base_ptr, table_capacity, nvals_per_item);
+
+    printf("\n %lu values per item, slots of %lu words \n",my_table.nvals,*(my_table.nvals_per_item) + 1);
+    nwrong += (my_table.nvals != nvals_per_item - 2 || *(my_table.nvals_per_item) != padded_nvals(nvals_per_item));
+
+    for(key = 0; key < table_capacity; key++) nwrong += ((uintptr_t) my_table.items[key] % PROBE_LINE_BYTES != 0);
+
+    // every row exactly as wide as the table's values
+    for(key = 1; key <= NITEMS; key++)
+    {
+        uint64_t *row = malloc(my_table.nvals * sizeof(uint64_t));
+
+        row[0] = key, row[1] = ~key;
+        nwrong += ((key % 2 == 0) ? insert_or_assign(&my_table, key, row) : find_or_insert_atomic(&my_table, key, row, &inserted)) == NULL;
+        free(row);
+    }
+    nwrong += check_values(&my_table, 1);
+
+    // the image keeps both widths
+    nwrong += !hash_table_save(&my_table, IMAGE_PATH);
+    void * loaded_ptr = hash_table_load(&loaded, IMAGE_PATH);
+    remove(IMAGE_PATH);
+
+    nwrong += (loaded_ptr == NULL || loaded.nvals != my_table.nvals || *(loaded.nvals_per_item) != *(my_table.nvals_per_item));
+    if(loaded_ptr != NULL) nwrong += check_values(&loaded, 1);
+
+    // merging the padded table into an unpadded one, which has to grow for it
+    void * plain_ptr = hash_table_alloc(NITEMS / 2, nvals_per_item, 0);
+    init_hash_table(&plain, plain_ptr, NITEMS / 2, nvals_per_item);
+
+    for(key = 1; key <= NITEMS; key++)
+    {
+        uint64_t row[2] = {key, ~key};
+        if(key <= NITEMS / 4) nwrong += (insert_or_assign(&plain, key, row) == NULL);
+    }
+
+    void * merged_ptr = hash_table_merge(&plain, &my_table, MERGE_SUM, 4);
+    nwrong += (merged_ptr == NULL || merged_ptr == plain_ptr);
+
+    // keys in both got their first values summed, ~key is summed too
+    for(key = 1; key <= NITEMS; key++)
+    {
+        uint64_t *vals = find_item(&plain, key);
+        bool both = key <= NITEMS / 4;
+        nwrong += (vals == NULL || vals[0] != (both ? 2 * key : key) || vals[1] != (both ? 2 * ~key : ~key));
+    }
+
+    // pooled tables are padded the same way
+    init_table_pool(&pool, table_capacity, nvals_per_item, HASH_ALLOC_PAD_SLOTS);
+    hashtable_t *pooled = table_pool_acquire(&pool);
+
+    nwrong += (pooled == NULL || pooled->nvals != nvals_per_item - 2 || *(pooled->nvals_per_item) != padded_nvals(nvals_per_item));
+    if(pooled != NULL) table_pool_release(&pool, pooled);
+    free_table_pool(&pool);
+
+    printf("\n %s \n\n",(nwrong == 0) ? "All checks passed." : "Some checks FAILED.");
+
+    free(my_table.items);
+    hash_table_free(base_ptr);
+    if(loaded_ptr != NULL)
+    {
+        free(loaded.items);
+        hash_table_free(loaded_ptr);
+    }
+    free(plain.items);
+    if(merged_ptr != NULL) hash_table_free(merged_ptr);
+    hash_table_free(plain_ptr);
+
+	return (nwrong == 0) ? 0 : 1;
+}
@@ -0,0 +1,1192 @@
+/*
+    Tail latency harness: replays a YCSB style operation mix against one of the table engines and
+    records the latency of every single operation in HDR histograms.
+
+        hash_bench [-e engine] [-w workload] [-d uniform|zipf] [-z theta] [-n nkeys] [-l load,...]
+                   [-t nthreads,...] [-s seconds] [-i interval] [-v nvals_per_item] [-C] [-P]
+
+    Engines: the generic table with each probe policy (linear, quadratic, double, bucketed),
+    cuckoo, hopscotch, chain and the concurrent growable table (conc), or all of them. The
+    single threaded engines get a private table of nkeys keys per thread, the threads of conc
+    share one table of nkeys keys.
+
+    Workloads:
+        readonly   100% reads                                   (YCSB C)
+        read        95% reads,  5% updates                      (YCSB B)
+        update      50% reads, 50% updates                      (YCSB A)
+        churn       50% reads, 50% insert of a new key + delete of the oldest one
+
+    Keys are drawn uniformly or from a Zipfian distribution over the live keys (YCSB's
+    generator). Under churn the live keys are a window sliding over the key ids and the
+    Zipfian ranks count from the newest key, so recently inserted keys are the hot ones
+    (YCSB's "latest"). Key ids are scrambled with murmur_hash_64() before they reach a table.
+
+    Every operation is timed on its own with hash_time_now() (the timer overhead is measured
+    and printed, it's part of every sample) and recorded into a log bucketed histogram
+    (hash_hist.c), so percentiles are exact to within 1.6%. Every interval the threads stop at
+    a barrier and one line of ops/s, p50/p99/p99.9/max and the state of the table
+    (tombstones, longest cluster, probes of unsuccessful lookups, for the engines that have
+    them) is printed, which shows how tombstones and clustering inflate the tail over a long
+    run. -C switches off the incremental tombstone compaction of the generic
+    table to see the worst case. At the end p50/p99/p99.9/max of every operation are
+    summarized across the thread counts.
+
+    -P profiles instead: for every engine and load factor one thread inserts nkeys keys,
+    looks them all up, looks up as many absent keys, updates and deletes them all, each
+    batch bracketed by the hardware counters of hash_perf.c, and prints time, cycles,
+    instructions, L1D/LLC/dTLB misses and branch misses per operation. A batch that only
+    computes hash() of the keys is the baseline for the cost of hashing, the rest of an
+    operation is probing and memory layout. Without counters only the times are printed.
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <pthread.h>
+
+# include "hash.h"
+# include "cuckoo.h"
+# include "hopscotch.h"
+# include "chain.h"
+
+
+#define BENCH_MAX_THREADS 256
+#define BENCH_MAX_RUNS    16     // thread counts or load factors per engine
+#define BENCH_KEY_SEED    0x2545f4914f6cdd1dUL
+#define BENCH_TIMER_REPS  100000
+
+
+typedef enum
+{
+    OP_READ = 0,
+    OP_UPDATE,
+    OP_INSERT,
+    OP_DELETE,
+    OP_KINDS
+
+} bench_op_t;
+
+static const char *op_names[OP_KINDS] = {"read", "update", "insert", "delete"};
+
+
+typedef struct
+{
+    const char * name;
+    int read_pct;              // reads, the rest are updates (or insert + delete pairs under churn)
+    bool churn;
+
+} bench_mix_t;
+
+static const bench_mix_t mixes[] =
+{
+    {"readonly", 100, false},
+    {"read",      95, false},
+    {"update",    50, false},
+    {"churn",     50, true},
+};
+
+
+// what the harness reads about a table between intervals
+typedef struct
+{
+    bool has_probes;           // generic tables only
+    uint64_t capacity;
+    uint64_t ntombstones;
+    uint64_t max_cluster;
+    double miss_probes;
+
+} bench_table_stats_t;
+
+
+typedef struct bench_engine_st
+{
+    const char * name;
+    bool shared;               // one table for all threads, otherwise a private table per thread
+    probe_policy_t probe;      // generic tables
+
+    void * (*create)(const struct bench_engine_st *engine, const uint64_t capacity, const uint64_t nvals_per_item, const bool compact);
+    bool   (*upsert)(void *table, const uint64_t key, const uint64_t *values);
+    bool   (*lookup)(void *table, const uint64_t key, uint64_t *values);
+    bool   (*remove)(void *table, const uint64_t key);
+    void   (*stats)(void *table, bench_table_stats_t *stats);
+    void   (*destroy)(void *table);
+
+} bench_engine_t;
+
+
+typedef struct
+{
+    uint64_t n;
+    double theta, alpha, zetan, eta, half_pow_theta;
+
+} zipf_t;
+
+
+typedef struct bench_run_st bench_run_t;
+
+typedef struct
+{
+    bench_run_t * run;
+    int id;
+    void * table;
+    uint64_t lo, hi;           // live key window [lo, hi) of the thread
+    uint64_t rng;
+    uint64_t nfailed;          // inserts the engine refused
+    uint64_t sink;
+    hash_hist_t * hist[OP_KINDS]; // latencies of the current interval
+
+} bench_worker_t;
+
+
+struct bench_run_st
+{
+    const bench_engine_t * engine;
+    const bench_mix_t * mix;
+    bool zipfian;
+    zipf_t zipf;
+    int nthreads;
+    uint64_t nkeys;            // per thread window under churn or for private tables, all keys of a shared table otherwise
+    uint64_t nvals_per_item;
+    void * shared_table;
+    uint64_t deadline;         // end of the current interval, written by the main thread between the barriers
+    bool done;
+    pthread_barrier_t barrier;
+    bench_worker_t workers[BENCH_MAX_THREADS];
+};
+
+
+
+/* ------------------------------------------------------------------------------------------ */
+/* engines */
+
+typedef struct
+{
+    hashtable_t table;
+    void * base_ptr;
+
+} generic_bench_t;
+
+
+static void *
+generic_create(const bench_engine_t *engine, const uint64_t capacity, const uint64_t nvals_per_item, const bool compact)
+{
+    generic_bench_t *g = malloc(sizeof(generic_bench_t));
+
+    if(g == NULL) return NULL;
+
+    g->base_ptr = hash_table_alloc(capacity, nvals_per_item, 0);
+    if(g->base_ptr == NULL)
+    {
+        free(g);
+        return NULL;
+    }
+
+    init_hash_table(&g->table, g->base_ptr, capacity, nvals_per_item);
+
+    if(!set_probe_policy(&g->table, engine->probe))
+    {
+        free(g->table.items);
+        hash_table_free(g->base_ptr);
+        free(g);
+        return NULL;
+    }
+
+    if(!compact) g->table.max_tombstones = 0;
+
+    return g;
+}
+
+static bool
+generic_upsert(void *table, const uint64_t key, const uint64_t *values)
+{
+    return insert_or_assign(&((generic_bench_t *) table)->table, key, values) != NULL;
+}
+
+static bool
+generic_lookup(void *table, const uint64_t key, uint64_t *values)
+{
+    uint64_t *vals = find_item(&((generic_bench_t *) table)->table, key);
+
+    if(vals == NULL) return false;
+
+    values[0] = vals[0];
+    return true;
+}
+
+static bool
+generic_remove(void *table, const uint64_t key)
+{
+    return erase_item(&((generic_bench_t *) table)->table, key);
+}
+
+static void
+generic_stats(void *table, bench_table_stats_t *stats)
+{
+    hashtable_t *t = &((generic_bench_t *) table)->table;
+    probe_stats_t ps;
+
+    probe_stats(t, &ps);
+
+    *stats = (bench_table_stats_t) {.has_probes = true, .capacity = *(t->capacity), .ntombstones = t->ntombstones,
+                                    .max_cluster = ps.max_cluster, .miss_probes = ps.mean_miss_probes};
+}
+
+static void
+generic_destroy(void *table)
+{
+    generic_bench_t *g = table;
+
+    free(g->table.items);
+    hash_table_free(g->base_ptr);
+    free(g);
+}
+
+
+typedef struct
+{
+    cuckoo_table_t table;
+    void * base_ptr;
+    uint64_t capacity;
+
+} cuckoo_bench_t;
+
+static void *
+cuckoo_create(const bench_engine_t *engine, const uint64_t capacity, const uint64_t nvals_per_item, const bool compact)
+{
+    cuckoo_bench_t *c = malloc(sizeof(cuckoo_bench_t));
+    void *base_ptr = malloc(cuckoo_table_bytes(capacity, nvals_per_item));
+
+    (void) engine;
+    (void) compact;
+
+    if(c == NULL || base_ptr == NULL)
+    {
+        free(c);
+        free(base_ptr);
+        return NULL;
+    }
+
+    init_cuckoo_table(&c->table, base_ptr, capacity, nvals_per_item);
+    c->base_ptr = base_ptr;
+    c->capacity = capacity;
+
+    return c;
+}
+
+static bool
+cuckoo_upsert(void *table, const uint64_t key, const uint64_t *values)
+{
+    return cuckoo_insert_item(&((cuckoo_bench_t *) table)->table, key, values);
+}
+
+static bool
+cuckoo_lookup(void *table, const uint64_t key, uint64_t *values)
+{
+    uint64_t *vals = cuckoo_lookup_item(&((cuckoo_bench_t *) table)->table, key);
+
+    if(vals == NULL) return false;
+
+    values[0] = vals[0];
+    return true;
+}
+
+static bool
+cuckoo_remove(void *table, const uint64_t key)
+{
+    return cuckoo_delete_item(&((cuckoo_bench_t *) table)->table, key);
+}
+
+static void
+cuckoo_stats(void *table, bench_table_stats_t *stats)
+{
+    *stats = (bench_table_stats_t) {.capacity = ((cuckoo_bench_t *) table)->capacity};
+}
+
+static void
+cuckoo_destroy(void *table)
+{
+    cuckoo_bench_t *c = table;
+
+    free(c->base_ptr);
+    free(c);
+}
+
+
+typedef struct
+{
+    hopscotch_table_t table;
+    void * base_ptr;
+    uint64_t capacity;
+
+} hopscotch_bench_t;
+
+static void *
+hopscotch_create(const bench_engine_t *engine, const uint64_t capacity, const uint64_t nvals_per_item, const bool compact)
+{
+    hopscotch_bench_t *h = malloc(sizeof(hopscotch_bench_t));
+    void *base_ptr = malloc(hopscotch_table_bytes(capacity, nvals_per_item));
+
+    (void) engine;
+    (void) compact;
+
+    if(h == NULL || base_ptr == NULL)
+    {
+        free(h);
+        free(base_ptr);
+        return NULL;
+    }
+
+    init_hopscotch_table(&h->table, base_ptr, capacity, nvals_per_item);
+    h->base_ptr = base_ptr;
+    h->capacity = capacity;
+
+    return h;
+}
+
+static bool
+hopscotch_upsert(void *table, const uint64_t key, const uint64_t *values)
+{
+    return hopscotch_insert_item(&((hopscotch_bench_t *) table)->table, key, values);
+}
+
+static bool
+hopscotch_lookup(void *table, const uint64_t key, uint64_t *values)
+{
+    uint64_t *vals = hopscotch_lookup_item(&((hopscotch_bench_t *) table)->table, key);
+
+    if(vals == NULL) return false;
+
+    values[0] = vals[0];
+    return true;
+}
+
+static bool
+hopscotch_remove(void *table, const uint64_t key)
+{
+    return hopscotch_delete_item(&((hopscotch_bench_t *) table)->table, key);
+}
+
+static void
+hopscotch_stats(void *table, bench_table_stats_t *stats)
+{
+    *stats = (bench_table_stats_t) {.capacity = ((hopscotch_bench_t *) table)->capacity};
+}
+
+static void
+hopscotch_destroy(void *table)
+{
+    hopscotch_bench_t *h = table;
+
+    free(h->base_ptr);
+    free(h);
+}
+
+
+typedef struct
+{
+    chain_table_t table;
+    void * base_ptr;
+
+} chain_bench_t;
+
+static void *
+chain_create(const bench_engine_t *engine, const uint64_t capacity, const uint64_t nvals_per_item, const bool compact)
+{
+    chain_bench_t *c = malloc(sizeof(chain_bench_t));
+    void *base_ptr = malloc(chain_table_bytes(capacity, capacity, nvals_per_item, true));
+
+    (void) engine;
+    (void) compact;
+
+    if(c == NULL || base_ptr == NULL)
+    {
+        free(c);
+        free(base_ptr);
+        return NULL;
+    }
+
+    init_chain_table(&c->table, base_ptr, capacity, capacity, nvals_per_item, true);
+    c->base_ptr = base_ptr;
+
+    return c;
+}
+
+static bool
+chain_upsert(void *table, const uint64_t key, const uint64_t *values)
+{
+    return chain_insert_item(&((chain_bench_t *) table)->table, key, values);
+}
+
+static bool
+chain_lookup(void *table, const uint64_t key, uint64_t *values)
+{
+    uint64_t *vals = chain_lookup_item(&((chain_bench_t *) table)->table, key);
+
+    if(vals == NULL) return false;
+
+    values[0] = vals[0];
+    return true;
+}
+
+static bool
+chain_remove(void *table, const uint64_t key)
+{
+    return chain_delete_item(&((chain_bench_t *) table)->table, key);
+}
+
+static void
+chain_stats(void *table, bench_table_stats_t *stats)
+{
+    *stats = (bench_table_stats_t) {.capacity = *(((chain_bench_t *) table)->table.nbuckets)};
+}
+
+static void
+chain_destroy(void *table)
+{
+    chain_bench_t *c = table;
+
+    free(c->base_ptr);
+    free(c);
+}
+
+
+static void *
+conc_create(const bench_engine_t *engine, const uint64_t capacity, const uint64_t nvals_per_item, const bool compact)
+{
+    conc_table_t *ct = malloc(sizeof(conc_table_t));
+
+    (void) engine;
+    (void) compact;
+
+    if(ct == NULL) return NULL;
+
+    // grows at the default max load, sized for the load factor it starts out with
+    if(!init_conc_table(ct, capacity, nvals_per_item, 0.0))
+    {
+        free(ct);
+        return NULL;
+    }
+
+    return ct;
+}
+
+static bool
+conc_upsert(void *table, const uint64_t key, const uint64_t *values)
+{
+    return conc_insert(table, key, values);
+}
+
+static bool
+conc_lookup_one(void *table, const uint64_t key, uint64_t *values)
+{
+    return conc_lookup(table, key, values);
+}
+
+static bool
+conc_remove(void *table, const uint64_t key)
+{
+    return conc_delete(table, key);
+}
+
+static void
+conc_stats(void *table, bench_table_stats_t *stats)
+{
+    hashtable_t *t = ((conc_table_t *) table)->cur;
+    probe_stats_t ps;
+
+    probe_stats(t, &ps);
+
+    *stats = (bench_table_stats_t) {.has_probes = true, .capacity = *(t->capacity), .ntombstones = ps.ndeleted,
+                                    .max_cluster = ps.max_cluster, .miss_probes = ps.mean_miss_probes};
+}
+
+static void
+conc_destroy(void *table)
+{
+    free_conc_table(table);
+    free(table);
+}
+
+
+#define GENERIC_ENGINE(name, probe) {name, false, probe, generic_create, generic_upsert, generic_lookup, generic_remove, generic_stats, generic_destroy}
+
+static const bench_engine_t engines[] =
+{
+    GENERIC_ENGINE("linear",    PROBE_LINEAR),
+    GENERIC_ENGINE("quadratic", PROBE_QUADRATIC),
+    GENERIC_ENGINE("double",    PROBE_DOUBLE_HASH),
+    GENERIC_ENGINE("bucketed",  PROBE_BUCKETED),
+    {"cuckoo",    false, 0, cuckoo_create,    cuckoo_upsert,    cuckoo_lookup,    cuckoo_remove,    cuckoo_stats,    cuckoo_destroy},
+    {"hopscotch", false, 0, hopscotch_create, hopscotch_upsert, hopscotch_lookup, hopscotch_remove, hopscotch_stats, hopscotch_destroy},
+    {"chain",     false, 0, chain_create,     chain_upsert,     chain_lookup,     chain_remove,     chain_stats,     chain_destroy},
+    {"conc",      true,  0, conc_create,      conc_upsert,      conc_lookup_one,  conc_remove,      conc_stats,      conc_destroy},
+};
+
+#define NENGINES (sizeof(engines) / sizeof(engines[0]))
+
+
+// capacity for nkeys keys at the given load, rounded the way the probe policy needs it
+static uint64_t
+bench_capacity(const bench_engine_t *engine, const uint64_t nkeys, const double load, const uint64_t nvals_per_item)
+{
+    uint64_t capacity = (uint64_t) (nkeys / load) + 1;
+
+    if(engine->create != generic_create) return capacity;
+
+    if(engine->probe == PROBE_QUADRATIC)
+    {
+        uint64_t pow2 = 1;
+        while(pow2 < capacity) pow2 <<= 1;
+        capacity = pow2;
+    }
+    else if(engine->probe == PROBE_BUCKETED)
+    {
+        uint64_t group = PROBE_LINE_BYTES / ((1 + padded_nvals(nvals_per_item)) * sizeof(uint64_t));
+        if(group > 1) capacity = (capacity + group - 1) / group * group;
+    }
+
+    return capacity;
+}
+
+
+
+/* ------------------------------------------------------------------------------------------ */
+/* key distributions */
+
+static inline uint64_t
+next_rng(uint64_t *state)
+{
+    uint64_t x = *state;
+
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+
+    return x * 0x2545f4914f6cdd1dUL;
+}
+
+static inline double
+next_uniform(uint64_t *state)
+{
+    return (next_rng(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+
+// Zipfian ranks in [0, n) with rank 0 the most popular (Gray et al., "Quickly generating billion-record synthetic databases")
+static void
+init_zipf(zipf_t *z, const uint64_t n, const double theta)
+{
+    uint64_t i;
+    double zeta2 = 1.0 + pow(0.5, theta);
+
+    z->n = n;
+    z->theta = theta;
+    z->alpha = 1.0 / (1.0 - theta);
+    z->half_pow_theta = pow(0.5, theta);
+
+    for(z->zetan = 0.0, i = 1; i <= n; i++) z->zetan += 1.0 / pow((double) i, theta);
+
+    z->eta = (1.0 - pow(2.0 / n, 1.0 - theta)) / (1.0 - zeta2 / z->zetan);
+}
+
+static inline uint64_t
+next_zipf(const zipf_t *z, uint64_t *state)
+{
+    double u = next_uniform(state);
+    double uz = u * z->zetan;
+
+    if(uz < 1.0) return 0;
+    if(uz < 1.0 + z->half_pow_theta) return (z->n > 1) ? 1 : 0;
+
+    uint64_t rank = (uint64_t) (z->n * pow(z->eta * u - z->eta + 1.0, z->alpha));
+
+    return (rank < z->n) ? rank : z->n - 1;
+}
+
+
+
+/* ------------------------------------------------------------------------------------------ */
+/* workers */
+
+// table key of key id j of worker w (threads sharing a table own interleaved ids)
+static inline uint64_t
+bench_key(const bench_worker_t *w, const uint64_t j)
+{
+    uint64_t id = w->run->engine->shared ? j * w->run->nthreads + w->id : j;
+
+    return murmur_hash_64(id, BENCH_KEY_SEED);
+}
+
+// key id for the next read or update
+static inline uint64_t
+pick_key(bench_worker_t *w)
+{
+    bench_run_t *run = w->run;
+    uint64_t rank = run->zipfian ? next_zipf(&run->zipf, &w->rng) : next_rng(&w->rng) % run->zipf.n;
+
+    if(run->mix->churn) return bench_key(w, w->hi - 1 - rank);
+
+    // readers of a shared table pick from everybody's keys
+    if(run->engine->shared) return murmur_hash_64(rank, BENCH_KEY_SEED);
+
+    return bench_key(w, rank);
+}
+
+
+static void *
+bench_worker(void *ptr)
+{
+    bench_worker_t *w = ptr;
+    bench_run_t *run = w->run;
+    const bench_engine_t *engine = run->engine;
+    void *table = (w->table != NULL) ? w->table : run->shared_table;
+    uint64_t values[run->nvals_per_item];
+    uint64_t j, key, t0, t1;
+    int op;
+
+    memset(values, 0, sizeof(values));
+
+    /* preload the thread's window, not timed */
+    for(j = w->lo; j < w->hi; j++)
+    {
+        values[0] = j;
+        if(!engine->upsert(table, bench_key(w, j), values)) w->nfailed++;
+    }
+
+    pthread_barrier_wait(&run->barrier);
+    pthread_barrier_wait(&run->barrier);
+
+    while(!run->done)
+    {
+        t1 = 0;
+
+        while(t1 < run->deadline)
+        {
+            if((int) (next_rng(&w->rng) % 100) < run->mix->read_pct)
+            {
+                key = pick_key(w);
+
+                t0 = hash_time_now();
+                engine->lookup(table, key, values);
+                t1 = hash_time_now();
+
+                w->sink += values[0];
+                hash_hist_record(w->hist[OP_READ], t1 - t0);
+            }
+            else if(!run->mix->churn)
+            {
+                key = pick_key(w);
+                values[0] = t1;
+
+                t0 = hash_time_now();
+                engine->upsert(table, key, values);
+                t1 = hash_time_now();
+
+                hash_hist_record(w->hist[OP_UPDATE], t1 - t0);
+            }
+            else
+            {
+                /* a new key at the head of the window, the oldest one leaves at the tail */
+                values[0] = w->hi;
+
+                for(op = OP_INSERT; op <= OP_DELETE; op++)
+                {
+                    key = bench_key(w, (op == OP_INSERT) ? w->hi : w->lo);
+
+                    t0 = hash_time_now();
+                    bool ok = (op == OP_INSERT) ? engine->upsert(table, key, values) : engine->remove(table, key);
+                    t1 = hash_time_now();
+
+                    if(!ok && op == OP_INSERT) w->nfailed++;
+                    hash_hist_record(w->hist[op], t1 - t0);
+                }
+
+                w->hi++;
+                w->lo++;
+            }
+        }
+
+        pthread_barrier_wait(&run->barrier);
+        pthread_barrier_wait(&run->barrier);
+    }
+
+    return NULL;
+}
+
+
+
+/* ------------------------------------------------------------------------------------------ */
+/* runs */
+
+static void
+print_latencies(const char *label, const hash_hist_t *h)
+{
+    printf(" %-10s %12lu %9lu %9lu %9lu %11lu \n",label,h->count,hash_hist_quantile(h, 0.50),hash_hist_quantile(h, 0.99),
+           hash_hist_quantile(h, 0.999),h->max);
+}
+
+
+// state of the table(s) summed over all threads, cluster numbers of the first table
+static void
+run_table_stats(bench_run_t *run, bench_table_stats_t *stats)
+{
+    bench_table_stats_t s;
+    int t;
+
+    if(run->shared_table != NULL)
+    {
+        run->engine->stats(run->shared_table, stats);
+        return;
+    }
+
+    run->engine->stats(run->workers[0].table, stats);
+
+    for(t = 1; t < run->nthreads; t++)
+    {
+        run->engine->stats(run->workers[t].table, &s);
+        stats->ntombstones += s.ntombstones;
+        if(s.max_cluster > stats->max_cluster) stats->max_cluster = s.max_cluster;
+    }
+}
+
+
+/*
+    Run one engine with nthreads threads for the given time, printing a line every interval.
+    The latencies of the whole run are added to totals[]. Returns the number of operations per
+    second, or a negative number if the tables couldn't be set up.
+*/
+static double
+bench_run(bench_run_t *run, const double load, const bool compact, const double seconds, const double interval, hash_hist_t **totals)
+{
+    const bench_engine_t *engine = run->engine;
+    pthread_t threads[BENCH_MAX_THREADS];
+    hash_hist_t *merged = calloc(1, sizeof(hash_hist_t));
+    uint64_t table_keys = engine->shared ? run->nkeys * run->nthreads : run->nkeys;
+    uint64_t capacity = bench_capacity(engine, table_keys, load, run->nvals_per_item);
+    uint64_t t_start, t_interval, t_now, nops_total = 0, nfailed = 0;
+    bench_table_stats_t stats;
+    int t, op, nstarted;
+    double elapsed = 0.0;
+
+    if(merged == NULL) return -1.0;
+
+    run->done = false;
+    run->shared_table = engine->shared ? engine->create(engine, capacity, run->nvals_per_item, compact) : NULL;
+
+    if(engine->shared && run->shared_table == NULL)
+    {
+        free(merged);
+        return -1.0;
+    }
+
+    for(t = 0; t < run->nthreads; t++)
+    {
+        bench_worker_t *w = &run->workers[t];
+
+        *w = (bench_worker_t) {.run = run, .id = t, .lo = 0, .hi = run->nkeys, .rng = murmur_hash_64(t + 1, BENCH_KEY_SEED) | 1};
+        w->table = engine->shared ? NULL : engine->create(engine, capacity, run->nvals_per_item, compact);
+
+        bool ok = engine->shared || w->table != NULL;
+
+        for(op = 0; op < OP_KINDS; op++)
+        {
+            w->hist[op] = calloc(1, sizeof(hash_hist_t));
+            ok = ok && w->hist[op] != NULL;
+        }
+
+        if(!ok)
+        {
+            printf("\n Warning! Unable to set up the %s table of thread %i (capacity %lu). \n",engine->name,t,capacity);
+            run->nthreads = t + 1;
+            goto cleanup;
+        }
+    }
+
+    pthread_barrier_init(&run->barrier, NULL, run->nthreads + 1);
+
+    for(nstarted = 0; nstarted < run->nthreads; nstarted++)
+    {
+        if(pthread_create(&threads[nstarted], NULL, bench_worker, &run->workers[nstarted]) != 0)
+        {
+            printf("\n Warning! Unable to start thread %i. \n",nstarted);
+            exit(1);
+        }
+    }
+
+    /* preload done */
+    pthread_barrier_wait(&run->barrier);
+
+    printf("\n engine %s, workload %s, %s keys, %lu keys per %s, %i threads \n",engine->name,run->mix->name,
+           run->zipfian ? "zipfian" : "uniform",table_keys,engine->shared ? "shared table" : "thread",run->nthreads);
+    printf("\n %8s %12s %9s %9s %9s %11s %11s %11s %9s %9s \n","time s","ops/s","p50 ns","p99 ns","p99.9 ns","max ns","capacity","tombstones","cluster","miss prb");
+
+    t_start = t_interval = hash_time_now();
+    run->deadline = t_start + (uint64_t) (interval * 1e9);
+
+    pthread_barrier_wait(&run->barrier);
+
+    while(!run->done)
+    {
+        pthread_barrier_wait(&run->barrier);
+
+        /* every thread is parked: merge this interval's histograms, look at the table */
+        t_now = hash_time_now();
+        elapsed = (t_now - t_start) * 1e-9;
+
+        memset(merged, 0, sizeof(hash_hist_t));
+
+        for(t = 0; t < run->nthreads; t++)
+        {
+            for(op = 0; op < OP_KINDS; op++)
+            {
+                hash_hist_add(totals[op], run->workers[t].hist[op]);
+                hash_hist_add(merged, run->workers[t].hist[op]);
+                memset(run->workers[t].hist[op], 0, sizeof(hash_hist_t));
+            }
+        }
+
+        nops_total += merged->count;
+        run_table_stats(run, &stats);
+
+        printf(" %8.1f %12.0f %9lu %9lu %9lu %11lu ",elapsed,merged->count / ((t_now - t_interval) * 1e-9),
+               hash_hist_quantile(merged, 0.50),hash_hist_quantile(merged, 0.99),hash_hist_quantile(merged, 0.999),merged->max);
+
+        printf("%11lu ",stats.capacity);
+
+        if(stats.has_probes) printf("%11lu %9lu %9.2f \n",stats.ntombstones,stats.max_cluster,stats.miss_probes);
+        else                 printf("%11s %9s %9s \n","-","-","-");
+
+        fflush(stdout);
+
+        run->done = (elapsed + interval * 0.5 >= seconds);
+
+        // the time spent on the report isn't part of the next interval
+        t_interval = hash_time_now();
+        run->deadline = t_interval + (uint64_t) (interval * 1e9);
+        t_start += t_interval - t_now;
+
+        pthread_barrier_wait(&run->barrier);
+    }
+
+    for(t = 0; t < run->nthreads; t++)
+    {
+        pthread_join(threads[t], NULL);
+        nfailed += run->workers[t].nfailed;
+    }
+
+    pthread_barrier_destroy(&run->barrier);
+
+    if(nfailed > 0) printf("\n Warning! %s refused %lu inserts (table full). \n",engine->name,nfailed);
+
+cleanup:
+    for(t = 0; t < run->nthreads; t++)
+    {
+        if(run->workers[t].table != NULL) engine->destroy(run->workers[t].table);
+        for(op = 0; op < OP_KINDS; op++) free(run->workers[t].hist[op]);
+    }
+
+    if(run->shared_table != NULL) engine->destroy(run->shared_table);
+    free(merged);
+
+    return (elapsed > 0.0) ? nops_total / elapsed : -1.0;
+}
+
+
+// cost of a hash_time_now() pair, which is part of every latency sample
+static uint64_t
+timer_overhead(void)
+{
+    uint64_t i, t0, t1, best = UINT64_MAX;
+
+    for(i = 0; i < BENCH_TIMER_REPS; i++)
+    {
+        t0 = hash_time_now();
+        t1 = hash_time_now();
+        if(t1 - t0 < best) best = t1 - t0;
+    }
+
+    return best;
+}
+
+
+/*
+    Counters per operation of one engine at one load factor: batches of nkeys inserts, lookups
+    of present and of absent keys, updates and deletes, run by the calling thread.
+*/
+static void
+profile_engine(const bench_engine_t *engine, const uint64_t nkeys, const double load, const uint64_t nvals_per_item, const bool compact, hash_perf_t *perf)
+{
+    uint64_t capacity = bench_capacity(engine, nkeys, load, nvals_per_item);
+    uint64_t *keys = malloc(2 * nkeys * sizeof(uint64_t));
+    uint64_t values[nvals_per_item];
+    uint64_t i, nhits = 0, nfalse = 0, sink = 0;
+    void *table = engine->create(engine, capacity, nvals_per_item, compact);
+
+    if(keys == NULL || table == NULL)
+    {
+        printf("\n Warning! Unable to set up the %s table (capacity %lu). \n",engine->name,capacity);
+        free(keys);
+        if(table != NULL) engine->destroy(table);
+        return;
+    }
+
+    /* keys[0, nkeys) go into the table, keys[nkeys, 2 nkeys) are never inserted */
+    for(i = 0; i < 2 * nkeys; i++) keys[i] = murmur_hash_64(i, BENCH_KEY_SEED);
+
+    memset(values, 0, sizeof(values));
+
+    printf("\n engine %s, %lu keys, capacity %lu, load %.3f: per operation \n\n",engine->name,nkeys,capacity,(double) nkeys / capacity);
+    print_hash_perf(NULL, "ns", 0);
+
+    hash_perf_reset(perf);
+    hash_perf_start(perf);
+    for(i = 0; i < nkeys; i++) sink += hash(keys[i], capacity);
+    hash_perf_stop(perf);
+    print_hash_perf(perf, "hash()", nkeys);
+
+    hash_perf_reset(perf);
+    hash_perf_start(perf);
+    for(i = 0; i < nkeys; i++)
+    {
+        values[0] = i;
+        engine->upsert(table, keys[i], values);
+    }
+    hash_perf_stop(perf);
+    print_hash_perf(perf, "insert", nkeys);
+
+    hash_perf_reset(perf);
+    hash_perf_start(perf);
+    for(i = 0; i < nkeys; i++) nhits += engine->lookup(table, keys[i], values);
+    hash_perf_stop(perf);
+    print_hash_perf(perf, "lookup hit", nkeys);
+
+    hash_perf_reset(perf);
+    hash_perf_start(perf);
+    for(i = nkeys; i < 2 * nkeys; i++) nfalse += engine->lookup(table, keys[i], values);
+    hash_perf_stop(perf);
+    print_hash_perf(perf, "lookup miss", nkeys);
+
+    hash_perf_reset(perf);
+    hash_perf_start(perf);
+    for(i = 0; i < nkeys; i++)
+    {
+        values[0] = ~i;
+        engine->upsert(table, keys[i], values);
+    }
+    hash_perf_stop(perf);
+    print_hash_perf(perf, "update", nkeys);
+
+    hash_perf_reset(perf);
+    hash_perf_start(perf);
+    for(i = 0; i < nkeys; i++) engine->remove(table, keys[i]);
+    hash_perf_stop(perf);
+    print_hash_perf(perf, "delete", nkeys);
+
+    if(nhits != nkeys || nfalse != 0) printf("\n Warning! %lu inserted keys not found, %lu absent keys found. \n",nkeys - nhits,nfalse);
+
+    // keep the hash() batch from being optimized away
+    if(sink == 1) printf(" \n");
+
+    engine->destroy(table);
+    free(keys);
+}
+
+
+static int
+parse_threads(const char *list, int *nthreads)
+{
+    int n = 0;
+    char *end;
+
+    while(*list != '\0' && n < BENCH_MAX_RUNS)
+    {
+        long v = strtol(list, &end, 10);
+
+        if(end == list || v < 1 || v > BENCH_MAX_THREADS) return 0;
+
+        nthreads[n++] = (int) v;
+        list = (*end == ',') ? end + 1 : end;
+        if(*end != ',' && *end != '\0') return 0;
+    }
+
+    return n;
+}
+
+
+static int
+parse_loads(const char *list, double *loads)
+{
+    int n = 0;
+    char *end;
+
+    while(*list != '\0' && n < BENCH_MAX_RUNS)
+    {
+        double v = strtod(list, &end);
+
+        if(end == list || v <= 0.0 || v > 1.0) return 0;
+
+        loads[n++] = v;
+        list = (*end == ',') ? end + 1 : end;
+        if(*end != ',' && *end != '\0') return 0;
+    }
+
+    return n;
+}
+
+
+static void
+usage(const char *name)
+{
+    unsigned int i;
+
+    printf("\n usage: %s [-e engine] [-w workload] [-d uniform|zipf] [-z theta] [-n nkeys] [-l load,...] \n",name);
+    printf("        %*s [-t nthreads,...] [-s seconds] [-i interval] [-v nvals_per_item] [-C] [-P] \n\n",(int) strlen(name),"");
+    printf("   -e   engine: all");
+    for(i = 0; i < NENGINES; i++) printf(", %s",engines[i].name);
+    printf(" (default linear) \n");
+    printf("   -w   workload: readonly, read (95/5), update (50/50), churn (default read) \n");
+    printf("   -d   key distribution (default zipf) \n");
+    printf("   -z   Zipfian constant, < 1 (default 0.99) \n");
+    printf("   -n   live keys per table, per thread for single threaded engines (default 1000000) \n");
+    printf("   -l   comma separated load factors the tables are sized for (default 0.7) \n");
+    printf("   -t   comma separated thread counts (default 1) \n");
+    printf("   -s   seconds per run (default 10) \n");
+    printf("   -i   seconds per report line (default 1) \n");
+    printf("   -v   number of values per item, as in init_hash_table() (default 3) \n");
+    printf("   -C   no incremental tombstone compaction in the generic table \n");
+    printf("   -P   hardware counters per insert/lookup/update/delete instead of latencies \n\n");
+}
+
+
+int main(int argc, char **argv)
+{
+
+    static bench_run_t run;
+
+    const char *engine_name = "linear", *workload = "read", *dist = "zipf";
+    uint64_t nkeys = 1000000, nvals_per_item = 3;
+    double theta = 0.99, seconds = 10.0, interval = 1.0;
+    double loads[BENCH_MAX_RUNS] = {0.7};
+    bool compact = true, profile = false;
+    int nthreads[BENCH_MAX_RUNS] = {1}, nruns = 1, nloads = 1;
+    int opt, r, l, op;
+    unsigned int e;
+
+    while((opt = getopt(argc, argv, "e:w:d:z:n:l:t:s:i:v:CPh")) != -1)
+    {
+        switch(opt)
+        {
+            case 'e': engine_name = optarg; break;
+            case 'w': workload = optarg; break;
+            case 'd': dist = optarg; break;
+            case 'z': theta = atof(optarg); break;
+            case 'n': nkeys = strtoul(optarg, NULL, 10); break;
+            case 'l': nloads = parse_loads(optarg, loads); break;
+            case 't': nruns = parse_threads(optarg, nthreads); break;
+            case 's': seconds = atof(optarg); break;
+            case 'i': interval = atof(optarg); break;
+            case 'v': nvals_per_item = strtoul(optarg, NULL, 10); break;
+            case 'C': compact = false; break;
+            case 'P': profile = true; break;
+            default:  usage(argv[0]); return 1;
+        }
+    }
+
+    run.mix = NULL;
+    for(e = 0; e < sizeof(mixes) / sizeof(mixes[0]); e++)
+    {
+        if(strcmp(workload, mixes[e].name) == 0) run.mix = &mixes[e];
+    }
+
+    bool all = (strcmp(engine_name, "all") == 0);
+    bool known = all;
+    for(e = 0; e < NENGINES; e++) known = known || (strcmp(engine_name, engines[e].name) == 0);
+
+    run.zipfian = (strcmp(dist, "zipf") == 0);
+
+    if(optind != argc || run.mix == NULL || !known || (!run.zipfian && strcmp(dist, "uniform") != 0) || theta <= 0.0 || theta >= 1.0 ||
+       nkeys < 1 || nloads < 1 || nruns < 1 || seconds <= 0.0 || interval <= 0.0 || nvals_per_item < 3)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if(interval > seconds) interval = seconds;
+
+    run.nvals_per_item = nvals_per_item;
+
+    if(profile)
+    {
+        hash_perf_t perf;
+
+        init_hash_perf(&perf);
+
+        for(e = 0; e < NENGINES; e++)
+        {
+            if(!all && strcmp(engine_name, engines[e].name) != 0) continue;
+
+            for(l = 0; l < nloads; l++) profile_engine(&engines[e], nkeys, loads[l], nvals_per_item, compact, &perf);
+        }
+
+        free_hash_perf(&perf);
+        printf("\n");
+
+        return 0;
+    }
+
+    printf("\n Timer overhead %lu ns per sample (included in every latency) \n",timer_overhead());
+
+    for(e = 0; e < NENGINES * nloads; e++)
+    {
+        const bench_engine_t *engine = &engines[e / nloads];
+        double load = loads[e % nloads];
+        hash_hist_t *totals[BENCH_MAX_RUNS][OP_KINDS];
+        double ops[BENCH_MAX_RUNS];
+
+        if(!all && strcmp(engine_name, engine->name) != 0) continue;
+
+        for(r = 0; r < nruns; r++)
+        {
+            for(op = 0; op < OP_KINDS; op++) totals[r][op] = calloc(1, sizeof(hash_hist_t));
+
+            run.engine = engine;
+            run.nthreads = nthreads[r];
+
+            // shared tables split the keys between the threads
+            run.nkeys = engine->shared ? (nkeys + nthreads[r] - 1) / nthreads[r] : nkeys;
+
+            // Zipfian ranks cover a thread's window under churn, all keys of the table otherwise
+            uint64_t nranks = (engine->shared && !run.mix->churn) ? run.nkeys * nthreads[r] : run.nkeys;
+            if(run.zipf.n != nranks || run.zipf.theta != theta) init_zipf(&run.zipf, nranks, theta);
+
+            ops[r] = bench_run(&run, load, compact, seconds, interval, totals[r]);
+        }
+
+        printf("\n engine %s, workload %s, %s keys, load %.2f: latencies of the whole run in ns \n",engine->name,run.mix->name,
+               run.zipfian ? "zipfian" : "uniform",load);
+        printf("\n %8s %12s %-10s %12s %9s %9s %9s %11s \n","threads","ops/s","op","count","p50","p99","p99.9","max");
+
+        for(r = 0; r < nruns; r++)
+        {
+            for(op = 0; op < OP_KINDS; op++)
+            {
+                if(totals[r][op]->count == 0) continue;
+
+                printf(" %8i %12.0f",nthreads[r],ops[r]);
+                print_latencies(op_names[op], totals[r][op]);
+            }
+
+            for(op = 0; op < OP_KINDS; op++) free(totals[r][op]);
+        }
+    }
+
+    printf("\n");
+
+	return 0;
+}
@@ -0,0 +1,340 @@
+/*
+    Parallel bulk build of the generic hash table from arrays of keys and values.
+
+    The table is sized for BUILD_MAX_LOAD and split into nthreads contiguous slot ranges, one per
+    thread. Input items are partitioned by their home slot (hash(key, capacity), the murmur hash
+    modulo the capacity) into the same ranges: every thread hashes and counts its share of the
+    input, the counts are prefix summed into per-thread write offsets, and every thread scatters
+    its share into the partitioned order. Each thread then inserts its partition by linear probing
+    within its own slot range, so no two threads ever write the same slot and there is nothing to
+    synchronize. Items whose probe sequence runs off the end of their range are set aside and
+    inserted at the end by the usual probing, which may cross into the next range.
+
+    Duplicate keys in the input end up as a single item holding the values of the last duplicate.
+
+    The workers wait at a start gate until all of them are running, so if a thread can't be
+    started the build just goes ahead with the threads that could, with ranges cut for that many.
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <pthread.h>
+
+# include "hash.h"
+
+
+#define BUILD_MAX_THREADS 256
+
+
+
+typedef struct
+{
+    // shared
+    hashtable_t * table;
+    const uint64_t * keys;
+    const uint64_t * values;
+    uint64_t nitems;
+    int nthreads;
+    uint64_t * home;           // home slot of every input item
+    uint64_t * order;          // input items in partitioned order
+    uint64_t * counts;         // counts[t*nthreads + p] = items of thread t's input share in partition p
+    pthread_barrier_t * barrier;
+    pthread_mutex_t * lock;    // start gate: the workers wait until go is set
+    pthread_cond_t * start;
+    bool * go;
+
+    // per thread
+    int id;
+    uint64_t * overflow;       // items that ran off the end of this thread's slot range
+    uint64_t noverflow;
+    uint64_t max_overflow;
+    bool ok;                   // false if the overflow list couldn't grow
+
+} build_worker_t;
+
+
+static inline uint64_t
+range_start(const uint64_t n, const int part, const int nparts)
+{
+    return (uint64_t) ((unsigned __int128) n * part / nparts);
+}
+
+
+// partition (= thread) whose slot range contains slot
+static inline int
+partition_of(const uint64_t slot, const uint64_t capacity, const int nparts)
+{
+    int p = (int) ((unsigned __int128) slot * nparts / capacity);
+
+    // rounding in range_start() can put the boundary slot one partition further along
+    while(p + 1 < nparts && slot >= range_start(capacity, p + 1, nparts)) p++;
+    while(p > 0 && slot < range_start(capacity, p, nparts)) p--;
+
+    return p;
+}
+
+
+static bool
+push_overflow(build_worker_t *w, const uint64_t item)
+{
+    if(w->noverflow == w->max_overflow)
+    {
+        uint64_t max_overflow = (w->max_overflow > 0) ? 2 * w->max_overflow : 1024;
+        uint64_t *overflow = realloc(w->overflow, max_overflow * sizeof(uint64_t));
+
+        if(overflow == NULL) return false;
+
+        w->overflow = overflow;
+        w->max_overflow = max_overflow;
+    }
+    w->overflow[w->noverflow++] = item;
+    return true;
+}
+
+
+static void *
+build_worker(void *ptr)
+{
+    build_worker_t *w = ptr;
+
+    pthread_mutex_lock(w->lock);
+    while(!*(w->go)) pthread_cond_wait(w->start, w->lock);
+    pthread_mutex_unlock(w->lock);
+
+    hashtable_t *table = w->table;
+    void *base_ptr = table->capacity;
+    uint64_t capacity = *(table->capacity);
+    uint64_t nvals_per_item = *(table->nvals_per_item);
+    uint64_t size_of_item = (1 + nvals_per_item) * sizeof(uint64_t);
+    int T = w->nthreads, t = w->id, p;
+    uint64_t i, j, k, *p_item = NULL;
+
+    uint64_t slot_lo = range_start(capacity, t, T), slot_hi = range_start(capacity, t + 1, T);
+    uint64_t in_lo = range_start(w->nitems, t, T), in_hi = range_start(w->nitems, t + 1, T);
+    uint64_t *count = w->counts + t * T;
+
+    /* 1. clear this thread's slot range (first touch also places its pages near this thread) */
+    for(i = slot_lo; i < slot_hi; i++)
+    {
+        table->items[i] = base_ptr + 2*sizeof(uint64_t) + i*size_of_item;
+        p_item = base_ptr + 3*sizeof(uint64_t) + i*size_of_item;
+        for(j = 0; j < nvals_per_item; j++) p_item[j] = 0;
+    }
+
+    /* 2. hash this thread's input share and count items per partition */
+    for(p = 0; p < T; p++) count[p] = 0;
+
+    for(i = in_lo; i < in_hi; i++)
+    {
+        w->home[i] = hash(w->keys[i], capacity);
+        count[partition_of(w->home[i], capacity, T)]++;
+    }
+
+    pthread_barrier_wait(w->barrier);
+
+    /* 3. write offsets: partitions in order, and within a partition the threads in order (keeps duplicates in input order) */
+    uint64_t offset[T];
+    for(p = 0; p < T; p++)
+    {
+        uint64_t before = 0;
+        int q, s;
+        for(q = 0; q < p; q++)
+            for(s = 0; s < T; s++) before += w->counts[s * T + q];
+        for(s = 0; s < t; s++) before += w->counts[s * T + p];
+        offset[p] = before;
+    }
+
+    for(i = in_lo; i < in_hi; i++)
+    {
+        w->order[offset[partition_of(w->home[i], capacity, T)]++] = i;
+    }
+
+    pthread_barrier_wait(w->barrier);
+
+    /* 4. insert partition t into slot range t */
+    uint64_t part_lo = 0, part_hi = 0;
+    for(p = 0; p < T; p++)
+    {
+        uint64_t n = 0;
+        int s;
+        for(s = 0; s < T; s++) n += w->counts[s * T + p];
+        if(p < t) part_lo += n;
+        if(p <= t) part_hi += n;
+    }
+
+    for(k = part_lo; k < part_hi; k++)
+    {
+        uint64_t item = w->order[k];
+        uint64_t key = w->keys[item];
+        const uint64_t *vals = w->values + item * (nvals_per_item - 2);
+
+        if(k + 8 < part_hi) __builtin_prefetch(base_ptr + 3*sizeof(uint64_t) + w->home[w->order[k + 8]]*size_of_item, 1, 1);
+
+        for(i = w->home[item]; i < slot_hi; i++)
+        {
+            p_item = base_ptr + 3*sizeof(uint64_t) + i*size_of_item;
+
+            if(p_item[0] == 0 || p_item[1] == key) break;
+        }
+
+        if(i == slot_hi)
+        {
+            if(!push_overflow(w, item)) w->ok = false;
+            continue;
+        }
+
+        p_item[0] = 1;
+        p_item[1] = key;
+        for(j = 0; j < nvals_per_item - 2; j++)
+        {
+            p_item[2 + j] = vals[j];
+        }
+    }
+
+    return NULL;
+}
+
+
+/*
+    Build a table holding nitems items (values holds nitems rows of nvals_per_item - 2 words)
+    with nthreads threads. Returns the base_ptr of the table memory (release with free()), or
+    NULL on failure.
+*/
+void *
+hash_table_build(hashtable_t *table, const uint64_t *keys, const uint64_t *values, const uint64_t nitems, const uint64_t nvals_per_item, const int nthreads)
+{
+    uint64_t capacity = (uint64_t) (nitems / BUILD_MAX_LOAD) + 1;
+    uint64_t table_bytes = 2 * sizeof(uint64_t) + capacity * (1 + nvals_per_item) * sizeof(uint64_t);
+    uint64_t i, j;
+    int t, T = nthreads;
+    bool ok = true;
+    void *base_ptr;
+
+    if(nvals_per_item < 3 || (nitems > 0 && (keys == NULL || values == NULL)))
+    {
+        printf("\n Invalid input or nvals_per_item. Unable to build hash table. \n");
+        return NULL;
+    }
+
+    if(T < 1) T = 1;
+    if(T > BUILD_MAX_THREADS) T = BUILD_MAX_THREADS;
+    if((uint64_t) T > capacity) T = capacity;
+
+    base_ptr = malloc(table_bytes);
+    uint64_t *home   = malloc(nitems * sizeof(uint64_t) + 1);
+    uint64_t *order  = malloc(nitems * sizeof(uint64_t) + 1);
+    uint64_t *counts = malloc(T * T * sizeof(uint64_t));
+    uint64_t **items = malloc(capacity * sizeof(uint64_t *));
+
+    if(base_ptr == NULL || home == NULL || order == NULL || counts == NULL || items == NULL)
+    {
+        printf("\n Unable to allocate %lu bytes for the hash table. \n",table_bytes);
+        free(base_ptr); free(home); free(order); free(counts); free(items);
+        return NULL;
+    }
+
+    /* same mapping as init_hash_table(), the slots themselves are cleared by the workers */
+    table->capacity       = base_ptr;
+    table->nvals_per_item = base_ptr + sizeof(uint64_t);
+    table->items          = items;
+    table->filter         = NULL;
+    table->probe          = PROBE_LINEAR;
+    table->expiry         = NULL;
+    table->sweep          = 0;
+    table->ntombstones    = 0;
+    table->max_tombstones = (uint64_t) (TOMBSTONE_MAX_LOAD * capacity);
+    table->compact        = 0;
+    table->gen            = 0;
+    table->access         = NULL;
+    table->nexpired       = 0;
+    table->nvals          = nvals_per_item - 2;
+
+    *(table->capacity)       = capacity;
+    *(table->nvals_per_item) = nvals_per_item;
+
+    pthread_barrier_t barrier;
+    pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+    pthread_cond_t start = PTHREAD_COND_INITIALIZER;
+    bool go = false;
+
+    build_worker_t workers[T];
+    pthread_t threads[T];
+
+    for(t = 0; t < T; t++)
+    {
+        workers[t] = (build_worker_t) {.table = table, .keys = keys, .values = values, .nitems = nitems, .nthreads = T,
+                                       .home = home, .order = order, .counts = counts, .barrier = &barrier,
+                                       .lock = &lock, .start = &start, .go = &go, .id = t, .ok = true};
+    }
+
+    // the workers started so far wait at the gate, so carry on with them if one can't be started
+    for(t = 1; t < T; t++)
+    {
+        if(pthread_create(&threads[t], NULL, build_worker, &workers[t]) != 0)
+        {
+            printf("\n Warning! Unable to start build thread %i, building with %i threads. \n",t,t);
+            break;
+        }
+    }
+    T = t;
+
+    pthread_barrier_init(&barrier, NULL, T);
+
+    pthread_mutex_lock(&lock);
+    for(t = 0; t < T; t++) workers[t].nthreads = T;
+    go = true;
+    pthread_cond_broadcast(&start);
+    pthread_mutex_unlock(&lock);
+
+    build_worker(&workers[0]);
+
+    for(t = 1; t < T; t++)
+    {
+        pthread_join(threads[t], NULL);
+    }
+
+    pthread_barrier_destroy(&barrier);
+    pthread_cond_destroy(&start);
+    pthread_mutex_destroy(&lock);
+
+    /* items that didn't fit into their own slot range, in partition order */
+    for(t = 0; t < T; t++)
+    {
+        if(!workers[t].ok) ok = false;
+
+        for(i = 0; ok && i < workers[t].noverflow; i++)
+        {
+            uint64_t item = workers[t].overflow[i];
+            uint64_t *vals = find_or_insert(table, keys[item], NULL);
+
+            if(vals == NULL)
+            {
+                ok = false;
+                break;
+            }
+
+            for(j = 0; j < nvals_per_item - 2; j++)
+            {
+                vals[j] = values[item * (nvals_per_item - 2) + j];
+            }
+        }
+        free(workers[t].overflow);
+    }
+
+    free(home);
+    free(order);
+    free(counts);
+
+    if(!ok)
+    {
+        printf("\n Warning! Ran out of memory or empty slots while building the hash table. \n");
+        free(table->items);
+        free(base_ptr);
+        return NULL;
+    }
+
+    return base_ptr;
+}
@@ -0,0 +1,243 @@
+/*
+    Bounded cache mode of the generic hash table.
+
+    Instead of failing when the table fills up, the cache evicts an item once max_items are stored.
+    The victim is chosen either by a CLOCK hand sweeping the slot array (every hit sets the slot's
+    access bit, the hand clears set bits and evicts the first slot whose bit is already clear),
+    or by sampled LRU (every hit stamps the slot with a logical clock, the oldest of CACHE_SAMPLES
+    randomly picked items is evicted). Either way a hit only writes one word in a parallel array,
+    there is no linked list to maintain. The CLOCK hand steps through the slots with a large stride
+    coprime to the capacity rather than one by one: evicting neighbouring slots in a row would gather
+    all free slots behind the hand and merge the rest of a linear probing table into one cluster.
+
+    The access array is registered with the table, so compaction moves access words along with
+    their items. Evicted and removed items are erased with erase_slot(): on a linear probing table
+    the hole is closed right away, so a cache running at max_load never fills up with deleted slots
+    and misses stay as short as the clusters of live items.
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <assert.h>
+
+# include "hash.h"
+
+
+#define CACHE_SAMPLES 5 // items compared per eviction in sampled LRU mode
+
+
+
+static inline void
+touch(hashcache_t *cache, const uint64_t slot)
+{
+    cache->access[slot] = (cache->policy == EVICT_CLOCK) ? 1 : ++cache->tick;
+}
+
+
+// xorshift64 for picking eviction samples
+static inline uint64_t
+next_random(hashcache_t *cache)
+{
+    cache->rng ^= cache->rng << 13;
+    cache->rng ^= cache->rng >> 7;
+    cache->rng ^= cache->rng << 17;
+    return cache->rng;
+}
+
+
+// set up a cache over an (empty) initialized table, access must hold capacity words
+void
+init_hash_cache(hashcache_t *cache, hashtable_t *table, uint64_t *access, const evict_policy_t policy, const double max_load)
+{
+    assert(cache != NULL && table != NULL && access != NULL);
+
+    uint64_t capacity = *(table->capacity);
+    uint64_t i;
+
+    *cache = (hashcache_t) {.table = table, .access = access, .policy = policy, .rng = 0x2545f4914f6cdd1dUL, .nexpired = table->nexpired};
+
+    table->access = access;
+
+    // golden ratio step, nudged until it is coprime to the capacity
+    cache->stride = (uint64_t) (0.6180339887 * capacity) | 1;
+    while(gcd_u64(cache->stride, capacity) != 1) cache->stride++;
+    cache->stride %= capacity;
+
+    cache->max_items = (uint64_t) (max_load * capacity);
+    if(cache->max_items < 1 || cache->max_items > capacity) cache->max_items = capacity;
+
+    // other probe policies compact once half of the free slots are deleted ones
+    table->max_tombstones = (capacity - cache->max_items) / 2;
+    if(table->max_tombstones < 1) table->max_tombstones = 1;
+
+    for(i = 0; i < capacity; i++)
+    {
+        access[i] = 0;
+    }
+}
+
+
+// take the items the table expired since the last call off the item count
+static inline void
+sync_expired(hashcache_t *cache)
+{
+    cache->nitems -= cache->table->nexpired - cache->nexpired;
+    cache->nexpired = cache->table->nexpired;
+}
+
+
+// evict one item other than key, returns false if there is none
+static bool
+evict(hashcache_t *cache, const uint64_t key)
+{
+    hashtable_t *table = cache->table;
+    uint64_t capacity = *(table->capacity);
+    uint64_t i, k, *p, victim = capacity;
+
+    if(cache->policy == EVICT_CLOCK)
+    {
+        // two sweeps at most: the first one may only clear access bits
+        for(i = 0; i < 2 * capacity; i++)
+        {
+            uint64_t slot = cache->hand;
+            cache->hand = (cache->hand + cache->stride) % capacity;
+
+            p = slot_item(table, slot);
+            if(slot_state(table, p) != 1 || p[1] == key) continue;
+
+            if(cache->access[slot])
+            {
+                cache->access[slot] = 0;
+                continue;
+            }
+
+            victim = slot;
+            break;
+        }
+    }
+    else
+    {
+        for(k = 0, i = 0; k < CACHE_SAMPLES && i < 64 * CACHE_SAMPLES; i++)
+        {
+            uint64_t slot = next_random(cache) % capacity;
+
+            p = slot_item(table, slot);
+            if(slot_state(table, p) != 1 || p[1] == key) continue;
+
+            if(victim == capacity || cache->access[slot] < cache->access[victim]) victim = slot;
+            k++;
+        }
+
+        /* sparse table, fall back to the next item after a random slot */
+        for(i = 0; victim == capacity && i < capacity; i++)
+        {
+            uint64_t slot = (cache->rng + i) % capacity;
+
+            p = slot_item(table, slot);
+            if(slot_state(table, p) == 1 && p[1] != key) victim = slot;
+        }
+    }
+
+    if(victim == capacity) return false;
+
+    erase_slot(table, victim);
+    cache->nitems--;
+    cache->evictions++;
+
+    return true;
+}
+
+
+// look up key, counting the hit or miss, returns a pointer to its values (NULL on a miss)
+uint64_t *
+cache_get(hashcache_t *cache, const uint64_t key)
+{
+    // unlike a plain lookup a cache hit writes anyway, so it runs the expiry sweeper too (before
+    // the lookup, the sweep may expire the very item it would find)
+    if(cache->table->expiry != NULL) expire_step(cache->table, EXPIRE_SWEEP_SLOTS);
+    sync_expired(cache);
+
+    uint64_t *vals = find_item(cache->table, key);
+
+    if(vals == NULL)
+    {
+        cache->misses++;
+        return NULL;
+    }
+
+    cache->hits++;
+    touch(cache, slot_of(cache->table, vals));
+
+    return vals;
+}
+
+
+// insert or update an item, evicting another one first if the cache is full
+uint64_t *
+cache_put(hashcache_t *cache, const uint64_t key, const uint64_t *values)
+{
+    hashtable_t *table = cache->table;
+    uint64_t j, *vals;
+    bool inserted;
+
+    vals = find_or_insert(table, key, &inserted);
+    sync_expired(cache);
+
+    /* probe sequence ran out of room, make space and try once more */
+    if(vals == NULL && evict(cache, key)) vals = find_or_insert(table, key, &inserted);
+
+    if(vals == NULL) return NULL;
+
+    if(inserted && ++cache->nitems > cache->max_items)
+    {
+        touch(cache, slot_of(table, vals));
+        evict(cache, key);
+
+        /* closing the hole may have shifted the new item back */
+        if(slot_state(table, vals - 2) != 1 || vals[-1] != key) vals = find_item(table, key);
+    }
+
+    for(j = 0; j < table->nvals; j++)
+    {
+        vals[j] = values[j];
+    }
+
+    touch(cache, slot_of(table, vals));
+
+    return vals;
+}
+
+
+bool
+cache_remove(hashcache_t *cache, const uint64_t key)
+{
+    if(cache->table->expiry != NULL) expire_step(cache->table, EXPIRE_SWEEP_SLOTS);
+    sync_expired(cache);
+
+    uint64_t *vals = find_item(cache->table, key);
+
+    if(vals == NULL) return false;
+
+    erase_slot(cache->table, slot_of(cache->table, vals));
+    cache->nitems--;
+
+    return true;
+}
+
+
+void
+print_cache_stats(const hashcache_t *cache)
+{
+    uint64_t lookups = cache->hits + cache->misses;
+
+    printf("\n Cache (%s) items = %lu / %lu \n",(cache->policy == EVICT_CLOCK) ? "CLOCK" : "sampled LRU",cache->nitems,cache->max_items);
+    printf("\n-------------------------------------------------------\n");
+    printf("\t hits      = %lu \n",cache->hits);
+    printf("\t misses    = %lu \n",cache->misses);
+    printf("\t hit rate  = %.3f \n",lookups ? (double) cache->hits / lookups : 0.0);
+    printf("\t evictions = %lu \n",cache->evictions);
+    printf("-------------------------------------------------------\n");
+}
@@ -0,0 +1,120 @@
+/*
+    Test driver for the bounded cache: stream many more distinct keys than fit through a cache
+    at 90% load with both eviction policies and two probe policies, and check that the item count
+    stays at max_items, that evictions leave no pile of deleted slots behind (misses stay short)
+    and that every key still cached holds its own value. Then let half of the items expire and
+    check that the item count of the cache follows.
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+# include "hash.h"
+
+
+#define TABLE_SIZE 4096 // a power of 2, so double hashing applies too
+#define ITEM_NVALS 3    // needs to be >= 3
+#define NROUNDS    50   // table capacities worth of distinct keys streamed through the cache
+
+
+
+int main()
+{
+
+    hashtable_t my_table = {NULL};
+    hashcache_t cache;
+
+    uint64_t table_capacity = TABLE_SIZE;
+    uint64_t nvals_per_item = ITEM_NVALS;
+    uint64_t i, key, nwrong = 0;
+    uint64_t *vals;
+    probe_stats_t stats;
+    evict_policy_t policy;
+    probe_policy_t probe[] = {PROBE_LINEAR, PROBE_DOUBLE_HASH};
+    int k;
+    void * base_ptr = calloc(1, 2 * sizeof(uint64_t) + table_capacity * (1 + nvals_per_item) * sizeof(uint64_t));
+    uint64_t * access = calloc(table_capacity, sizeof(uint64_t));
+    uint64_t * expiry = calloc(table_capacity, sizeof(uint64_t));
+
+
+    // testing...
+
+    for(k = 0; k < 2; k++)
+    {
+        for(policy = EVICT_CLOCK; policy <= EVICT_SAMPLED_LRU; policy++)
+        {
+            uint64_t nbad = 0;
+
+            init_hash_table(&my_table, base_ptr, table_capacity, nvals_per_item);
+            set_probe_policy(&my_table, probe[k]);
+            init_hash_cache(&cache, &my_table, access, policy, 0.9);
+
+            for(key = 1; key <= NROUNDS * table_capacity; key++)
+            {
+                /* a few hot keys that are looked up all the time */
+                uint64_t hot = key % 64 + 1;
+                vals = cache_get(&cache, hot);
+                if(vals == NULL) vals = cache_put(&cache, hot, &hot);
+                nbad += (vals == NULL || vals[0] != hot);
+
+                if(key <= 64) continue;
+
+                uint64_t val = 3 * key;
+                vals = cache_put(&cache, key, &val);
+                nbad += (vals == NULL || vals[0] != 3 * key);
+            }
+
+            probe_stats(&my_table, &stats);
+            print_cache_stats(&cache);
+            print_probe_stats(&my_table);
+
+            for(i = 0; i < table_capacity; i++)
+            {
+                vals = (void *) my_table.capacity + 3*sizeof(uint64_t) + i * (1 + nvals_per_item) * sizeof(uint64_t);
+                if(slot_state(&my_table, vals) == 1) nbad += (vals[2] != ((vals[1] <= 64) ? vals[1] : 3 * vals[1]));
+            }
+
+            // the count is exact, linear probing has no deleted slots at all, misses stay far off a full scan
+            nbad += (cache.nitems != cache.max_items || stats.nitems != cache.nitems);
+            nbad += (probe[k] == PROBE_LINEAR && stats.ndeleted != 0);
+            nbad += (stats.mean_miss_probes > table_capacity / 16);
+
+            printf(" %s \n",(nbad == 0) ? "ok" : "FAILED");
+            nwrong += nbad;
+
+            free(my_table.items);
+        }
+    }
+
+    // items that expire leave the count of the cache too
+    init_hash_table(&my_table, base_ptr, table_capacity, nvals_per_item);
+    attach_expiry(&my_table, expiry);
+    init_hash_cache(&cache, &my_table, access, EVICT_CLOCK, 0.9);
+
+    for(key = 1; key <= cache.max_items; key++) cache_put(&cache, key, &key);
+    for(key = 1; key <= cache.max_items; key += 2) set_item_ttl(&my_table, key, 1);
+
+    // updates of the keys that stay give the sweeper time to get around the table
+    for(i = 0; i < 2 * table_capacity; i++)
+    {
+        key = 2 * (i % (cache.max_items / 2)) + 2;
+        cache_put(&cache, key, &key);
+    }
+    for(key = 1; key <= cache.max_items; key++) nwrong += ((cache_get(&cache, key) != NULL) != (key % 2 == 0));
+
+    probe_stats(&my_table, &stats);
+    printf("\n After expiry: %lu items cached, %lu in the table \n",cache.nitems,stats.nitems);
+    nwrong += (cache.nitems != stats.nitems || cache.nitems != cache.max_items / 2);
+
+    printf("\n %s \n\n",(nwrong == 0) ? "All checks passed." : "Some checks FAILED.");
+
+    free(my_table.items);
+    free(base_ptr);
+    free(access);
+    free(expiry);
+
+	return (nwrong == 0) ? 0 : 1;
+}
@@ -0,0 +1,385 @@
+/*
+    Load generator for hash_server: every thread keeps one connection and sends batches of
+    pipelined get/set requests (memcached text protocol) over it, then reports throughput, the
+    get hit rate and latency percentiles.
+
+        hash_client [-p port] [-t nthreads] [-d seconds] [-k nkeys] [-v value_bytes] [-r get_ratio] [-P pipeline]
+
+    Keys are "key:<n>" with n uniform in [0, nkeys), values are derived from the key, so every
+    get hit is checked against the value that was set. All keys are set once before the timed
+    run. The latency of a request is the round trip time of the batch it was sent in (so it grows
+    with the pipeline depth), recorded in a histogram of 1 us buckets up to LAT_FINE_US and 1 ms
+    buckets above.
+*/
+
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+# include "hash.h"
+
+
+#define CLIENT_MAX_THREADS 256
+#define CLIENT_MAX_VALUE   4096
+#define LAT_FINE_US        10000  // 1 us buckets up to here
+#define LAT_COARSE_MS      10000  // then 1 ms buckets up to here
+#define LAT_BUCKETS        (LAT_FINE_US + LAT_COARSE_MS)
+
+
+
+typedef struct
+{
+    int id;
+    int nthreads;
+    int port;
+    double seconds;
+    uint64_t nkeys;
+    uint64_t value_bytes;
+    double get_ratio;
+    int pipeline;
+    pthread_barrier_t * loaded; // the timed run starts once all threads have loaded their keys
+
+    uint64_t nops, ngets, nhits, nerrors;
+    uint64_t * latency;        // histogram, see lat_bucket()
+
+} client_thread_t;
+
+
+static inline uint64_t
+lat_bucket(const uint64_t ns)
+{
+    uint64_t us = ns / 1000;
+
+    if(us < LAT_FINE_US) return us;
+    if(us / 1000 < LAT_COARSE_MS) return LAT_FINE_US + us / 1000 - LAT_FINE_US / 1000;
+    return LAT_BUCKETS - 1;
+}
+
+
+// latency (us) at the upper end of a bucket
+static inline double
+bucket_us(const uint64_t b)
+{
+    return (b < LAT_FINE_US) ? b + 1 : 1000.0 * (b - LAT_FINE_US + LAT_FINE_US / 1000 + 1);
+}
+
+
+static inline uint64_t
+next_rand(uint64_t *state)
+{
+    *state += 0x9e3779b97f4a7c15UL;
+    return murmur_hash_64(*state, 0);
+}
+
+
+// value of key n: its number, then filler bytes that depend on it
+static uint64_t
+make_value(char *buf, const uint64_t n, const uint64_t value_bytes)
+{
+    uint64_t i, len = snprintf(buf, value_bytes + 1, "%lu", n);
+
+    for(i = len; i < value_bytes; i++) buf[i] = 'a' + (n + i) % 26;
+
+    return value_bytes;
+}
+
+
+static int
+connect_server(const int port)
+{
+    struct sockaddr_in addr = {.sin_family = AF_INET, .sin_port = htons(port), .sin_addr.s_addr = htonl(INADDR_LOOPBACK)};
+    int one = 1;
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    if(fd < 0 || connect(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0)
+    {
+        if(fd >= 0) close(fd);
+        return -1;
+    }
+
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    return fd;
+}
+
+
+static bool
+send_all(const int fd, const char *buf, uint64_t len)
+{
+    while(len > 0)
+    {
+        ssize_t n = send(fd, buf, len, MSG_NOSIGNAL);
+        if(n <= 0) return false;
+        buf += n;
+        len -= n;
+    }
+    return true;
+}
+
+
+/*
+    Send a batch of requests and read its responses. keys[i] is the key number of request i,
+    is_get[i] tells a get from a set. Returns false if the connection fails.
+*/
+static bool
+run_batch(client_thread_t *ct, const int fd, const uint64_t *keys, const bool *is_get, const int nreqs, char *out, char *in, const uint64_t in_cap)
+{
+    char value[CLIENT_MAX_VALUE + 1], expect[CLIENT_MAX_VALUE + 1];
+    uint64_t out_len = 0, in_len = 0, pos = 0;
+    int i;
+
+    for(i = 0; i < nreqs; i++)
+    {
+        if(is_get[i])
+        {
+            out_len += sprintf(out + out_len, "get key:%lu\r\n",keys[i]);
+        }
+        else
+        {
+            uint64_t vlen = make_value(value, keys[i], ct->value_bytes);
+            out_len += sprintf(out + out_len, "set key:%lu 0 0 %lu\r\n",keys[i],vlen);
+            memcpy(out + out_len, value, vlen);
+            out_len += vlen;
+            memcpy(out + out_len, "\r\n", 2);
+            out_len += 2;
+        }
+    }
+
+    if(!send_all(fd, out, out_len)) return false;
+
+    /* responses come back in order: STORED for a set, [VALUE ... data] END for a get */
+    for(i = 0; i < nreqs; )
+    {
+        char *nl = memchr(in + pos, '\n', in_len - pos);
+        uint64_t line_end;
+
+        if(nl != NULL && is_get[i] && strncmp(in + pos, "VALUE ", 6) == 0)
+        {
+            uint64_t vlen = 0;
+            char *sp = memrchr(in + pos, ' ', nl - (in + pos));
+            if(sp != NULL) vlen = strtoul(sp + 1, NULL, 10);
+
+            // wait for the data block and the END after it
+            line_end = nl + 1 - in;
+            if(in_len < line_end + vlen + 2 + 5)
+            {
+                nl = NULL;
+            }
+            else
+            {
+                make_value(expect, keys[i], ct->value_bytes);
+                if(vlen != ct->value_bytes || memcmp(in + line_end, expect, vlen) != 0) ct->nerrors++;
+                ct->nhits++;
+                pos = line_end + vlen + 2;
+                continue; // END is next
+            }
+        }
+
+        if(nl == NULL)
+        {
+            // need more input: keep the unread rest at the front
+            memmove(in, in + pos, in_len - pos);
+            in_len -= pos;
+            pos = 0;
+
+            if(in_len == in_cap) return false;
+
+            ssize_t n = recv(fd, in + in_len, in_cap - in_len, 0);
+            if(n <= 0) return false;
+            in_len += n;
+            continue;
+        }
+
+        line_end = nl + 1 - in;
+
+        if(is_get[i])
+        {
+            if(strncmp(in + pos, "END", 3) != 0) ct->nerrors++;
+            ct->ngets++;
+        }
+        else if(strncmp(in + pos, "STORED", 6) != 0)
+        {
+            ct->nerrors++;
+        }
+
+        pos = line_end;
+        i++;
+    }
+
+    return true;
+}
+
+
+static void *
+client_thread(void *ptr)
+{
+    client_thread_t *ct = ptr;
+    int P = ct->pipeline;
+    uint64_t keys[P];
+    bool is_get[P];
+    uint64_t in_cap = (uint64_t) P * (ct->value_bytes + 128) + 4096;
+    char *out = malloc(in_cap), *in = malloc(in_cap);
+    uint64_t state = ct->id + 1, k, i;
+    int fd = connect_server(ct->port);
+
+    if(fd < 0 || out == NULL || in == NULL)
+    {
+        printf("\n Warning! Client thread %i is unable to connect to port %i. \n",ct->id,ct->port);
+        free(out); free(in);
+        ct->nerrors++;
+        pthread_barrier_wait(ct->loaded);
+        return NULL;
+    }
+
+    /* load this thread's share of the keys */
+    for(k = ct->id; k < ct->nkeys; )
+    {
+        int n;
+        for(n = 0; n < P && k < ct->nkeys; n++, k += ct->nthreads)
+        {
+            keys[n] = k;
+            is_get[n] = false;
+        }
+        if(!run_batch(ct, fd, keys, is_get, n, out, in, in_cap)) break;
+    }
+
+    ct->nops = ct->ngets = ct->nhits = 0;
+    pthread_barrier_wait(ct->loaded);
+
+    uint64_t t_end = hash_time_now() + (uint64_t) (ct->seconds * 1e9);
+
+    while(hash_time_now() < t_end)
+    {
+        for(i = 0; i < (uint64_t) P; i++)
+        {
+            keys[i] = next_rand(&state) % ct->nkeys;
+            is_get[i] = (next_rand(&state) % 1000000) < ct->get_ratio * 1000000;
+        }
+
+        uint64_t t0 = hash_time_now();
+        if(!run_batch(ct, fd, keys, is_get, P, out, in, in_cap))
+        {
+            printf("\n Warning! Client thread %i lost its connection. \n",ct->id);
+            break;
+        }
+        uint64_t t1 = hash_time_now();
+
+        ct->latency[lat_bucket(t1 - t0)] += P;
+        ct->nops += P;
+    }
+
+    close(fd);
+    free(out);
+    free(in);
+
+    return NULL;
+}
+
+
+static void
+usage(const char *name)
+{
+    printf("\n usage: %s [-p port] [-t nthreads] [-d seconds] [-k nkeys] [-v value_bytes] [-r get_ratio] [-P pipeline] \n",name);
+    printf("\n   -p   server port on 127.0.0.1 (default 11211) \n");
+    printf("   -t   number of threads, one connection each (default 4) \n");
+    printf("   -d   duration of the timed run (default 5) \n");
+    printf("   -k   number of distinct keys (default 100000) \n");
+    printf("   -v   value size (default 32, at most %u) \n",CLIENT_MAX_VALUE);
+    printf("   -r   fraction of gets (default 0.9) \n");
+    printf("   -P   requests per batch (default 16) \n\n");
+}
+
+
+int main(int argc, char **argv)
+{
+
+    int port = 11211, nthreads = 4, pipeline = 16;
+    double seconds = 5.0, get_ratio = 0.9;
+    uint64_t nkeys = 100000, value_bytes = 32;
+    int opt, t;
+    uint64_t b;
+
+    while((opt = getopt(argc, argv, "p:t:d:k:v:r:P:h")) != -1)
+    {
+        switch(opt)
+        {
+            case 'p': port = atoi(optarg); break;
+            case 't': nthreads = atoi(optarg); break;
+            case 'd': seconds = atof(optarg); break;
+            case 'k': nkeys = strtoul(optarg, NULL, 10); break;
+            case 'v': value_bytes = strtoul(optarg, NULL, 10); break;
+            case 'r': get_ratio = atof(optarg); break;
+            case 'P': pipeline = atoi(optarg); break;
+            default:  usage(argv[0]); return 1;
+        }
+    }
+
+    if(nthreads < 1) nthreads = 1;
+    if(nthreads > CLIENT_MAX_THREADS) nthreads = CLIENT_MAX_THREADS;
+    if(pipeline < 1) pipeline = 1;
+    if(nkeys < 1) nkeys = 1;
+    if(value_bytes < 20) value_bytes = 20; // room for the key number
+    if(value_bytes > CLIENT_MAX_VALUE) value_bytes = CLIENT_MAX_VALUE;
+
+    client_thread_t threads[nthreads];
+    pthread_t tids[nthreads];
+    pthread_barrier_t loaded;
+
+    pthread_barrier_init(&loaded, NULL, nthreads);
+
+    for(t = 0; t < nthreads; t++)
+    {
+        threads[t] = (client_thread_t) {.id = t, .nthreads = nthreads, .port = port, .seconds = seconds, .nkeys = nkeys, .value_bytes = value_bytes,
+                                        .get_ratio = get_ratio, .pipeline = pipeline, .loaded = &loaded, .latency = calloc(LAT_BUCKETS, sizeof(uint64_t))};
+        if(threads[t].latency == NULL || pthread_create(&tids[t], NULL, client_thread, &threads[t]) != 0)
+        {
+            printf("\n Unable to start client thread %i. \n",t);
+            exit(EXIT_FAILURE); // the others would wait for it at the barrier
+        }
+    }
+
+    uint64_t nops = 0, ngets = 0, nhits = 0, nerrors = 0;
+    uint64_t *latency = calloc(LAT_BUCKETS, sizeof(uint64_t));
+
+    for(t = 0; t < nthreads; t++)
+    {
+        pthread_join(tids[t], NULL);
+        nops += threads[t].nops;
+        ngets += threads[t].ngets;
+        nhits += threads[t].nhits;
+        nerrors += threads[t].nerrors;
+        for(b = 0; b < LAT_BUCKETS; b++) latency[b] += threads[t].latency[b];
+        free(threads[t].latency);
+    }
+
+    /* percentiles from the merged histogram */
+    double pct[3] = {0.5, 0.99, 0.999}, at[3] = {0, 0, 0};
+    uint64_t seen = 0;
+    int k = 0;
+
+    for(b = 0; b < LAT_BUCKETS && k < 3; b++)
+    {
+        seen += latency[b];
+        while(k < 3 && seen > 0 && seen >= pct[k] * nops) at[k++] = bucket_us(b);
+    }
+
+    pthread_barrier_destroy(&loaded);
+
+    printf("\n %lu ops in %.1f s: %.0f ops/s, %i connections, pipeline %i \n",nops,seconds,nops / seconds,nthreads,pipeline);
+    printf(" gets %lu (hit rate %.4f), sets %lu, %lu errors \n",ngets,ngets ? (double) nhits / ngets : 0.0,nops - ngets,nerrors);
+    printf(" batch latency: p50 %.0f us, p99 %.0f us, p99.9 %.0f us \n\n",at[0],at[1],at[2]);
+
+    free(latency);
+
+	return nerrors != 0;
+}
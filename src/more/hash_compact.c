@@ -0,0 +1,242 @@
+/*
+    In-place tombstone compaction for the generic hash table.
+
+    Deleted slots only end a probe when something is inserted over them, so under a steady
+    insert/delete mix they pile up and lookups of absent keys end up walking most of the table.
+    Once a table holds more than max_tombstones of them, every insert and delete does a bit of
+    compaction, without allocating anything:
+
+    PROBE_LINEAR     incremental: a cursor advances COMPACT_STEP_SLOTS slots per call, and every
+                     deleted slot it finds is emptied and closed up with Knuth's backward shift
+                     (Algorithm R): following items that can no longer be reached from their home
+                     slot move back into the hole, until the cluster ends.
+    other policies   their probe sequences can't be shifted back like that, so the first call over
+                     the threshold rehashes the whole table in place: deleted slots become empty,
+                     live items are marked pending, and every pending item is moved to the first
+                     slot of its probe sequence that isn't taken by an already placed item,
+                     swapping with a pending item sitting there if need be.
+
+    Either way items move between slots, so pointers returned by find_item(), find_or_insert()
+    etc. are only good until the next insert or delete on the table. The per-slot arrays next to
+    the table (expiry times, the access words of a cache) move along with their items.
+
+    erase_slot() deletes an item without leaving a deleted slot behind at all on a linear
+    probing table, by closing the hole right away (the bounded cache evicts that way).
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <assert.h>
+
+# include "hash.h"
+
+
+#define SLOT_PENDING 6 // live item that hasn't been placed yet during a full in-place rehash
+
+
+
+// move the item in slot from into the empty slot to, along with its expiration time and access word
+static inline void
+move_item(hashtable_t *table, const uint64_t to, const uint64_t from)
+{
+    uint64_t nvals_per_item = *(table->nvals_per_item);
+    uint64_t *p = slot_item(table, to), *q = slot_item(table, from);
+    uint64_t j;
+
+    for(j = 0; j < nvals_per_item; j++)
+    {
+        p[j] = q[j];
+    }
+    q[0] = status_word(table, 0);
+
+    if(table->expiry != NULL)
+    {
+        table->expiry[to] = table->expiry[from];
+        table->expiry[from] = 0;
+    }
+
+    if(table->access != NULL)
+    {
+        table->access[to] = table->access[from];
+        table->access[from] = 0;
+    }
+}
+
+
+static inline void
+swap_items(hashtable_t *table, const uint64_t a, const uint64_t b)
+{
+    uint64_t nvals_per_item = *(table->nvals_per_item);
+    uint64_t *p = slot_item(table, a), *q = slot_item(table, b);
+    uint64_t j, tmp;
+
+    for(j = 0; j < nvals_per_item; j++)
+    {
+        tmp = p[j]; p[j] = q[j]; q[j] = tmp;
+    }
+
+    if(table->expiry != NULL)
+    {
+        tmp = table->expiry[a]; table->expiry[a] = table->expiry[b]; table->expiry[b] = tmp;
+    }
+
+    if(table->access != NULL)
+    {
+        tmp = table->access[a]; table->access[a] = table->access[b]; table->access[b] = tmp;
+    }
+}
+
+
+// empty the deleted slot hole and shift the rest of its cluster back (linear probing only)
+static void
+close_hole(hashtable_t *table, uint64_t hole)
+{
+    uint64_t capacity = *(table->capacity);
+    uint64_t i, j = hole, home, *p;
+
+    slot_item(table, hole)[0] = status_word(table, 0);
+    table->ntombstones--;
+
+    for(i = 1; i < capacity; i++)
+    {
+        j = (j + 1 == capacity) ? 0 : j + 1;
+        p = slot_item(table, j);
+
+        if(slot_state(table, p) == 0) return; // end of the cluster
+
+        if(slot_state(table, p) != 1) continue; // deleted slots don't block probes, leave them to the cursor
+
+        /* the item in j is cut off from its home slot if the hole lies cyclically within [home, j) */
+        home = hash(p[1], capacity);
+
+        if((hole <= j) ? (home <= hole || home > j) : (home <= hole && home > j))
+        {
+            move_item(table, hole, j);
+            hole = j;
+        }
+    }
+}
+
+
+// rehash all items in place (any probe policy), returns the number of deleted slots cleared
+uint64_t
+compact_table(hashtable_t *table)
+{
+    assert(table != NULL);
+
+    uint64_t capacity = *(table->capacity);
+    uint64_t ncleared = table->ntombstones;
+    uint64_t i, k, try, *p, *q;
+
+    for(i = 0; i < capacity; i++)
+    {
+        p = slot_item(table, i);
+
+        uint64_t slot_status = slot_state(table, p);
+
+        if(slot_status == 2)
+        {
+            p[0] = status_word(table, 0);
+            if(table->expiry != NULL) table->expiry[i] = 0;
+            if(table->access != NULL) table->access[i] = 0;
+        }
+        else if(slot_status == 1)
+        {
+            p[0] = status_word(table, SLOT_PENDING);
+        }
+    }
+
+    for(i = 0; i < capacity; i++)
+    {
+        p = slot_item(table, i);
+
+        /* every pass of this loop places one item for good, the one that ends up in slot i is looked at again */
+        while(slot_state(table, p) == SLOT_PENDING)
+        {
+            uint64_t index = hash(p[1], capacity);
+            uint64_t step = probe_step(table, p[1]);
+
+            // slot i is pending itself, so it's at the latest where the search stops
+            for(k = 0; k < capacity; k++)
+            {
+                try = probe_slot(table, index, step, k);
+                if(slot_state(table, slot_item(table, try)) != 1) break;
+            }
+
+            q = slot_item(table, try);
+
+            if(try == i)
+            {
+                p[0] = status_word(table, 1);
+            }
+            else if(slot_state(table, q) == 0)
+            {
+                move_item(table, try, i);
+                q[0] = status_word(table, 1);
+            }
+            else
+            {
+                swap_items(table, try, i);
+                q[0] = status_word(table, 1);
+            }
+        }
+    }
+
+    table->ntombstones = 0;
+    table->compact = 0;
+
+    return ncleared;
+}
+
+
+// compact the next nslots slots, returns the number of deleted slots cleared
+uint64_t
+compact_step(hashtable_t *table, const uint64_t nslots)
+{
+    assert(table != NULL);
+
+    if(table->probe != PROBE_LINEAR) return compact_table(table);
+
+    uint64_t capacity = *(table->capacity);
+    uint64_t i, ncleared = 0;
+
+    for(i = 0; i < nslots && i < capacity && table->ntombstones > 0; i++)
+    {
+        uint64_t slot = table->compact;
+        table->compact = (slot + 1 == capacity) ? 0 : slot + 1;
+
+        if(slot_state(table, slot_item(table, slot)) == 2)
+        {
+            close_hole(table, slot);
+            ncleared++;
+        }
+    }
+
+    return ncleared;
+}
+
+
+// delete the item in slot: closes the hole right away on a linear probing table, other policies leave a deleted slot for compact_step()
+void
+erase_slot(hashtable_t *table, const uint64_t slot)
+{
+    assert(table != NULL && slot < *(table->capacity));
+
+    slot_item(table, slot)[0] = status_word(table, 2); // set status to deleted
+    table->ntombstones++;
+
+    if(table->expiry != NULL) table->expiry[slot] = 0;
+    if(table->access != NULL) table->access[slot] = 0;
+
+    if(table->probe == PROBE_LINEAR)
+    {
+        close_hole(table, slot);
+    }
+    else if(table->max_tombstones > 0 && table->ntombstones > table->max_tombstones)
+    {
+        compact_step(table, COMPACT_STEP_SLOTS);
+    }
+}
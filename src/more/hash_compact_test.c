@@ -0,0 +1,132 @@
+/*
+    Test driver for tombstone compaction: keep the number of items in a table fixed while deleting
+    and inserting keys over and over, with every probe policy, once with compaction off and once
+    on. All live items have to be found with their values, absent keys must not be, the tombstone
+    counter has to match the deleted slots, and with compaction on they must stay bounded.
+    Finally compact_table() has to clear all of them.
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+# include "hash.h"
+
+
+#define TABLE_SIZE 4096 // a power of 2 and a multiple of the bucket group, so every policy applies
+#define ITEM_NVALS 4    // needs to be >= 3
+#define NITEMS     3000
+#define NROUNDS    200000
+
+
+
+static uint64_t
+check_items(hashtable_t *table, const uint64_t *live, const uint64_t next)
+{
+    uint64_t i, key, nbad = 0;
+    uint64_t *vals;
+
+    for(i = 0; i < NITEMS; i++)
+    {
+        vals = find_item(table, live[i]);
+        nbad += (vals == NULL || vals[0] != 3 * live[i] || vals[1] != 7 * live[i]);
+    }
+
+    for(key = next; key < next + 1000; key++) nbad += (find_item(table, key) != NULL);
+
+    return nbad;
+}
+
+
+
+int main()
+{
+
+    hashtable_t my_table = {NULL};
+
+    uint64_t table_capacity = TABLE_SIZE;
+    uint64_t nvals_per_item = ITEM_NVALS;
+    uint64_t table_bytes = 2 * sizeof(uint64_t) + table_capacity * (1 + nvals_per_item) * sizeof(uint64_t);
+    uint64_t i, nwrong = 0;
+    uint64_t live[NITEMS];
+    probe_stats_t stats;
+    probe_policy_t policy;
+    int compaction;
+    void * base_ptr = calloc(1, table_bytes);
+
+    srand(1);
+
+
+    // testing...
+
+    for(policy = PROBE_LINEAR; policy <= PROBE_BUCKETED; policy++)
+    {
+        for(compaction = 0; compaction < 2; compaction++)
+        {
+            uint64_t nbad = 0, next = 1;
+
+            init_hash_table(&my_table, base_ptr, table_capacity, nvals_per_item);
+            nbad += !set_probe_policy(&my_table, policy);
+            if(!compaction) my_table.max_tombstones = 0;
+
+            for(i = 0; i < NITEMS; i++, next++)
+            {
+                uint64_t vals[2] = {3 * next, 7 * next};
+                nbad += (insert_or_assign(&my_table, next, vals) == NULL);
+                live[i] = next;
+            }
+
+            // replace a random item with a new key, through both insert paths
+            for(i = 0; i < NROUNDS; i++, next++)
+            {
+                uint64_t r = rand() % NITEMS;
+                uint64_t vals[2] = {3 * next, 7 * next};
+                uint64_t *p;
+                bool inserted = false;
+
+                nbad += !erase_item(&my_table, live[r]);
+
+                if(i % 2 == 1)
+                {
+                    p = find_or_insert(&my_table, next, &inserted);
+                    nbad += (p == NULL || !inserted);
+                    if(p != NULL) p[0] = vals[0], p[1] = vals[1];
+                }
+                else
+                {
+                    nbad += (insert_or_assign(&my_table, next, vals) == NULL);
+                }
+
+                live[r] = next;
+            }
+
+            nbad += check_items(&my_table, live, next);
+
+            probe_stats(&my_table, &stats);
+            printf("\n policy %i, compaction %s: %lu deleted slots (counter %lu), %.1f probes per miss ",
+                   policy,compaction ? "on " : "off",stats.ndeleted,my_table.ntombstones,stats.mean_miss_probes);
+
+            nbad += (stats.nitems != NITEMS || stats.ndeleted != my_table.ntombstones);
+            if(compaction) nbad += (my_table.ntombstones > TOMBSTONE_MAX_LOAD * table_capacity);
+
+            // a full compaction leaves no deleted slot behind
+            compact_table(&my_table);
+            probe_stats(&my_table, &stats);
+            nbad += (my_table.ntombstones != 0 || stats.ndeleted != 0);
+            nbad += check_items(&my_table, live, next);
+
+            printf("%s \n",(nbad == 0) ? "ok" : "FAILED");
+            nwrong += nbad;
+
+            free(my_table.items);
+        }
+    }
+
+    printf("\n %s \n\n",(nwrong == 0) ? "All checks passed." : "Some checks FAILED.");
+
+    free(base_ptr);
+
+	return (nwrong == 0) ? 0 : 1;
+}
@@ -0,0 +1,124 @@
+/*
+    Blocked bloom filter in front of the generic hash table.
+
+    Every key maps to a single 64-byte block (one cache line) and sets FILTER_NBITS bits within
+    it, so checking a key costs one cache line access. Once a filter is attached, lookups of keys
+    that were never inserted are rejected without walking the probe sequence in the table.
+    Deletes can't clear bits (other keys may share them), so the filter only ever fills up;
+    rebuild_filter() recomputes it from the live items to drop the deleted keys again.
+
+    Memory layout of the filter (starting at filter_ptr, ideally 64-byte aligned):
+
+        [nblocks][7 words padding][block 0 (8 words)][block 1] ...
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+# include "hash.h"
+
+
+#define FILTER_BITS_PER_KEY 12  // ~1% false positives at full table load
+#define FILTER_NBITS        6   // bits set per key
+#define FILTER_SEED_1       0x5bd1e9955bd1e995UL
+#define FILTER_SEED_2       0x27d4eb2f165667c5UL
+
+
+
+static inline uint64_t *
+get_block(const hashtable_t *table, const uint64_t key)
+{
+    uint64_t nblocks = table->filter[0];
+    uint64_t h = murmur_hash_64(key, FILTER_SEED_1);
+
+    return table->filter + 8 + (h % nblocks) * 8;
+}
+
+
+// size in bytes of a filter for a table of the given capacity
+uint64_t
+filter_bytes(const uint64_t table_capacity)
+{
+    uint64_t nblocks = (table_capacity * FILTER_BITS_PER_KEY + 511) / 512;
+
+    return (1 + nblocks) * 64;
+}
+
+
+void
+filter_add(const hashtable_t *table, const uint64_t key)
+{
+    uint64_t *block = get_block(table, key);
+    uint64_t h = murmur_hash_64(key, FILTER_SEED_2);
+    int k;
+
+    // every 9-bit field of the second hash picks one of the 512 bits of the block
+    for(k = 0; k < FILTER_NBITS; k++, h >>= 9)
+    {
+        block[(h >> 6) & 7] |= 1UL << (h & 63);
+    }
+}
+
+
+// false means the key is definitely not in the table
+bool
+filter_may_contain(const hashtable_t *table, const uint64_t key)
+{
+    uint64_t *block = get_block(table, key);
+    uint64_t h = murmur_hash_64(key, FILTER_SEED_2);
+    int k;
+
+    for(k = 0; k < FILTER_NBITS; k++, h >>= 9)
+    {
+        if(!(block[(h >> 6) & 7] & (1UL << (h & 63)))) return false;
+    }
+
+    return true;
+}
+
+
+// clear the filter and add the keys of all items currently in the table
+void
+rebuild_filter(hashtable_t *table)
+{
+    assert(table != NULL && table->filter != NULL);
+
+    void *base_ptr = table->capacity;
+    uint64_t capacity = *(table->capacity);
+    uint64_t nvals_per_item = *(table->nvals_per_item);
+    uint64_t size_of_item = (1 + nvals_per_item) * sizeof(uint64_t);
+    uint64_t i, *p;
+
+    memset(table->filter + 8, 0, table->filter[0] * 64);
+
+    for(i = 0; i < capacity; i++)
+    {
+        p = base_ptr + 3*sizeof(uint64_t) + i*size_of_item;
+
+        if(slot_state(table, p) == 1) filter_add(table, p[1]);
+    }
+}
+
+
+// put a filter of nbytes bytes (see filter_bytes()) in front of the table and fill it from its items
+void
+attach_filter(hashtable_t *table, void *filter_ptr, const uint64_t nbytes)
+{
+    assert(table != NULL);
+
+    if(filter_ptr == NULL || nbytes < 2 * 64)
+    {
+        printf("\n Invalid filter_ptr or filter size. Unable to attach filter. \n");
+        return;
+    }
+
+    table->filter = filter_ptr;
+    table->filter[0] = nbytes / 64 - 1;
+
+    rebuild_filter(table);
+}
@@ -0,0 +1,83 @@
+/*
+    Test driver for the blocked bloom filter: fill a table with a filter attached, check that
+    every inserted key still passes the filter (no false negatives), measure the false positive
+    rate on absent keys, then delete half of the keys and rebuild the filter.
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+# include "hash.h"
+
+
+#define TABLE_SIZE 100000
+#define ITEM_NVALS 3 // needs to be >= 3
+#define NABSENT    1000000
+
+
+
+int main()
+{
+
+    hashtable_t my_table = {NULL};
+
+    uint64_t table_capacity = TABLE_SIZE;
+    uint64_t nvals_per_item = ITEM_NVALS;
+    uint64_t nitems = table_capacity;
+    uint64_t nbytes = filter_bytes(table_capacity);
+    uint64_t i, npassed, nwrong = 0;
+    void * base_ptr = calloc(1, 2 * sizeof(uint64_t) + 2 * table_capacity * (1 + nvals_per_item) * sizeof(uint64_t));
+    void * filter_ptr = aligned_alloc(64, nbytes);
+
+    init_hash_table(&my_table, base_ptr, 2 * table_capacity, nvals_per_item);
+    attach_filter(&my_table, filter_ptr, nbytes);
+
+    printf("\n Filter of %lu bytes for %lu keys \n",nbytes,nitems);
+
+
+    // testing...
+
+    for(i = 0; i < nitems; i++)
+    {
+        uint64_t val = i;
+        insert_or_assign(&my_table, murmur_hash_64(i, 1), &val);
+    }
+
+    for(i = 0; i < nitems; i++)
+    {
+        nwrong += !filter_may_contain(&my_table, murmur_hash_64(i, 1));
+        nwrong += (find_item(&my_table, murmur_hash_64(i, 1)) == NULL);
+    }
+    printf("\n False negatives: %lu \n",nwrong);
+
+    for(npassed = 0, i = 0; i < NABSENT; i++) npassed += filter_may_contain(&my_table, murmur_hash_64(i, 2));
+    double fp_full = (double) npassed / NABSENT;
+    printf("\n False positives at full load: %.3f%% \n",100.0 * fp_full);
+    nwrong += (fp_full > 0.03);
+
+    // deleted keys keep their bits until the filter is rebuilt
+    for(i = 0; i < nitems; i += 2) erase_item(&my_table, murmur_hash_64(i, 1));
+
+    for(npassed = 0, i = 0; i < nitems; i += 2) npassed += filter_may_contain(&my_table, murmur_hash_64(i, 1));
+    printf("\n Deleted keys passing before the rebuild: %lu of %lu \n",npassed,nitems / 2);
+    nwrong += (npassed != nitems / 2);
+
+    rebuild_filter(&my_table);
+
+    for(npassed = 0, i = 0; i < nitems; i += 2) npassed += filter_may_contain(&my_table, murmur_hash_64(i, 1));
+    printf("\n Deleted keys passing after the rebuild: %lu of %lu \n",npassed,nitems / 2);
+    nwrong += (npassed > nitems / 2 * fp_full);
+
+    for(i = 1; i < nitems; i += 2) nwrong += (find_item(&my_table, murmur_hash_64(i, 1)) == NULL);
+
+    printf("\n %s \n\n",(nwrong == 0) ? "All checks passed." : "Some checks FAILED.");
+
+    free(my_table.items);
+    free(base_ptr);
+    free(filter_ptr);
+
+	return (nwrong == 0) ? 0 : 1;
+}
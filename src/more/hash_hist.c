@@ -0,0 +1,65 @@
+/*
+    High dynamic range histograms of latencies (or any other non negative integers).
+
+    Values below HIST_SUB get a bucket each, above that every power of 2 is split into
+    HIST_SUB / 2 buckets, so the bucket of a value is at most 1 / (HIST_SUB / 2) of it wide and
+    a quantile read back from the buckets is exact to within that (1.6% for HIST_SUB_BITS = 7),
+    over the whole range of uint64_t. hash_hist_record() (in hash.h) is a couple of
+    instructions, cheap enough to time every single table operation.
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <math.h>
+
+# include "hash.h"
+
+
+
+// highest value that falls into bucket i
+uint64_t
+hash_hist_value(const uint64_t i)
+{
+    if(i < HIST_SUB) return i;
+
+    uint64_t shift = i / (HIST_SUB / 2) - 1;
+    uint64_t m = i - shift * (HIST_SUB / 2);
+
+    return ((m + 1) << shift) - 1;
+}
+
+
+void
+hash_hist_add(hash_hist_t *dst, const hash_hist_t *src)
+{
+    uint64_t i;
+
+    for(i = 0; i < HIST_BUCKETS; i++) dst->buckets[i] += src->buckets[i];
+
+    dst->count += src->count;
+    if(src->max > dst->max) dst->max = src->max;
+}
+
+
+// value at quantile q (the max for q = 1)
+uint64_t
+hash_hist_quantile(const hash_hist_t *h, const double q)
+{
+    uint64_t i, seen = 0, rank = (uint64_t) ceil(q * h->count);
+
+    if(h->count == 0) return 0;
+    if(rank < 1) rank = 1;
+
+    for(i = 0; i < HIST_BUCKETS; i++)
+    {
+        seen += h->buckets[i];
+        if(seen >= rank) break;
+    }
+
+    uint64_t value = hash_hist_value(i);
+
+    return (value < h->max) ? value : h->max;
+}
@@ -0,0 +1,110 @@
+/*
+    Test driver for the latency histograms: every value up to a few million and values spread
+    over the whole range of uint64_t have to land in a bucket that holds them and is at most
+    1 / (HIST_SUB / 2) of them wide. Quantiles of a long tailed sample have to be within that
+    of the exact quantiles of the sorted sample, and adding up histograms has to give the
+    histogram of all their values.
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <math.h>
+
+# include "hash.h"
+
+
+#define NSAMPLES 1000000
+#define NPARTS   4
+#define MAX_EXACT (1UL << 22) // values checked one by one
+
+
+
+static int
+compare_values(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+
+    return (x > y) - (x < y);
+}
+
+
+// 1 if v doesn't fall into a bucket that holds it, or the bucket is too wide
+static uint64_t
+check_bucket(const uint64_t v)
+{
+    uint64_t i = hash_hist_index(v);
+    uint64_t hi = hash_hist_value(i), lo = (i == 0) ? 0 : hash_hist_value(i - 1) + 1;
+
+    return (i >= HIST_BUCKETS || v < lo || v > hi || (double) (hi - lo) > (double) v / (HIST_SUB / 2));
+}
+
+
+
+int main()
+{
+
+    hash_hist_t *all = calloc(1, sizeof(hash_hist_t)), *sum = calloc(1, sizeof(hash_hist_t));
+    hash_hist_t *parts[NPARTS];
+
+    uint64_t *samples = malloc(NSAMPLES * sizeof(uint64_t));
+    uint64_t i, v, rng = 88172645463325252UL, nwrong = 0;
+    double qs[] = {0.0, 0.5, 0.9, 0.99, 0.999, 0.9999, 1.0};
+    int p, q;
+
+    for(p = 0; p < NPARTS; p++) parts[p] = calloc(1, sizeof(hash_hist_t));
+
+
+    // testing...
+
+    for(v = 0; v < MAX_EXACT; v++) nwrong += check_bucket(v);
+    for(i = 0; i < 64; i++)
+    {
+        nwrong += check_bucket(1UL << i) + check_bucket((1UL << i) - 1) + check_bucket((1UL << i) + 1);
+    }
+    nwrong += check_bucket(UINT64_MAX);
+
+    // an empty histogram
+    nwrong += (hash_hist_quantile(all, 0.5) != 0);
+
+    // long tailed latencies: most around 100 to 200 ns, a tail reaching to 32 us
+    for(i = 0; i < NSAMPLES; i++)
+    {
+        rng ^= rng << 13, rng ^= rng >> 7, rng ^= rng << 17;
+        double u = (double) (rng >> 11) / (1UL << 53);
+        samples[i] = 20 + (uint64_t) (80.0 * exp(6.0 * u * u * u));
+
+        hash_hist_record(all, samples[i]);
+        hash_hist_record(parts[i % NPARTS], samples[i]);
+    }
+
+    qsort(samples, NSAMPLES, sizeof(uint64_t), compare_values);
+
+    for(q = 0; q < (int) (sizeof(qs) / sizeof(qs[0])); q++)
+    {
+        uint64_t rank = (uint64_t) ceil(qs[q] * NSAMPLES);
+        uint64_t exact = samples[(rank < 1) ? 0 : rank - 1];
+        uint64_t estimate = hash_hist_quantile(all, qs[q]);
+
+        printf("\n q = %-7g exact %8lu histogram %8lu \n",qs[q],exact,estimate);
+        nwrong += (estimate < exact || (double) (estimate - exact) > (double) exact / (HIST_SUB / 2));
+    }
+
+    nwrong += (all->count != NSAMPLES || all->max != samples[NSAMPLES - 1] || hash_hist_quantile(all, 1.0) != all->max);
+
+    for(p = 0; p < NPARTS; p++) hash_hist_add(sum, parts[p]);
+
+    nwrong += (sum->count != all->count || sum->max != all->max);
+    for(i = 0; i < HIST_BUCKETS; i++) nwrong += (sum->buckets[i] != all->buckets[i]);
+
+    printf("\n %s \n\n",(nwrong == 0) ? "All checks passed." : "Some checks FAILED.");
+
+    for(p = 0; p < NPARTS; p++) free(parts[p]);
+    free(all);
+    free(sum);
+    free(samples);
+
+	return (nwrong == 0) ? 0 : 1;
+}
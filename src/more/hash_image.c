@@ -0,0 +1,127 @@
+/*
+    Table images: the memory of a generic hash table written to a file as it is, and read back.
+
+    An image is a few words of table state, [magic][probe policy][gen][ntombstones][nvals],
+    followed by the table memory from base_ptr on ([capacity][nvals_per_item][items ...], in the byte order
+    of the machine). Filters and expiry arrays live outside the table memory and aren't part of
+    the image (rebuild_filter() makes a filter for a loaded table again).
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <assert.h>
+
+# include "hash.h"
+
+
+#define HASH_IMAGE_MAGIC 0x68617368696d6167UL // "hashimag"
+#define HASH_IMAGE_WORDS 5
+
+
+
+static inline uint64_t
+table_bytes(const uint64_t capacity, const uint64_t nvals_per_item)
+{
+    return 2 * sizeof(uint64_t) + capacity * (1 + nvals_per_item) * sizeof(uint64_t);
+}
+
+
+bool
+hash_table_save(const hashtable_t *table, const char *path)
+{
+    assert(table != NULL && path != NULL);
+
+    uint64_t header[HASH_IMAGE_WORDS] = {HASH_IMAGE_MAGIC, table->probe, table->gen, table->ntombstones, table->nvals};
+    uint64_t nbytes = table_bytes(*(table->capacity), *(table->nvals_per_item));
+    FILE *file = fopen(path, "wb");
+    bool ok;
+
+    if(file == NULL)
+    {
+        printf("\n Warning! Unable to open %s for writing. \n",path);
+        return false;
+    }
+
+    ok = fwrite(header, sizeof(header), 1, file) == 1 && fwrite(table->capacity, 1, nbytes, file) == nbytes;
+    ok = (fclose(file) == 0) && ok;
+
+    if(!ok) printf("\n Warning! Unable to write the table image to %s. \n",path);
+
+    return ok;
+}
+
+
+/*
+    Read a table image into newly allocated memory and map the table onto it. Returns the
+    base_ptr (release with hash_table_free(), and free() table->items), or NULL on failure.
+*/
+void *
+hash_table_load(hashtable_t *table, const char *path)
+{
+    assert(table != NULL && path != NULL);
+
+    uint64_t header[HASH_IMAGE_WORDS], dims[2], i;
+    FILE *file = fopen(path, "rb");
+    void *base_ptr = NULL;
+
+    if(file == NULL)
+    {
+        printf("\n Warning! Unable to open %s. \n",path);
+        return NULL;
+    }
+
+    if(fread(header, sizeof(header), 1, file) != 1 || header[0] != HASH_IMAGE_MAGIC || fread(dims, sizeof(dims), 1, file) != 1 ||
+       dims[0] < 1 || dims[1] < 3 || header[1] > PROBE_BUCKETED || header[4] < 1 || header[4] + 2 > dims[1])
+    {
+        printf("\n Warning! %s is not a table image. \n",path);
+        fclose(file);
+        return NULL;
+    }
+
+    uint64_t capacity = dims[0], nvals_per_item = dims[1];
+    uint64_t size_of_item = (1 + nvals_per_item) * sizeof(uint64_t);
+    uint64_t nbytes = table_bytes(capacity, nvals_per_item) - sizeof(dims);
+
+    // the slots as wide as they were saved (padded or not)
+    base_ptr = hash_table_alloc(capacity, nvals_per_item, 0);
+    table->items = malloc(capacity * sizeof(uint64_t *));
+
+    if(base_ptr == NULL || table->items == NULL || fread(base_ptr + sizeof(dims), 1, nbytes, file) != nbytes)
+    {
+        printf("\n Warning! Unable to read the table image %s. \n",path);
+        hash_table_free(base_ptr);
+        free(table->items);
+        fclose(file);
+        return NULL;
+    }
+
+    fclose(file);
+
+    /* same mapping as init_hash_table(), without clearing the slots */
+    table->capacity       = base_ptr;
+    table->nvals_per_item = base_ptr + sizeof(uint64_t);
+    table->filter         = NULL;
+    table->probe          = header[1];
+    table->expiry         = NULL;
+    table->sweep          = 0;
+    table->ntombstones    = header[3];
+    table->max_tombstones = (uint64_t) (TOMBSTONE_MAX_LOAD * capacity);
+    table->compact        = 0;
+    table->gen            = header[2];
+    table->access         = NULL;
+    table->nexpired       = 0;
+    table->nvals          = header[4];
+
+    *(table->capacity)       = capacity;
+    *(table->nvals_per_item) = nvals_per_item;
+
+    for(i = 0; i < capacity; i++)
+    {
+        table->items[i] = base_ptr + 2*sizeof(uint64_t) + i*size_of_item;
+    }
+
+    return base_ptr;
+}
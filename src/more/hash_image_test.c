@@ -0,0 +1,119 @@
+/*
+    Test driver for table images: bulk build a table (with duplicate keys), delete some items,
+    clear and refill it so its generation isn't 0 anymore, switch the probe policy, save it and
+    load it back. The loaded table has to have the same items, deleted slots, generation and probe
+    policy, and keep working for inserts and deletes. Files that aren't complete images have to
+    be refused.
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+# include "hash.h"
+
+
+#define ITEM_NVALS 4 // needs to be >= 3
+#define NITEMS     500000
+#define NTHREADS   4
+#define IMAGE_PATH "hash_image_test.img"
+#define BAD_PATH   "hash_image_test.bad"
+
+
+
+static uint64_t
+check_items(hashtable_t *table)
+{
+    uint64_t i, nbad = 0;
+    uint64_t *vals;
+
+    for(i = 0; i < NITEMS; i++)
+    {
+        vals = find_item(table, 7 * i + 1);
+        nbad += (i % 5 == 0) ? (vals != NULL) : (vals == NULL || vals[0] != i || vals[1] != 3 * i);
+    }
+
+    return nbad;
+}
+
+
+
+int main()
+{
+
+    hashtable_t my_table = {NULL}, loaded = {NULL};
+
+    uint64_t nvals_per_item = ITEM_NVALS;
+    uint64_t i, nwrong = 0;
+    uint64_t *keys = malloc((NITEMS + 1) * sizeof(uint64_t));
+    uint64_t *values = malloc((NITEMS + 1) * (nvals_per_item - 2) * sizeof(uint64_t));
+    bool inserted;
+
+
+    // testing...
+
+    // the last record of a duplicate key wins
+    for(i = 0; i < NITEMS; i++)
+    {
+        keys[i] = 7 * i + 1;
+        values[2 * i] = (i == 3) ? 0 : i;
+        values[2 * i + 1] = 3 * i;
+    }
+    keys[NITEMS] = 7 * 3 + 1, values[2 * NITEMS] = 3, values[2 * NITEMS + 1] = 9;
+
+    void * base_ptr = hash_table_build(&my_table, keys, values, NITEMS + 1, nvals_per_item, NTHREADS);
+    nwrong += (base_ptr == NULL);
+
+    // a generation > 0 and deleted slots, both have to survive the round trip
+    hash_table_clear(&my_table);
+    nwrong += !set_probe_policy(&my_table, PROBE_DOUBLE_HASH);
+    for(i = 0; i <= NITEMS; i++) insert_or_assign(&my_table, keys[i], values + 2 * i);
+    for(i = 0; i < NITEMS; i += 5) nwrong += !erase_item(&my_table, keys[i]);
+    nwrong += check_items(&my_table);
+
+    nwrong += !hash_table_save(&my_table, IMAGE_PATH);
+    void * loaded_ptr = hash_table_load(&loaded, IMAGE_PATH);
+
+    if(loaded_ptr == NULL) return 1;
+
+    printf("\n Loaded a table of capacity %lu, generation %lu, %lu deleted slots \n",*(loaded.capacity),loaded.gen,loaded.ntombstones);
+    nwrong += (*(loaded.capacity) != *(my_table.capacity) || loaded.gen != my_table.gen || loaded.probe != PROBE_DOUBLE_HASH ||
+               loaded.ntombstones != my_table.ntombstones || loaded.nvals != my_table.nvals);
+    nwrong += check_items(&loaded);
+
+    // and it is a working table
+    for(i = 0; i < NITEMS; i += 5) nwrong += (find_or_insert(&loaded, keys[i], &inserted) == NULL || !inserted);
+    nwrong += !erase_item(&loaded, keys[1]) || (find_item(&loaded, keys[1]) != NULL);
+
+    // a truncated image and a file that isn't one
+    FILE *in = fopen(IMAGE_PATH, "rb"), *out = fopen(BAD_PATH, "wb");
+    char buffer[4096];
+
+    nwrong += (fread(buffer, 1, sizeof(buffer), in) != sizeof(buffer) || fwrite(buffer, 1, sizeof(buffer), out) != sizeof(buffer));
+    fclose(in);
+    fclose(out);
+
+    hashtable_t bad = {NULL};
+    nwrong += (hash_table_load(&bad, BAD_PATH) != NULL);
+
+    out = fopen(BAD_PATH, "w");
+    fprintf(out, "key,value\n1,2\n");
+    fclose(out);
+    nwrong += (hash_table_load(&bad, BAD_PATH) != NULL);
+
+    remove(IMAGE_PATH);
+    remove(BAD_PATH);
+
+    printf("\n %s \n\n",(nwrong == 0) ? "All checks passed." : "Some checks FAILED.");
+
+    free(my_table.items);
+    free(base_ptr);
+    free(loaded.items);
+    hash_table_free(loaded_ptr);
+    free(keys);
+    free(values);
+
+	return (nwrong == 0) ? 0 : 1;
+}
@@ -0,0 +1,343 @@
+/*
+    Command line bulk loader: builds a generic hash table from a file of key/value records and
+    writes it out as a table image (see hash_image.c).
+
+        hash_load [-b] [-n nvals_per_item] [-t nthreads] [-o image] input
+
+    The input is a CSV file with one record per line, key,value,value,... (decimal; missing
+    values are 0, extra fields are ignored, lines that don't start with a number, e.g. a header,
+    are skipped), or with -b a binary file of fixed width records of nvals_per_item - 1 words
+    (key, then the values, in the byte order of the machine).
+
+    The input is mapped with mmap() and parsed straight from the mapping by nthreads threads,
+    each one taking a contiguous chunk (CSV chunks are moved to the next line start). A first
+    pass counts the lines of every chunk, which sizes the key and value arrays and tells every
+    thread where its records go, a second pass parses them. The table is then presized and
+    filled by hash_table_build(), which inserts in parallel too. Duplicate keys keep the values
+    of their last record.
+
+    Reports records/s and MB/s of input for the ingest (parse + build), so the numbers can be
+    compared from release to release.
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+# include "hash.h"
+
+
+#define LOAD_MAX_THREADS 256
+
+
+
+typedef struct
+{
+    const char * data;         // mapped input
+    uint64_t lo, hi;           // byte range of this thread's chunk
+    bool binary;
+    uint64_t nvals_per_item;
+    uint64_t * keys;
+    uint64_t * values;
+    uint64_t first;            // index of this chunk's first record in keys/values
+    uint64_t nlines;           // pass 1: records (lines) in the chunk, at most
+    uint64_t nrecords;         // pass 2: records parsed
+    uint64_t nbad;             // lines skipped
+
+} load_worker_t;
+
+
+// parse a decimal number at *p, false if there's none
+static inline bool
+parse_u64(const char **p, const char *end, uint64_t *value)
+{
+    const char *s = *p;
+    uint64_t v = 0;
+
+    while(s < end && (*s == ' ' || *s == '\t')) s++;
+
+    if(s == end || *s < '0' || *s > '9') return false;
+
+    while(s < end && *s >= '0' && *s <= '9') v = 10 * v + (uint64_t) (*s++ - '0');
+
+    *p = s;
+    *value = v;
+    return true;
+}
+
+
+static void *
+count_lines(void *ptr)
+{
+    load_worker_t *w = ptr;
+    const char *s = w->data + w->lo, *end = w->data + w->hi;
+
+    w->nlines = 0;
+
+    if(w->binary)
+    {
+        w->nlines = (w->hi - w->lo) / ((w->nvals_per_item - 1) * sizeof(uint64_t));
+        return NULL;
+    }
+
+    while(s < end)
+    {
+        const char *nl = memchr(s, '\n', end - s);
+        w->nlines++;
+        s = (nl != NULL) ? nl + 1 : end;
+    }
+
+    return NULL;
+}
+
+
+static void *
+parse_records(void *ptr)
+{
+    load_worker_t *w = ptr;
+    uint64_t nvals = w->nvals_per_item - 2;
+    uint64_t *keys = w->keys + w->first, *values = w->values + w->first * nvals;
+    const char *s = w->data + w->lo, *end = w->data + w->hi;
+    uint64_t n = 0, j;
+
+    if(w->binary)
+    {
+        const uint64_t *record = (const uint64_t *) s;
+
+        for(n = 0; n < w->nlines; n++, record += 1 + nvals)
+        {
+            keys[n] = record[0];
+            memcpy(values + n * nvals, record + 1, nvals * sizeof(uint64_t));
+        }
+        w->nrecords = n;
+        return NULL;
+    }
+
+    while(s < end)
+    {
+        const char *nl = memchr(s, '\n', end - s);
+        const char *line_end = (nl != NULL) ? nl : end;
+
+        if(parse_u64(&s, line_end, &keys[n]))
+        {
+            for(j = 0; j < nvals; j++)
+            {
+                values[n * nvals + j] = 0;
+
+                while(s < line_end && *s != ',') s++;
+                if(s < line_end) s++;
+
+                parse_u64(&s, line_end, &values[n * nvals + j]);
+            }
+            n++;
+        }
+        else if(line_end > s && !(line_end - s == 1 && *s == '\r'))
+        {
+            w->nbad++;
+        }
+
+        s = line_end + 1;
+    }
+
+    w->nrecords = n;
+    return NULL;
+}
+
+
+// run fn on every worker, one thread each (the calling thread takes worker 0)
+static void
+run_workers(void *(*fn)(void *), load_worker_t *workers, const int nthreads)
+{
+    pthread_t threads[nthreads];
+    int t, nstarted;
+
+    for(nstarted = 1; nstarted < nthreads; nstarted++)
+    {
+        if(pthread_create(&threads[nstarted], NULL, fn, &workers[nstarted]) != 0) break;
+    }
+
+    fn(&workers[0]);
+
+    for(t = 1; t < nstarted; t++) pthread_join(threads[t], NULL);
+
+    // chunks whose thread couldn't be started
+    for(t = nstarted; t < nthreads; t++) fn(&workers[t]);
+}
+
+
+static void
+usage(const char *name)
+{
+    printf("\n usage: %s [-b] [-n nvals_per_item] [-t nthreads] [-o image] input \n",name);
+    printf("\n   -b   binary input, records of nvals_per_item - 1 words (default: CSV, key,value,...) \n");
+    printf("   -n   number of values per item, as in init_hash_table() (default 3, i.e. one value per key) \n");
+    printf("   -t   number of threads (default: all cores) \n");
+    printf("   -o   write the table image to this file \n\n");
+}
+
+
+int main(int argc, char **argv)
+{
+
+    hashtable_t my_table;
+
+    uint64_t nvals_per_item = 3;
+    int nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+    const char *image = NULL;
+    bool binary = false;
+    int opt, t;
+
+    while((opt = getopt(argc, argv, "bn:t:o:h")) != -1)
+    {
+        switch(opt)
+        {
+            case 'b': binary = true; break;
+            case 'n': nvals_per_item = strtoul(optarg, NULL, 10); break;
+            case 't': nthreads = atoi(optarg); break;
+            case 'o': image = optarg; break;
+            default:  usage(argv[0]); return 1;
+        }
+    }
+
+    if(optind != argc - 1 || nvals_per_item < 3)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if(nthreads < 1) nthreads = 1;
+    if(nthreads > LOAD_MAX_THREADS) nthreads = LOAD_MAX_THREADS;
+
+    uint64_t t_start = hash_time_now();
+
+    /* map the input */
+    struct stat st;
+    int fd = open(argv[optind], O_RDONLY);
+
+    if(fd < 0 || fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        printf("\n Unable to open %s, or it is empty. \n",argv[optind]);
+        return 1;
+    }
+
+    uint64_t size = st.st_size;
+    uint64_t record_bytes = (nvals_per_item - 1) * sizeof(uint64_t);
+    const char *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if(data == MAP_FAILED)
+    {
+        printf("\n Unable to map %s. \n",argv[optind]);
+        return 1;
+    }
+
+    // advice values aren't flags, each one takes a call of its own
+    madvise((void *) data, size, MADV_SEQUENTIAL);
+    madvise((void *) data, size, MADV_WILLNEED);
+
+    if(binary && size % record_bytes != 0)
+    {
+        printf("\n Warning! %s is not a whole number of %lu byte records, ignoring the last %lu bytes. \n",argv[optind],record_bytes,size % record_bytes);
+    }
+
+    /* chunks: binary ones on record boundaries, CSV ones on line starts */
+    load_worker_t workers[nthreads];
+    uint64_t nrecords_in = binary ? size / record_bytes : 0;
+
+    for(t = 0; t < nthreads; t++)
+    {
+        uint64_t lo;
+
+        if(binary)
+        {
+            lo = (uint64_t) ((unsigned __int128) nrecords_in * t / nthreads) * record_bytes;
+        }
+        else
+        {
+            lo = (uint64_t) ((unsigned __int128) size * t / nthreads);
+            while(lo > 0 && lo < size && data[lo - 1] != '\n') lo++;
+        }
+
+        workers[t] = (load_worker_t) {.data = data, .lo = lo, .binary = binary, .nvals_per_item = nvals_per_item};
+        if(t > 0) workers[t - 1].hi = lo;
+    }
+    workers[nthreads - 1].hi = binary ? nrecords_in * record_bytes : size;
+
+    /* pass 1: count, pass 2: parse into each chunk's stretch of the arrays */
+    run_workers(count_lines, workers, nthreads);
+
+    uint64_t nlines = 0;
+    for(t = 0; t < nthreads; t++)
+    {
+        workers[t].first = nlines;
+        nlines += workers[t].nlines;
+    }
+
+    uint64_t *keys = malloc(nlines * sizeof(uint64_t) + 1);
+    uint64_t *values = malloc(nlines * (nvals_per_item - 2) * sizeof(uint64_t) + 1);
+
+    if(keys == NULL || values == NULL)
+    {
+        printf("\n Unable to allocate the arrays for %lu records. \n",nlines);
+        return 1;
+    }
+
+    for(t = 0; t < nthreads; t++)
+    {
+        workers[t].keys = keys;
+        workers[t].values = values;
+    }
+
+    run_workers(parse_records, workers, nthreads);
+
+    // close the gaps left by skipped lines
+    uint64_t nrecords = 0, nbad = 0;
+    for(t = 0; t < nthreads; t++)
+    {
+        memmove(keys + nrecords, keys + workers[t].first, workers[t].nrecords * sizeof(uint64_t));
+        memmove(values + nrecords * (nvals_per_item - 2), values + workers[t].first * (nvals_per_item - 2),
+                workers[t].nrecords * (nvals_per_item - 2) * sizeof(uint64_t));
+        nrecords += workers[t].nrecords;
+        nbad += workers[t].nbad;
+    }
+
+    uint64_t t_parsed = hash_time_now();
+
+    /* presized parallel build */
+    void *base_ptr = hash_table_build(&my_table, keys, values, nrecords, nvals_per_item, nthreads);
+
+    uint64_t t_built = hash_time_now();
+
+    munmap((void *) data, size);
+    free(keys);
+    free(values);
+
+    if(base_ptr == NULL) return 1;
+
+    bool saved = (image == NULL) || hash_table_save(&my_table, image);
+
+    uint64_t t_end = hash_time_now();
+
+    double parse_s = (t_parsed - t_start) * 1e-9, build_s = (t_built - t_parsed) * 1e-9;
+    double ingest_s = parse_s + build_s, total_s = (t_end - t_start) * 1e-9;
+
+    printf("\n Loaded %lu records (%lu lines skipped) from %s, %.1f MB, %i threads \n",nrecords,nbad,argv[optind],size / 1048576.0,nthreads);
+    printf(" table capacity %lu, nvals_per_item %lu \n",*(my_table.capacity),nvals_per_item);
+    printf(" parse %.3f s, build %.3f s, write %.3f s \n",parse_s,build_s,total_s - ingest_s);
+    printf(" ingest: %.0f records/s, %.1f MB/s \n",nrecords / ingest_s,size / 1048576.0 / ingest_s);
+    if(image != NULL && saved) printf(" table image written to %s \n",image);
+    printf("\n");
+
+    free(my_table.items);
+    free(base_ptr);
+
+	return saved ? 0 : 1;
+}
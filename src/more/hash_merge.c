@@ -0,0 +1,308 @@
+/*
+    Parallel merge (union) of one generic hash table into another.
+
+    The slot array of the source is cut into chunks of MERGE_CHUNK_SLOTS slots, which the merge
+    threads claim one after the other from a shared counter. A thread collects the live items of
+    its chunk in batches of MERGE_BATCH, prefetching the home slot of every item in the
+    destination as it goes, and then inserts the batch with find_or_insert_atomic(), so the
+    cache misses of a whole batch overlap instead of coming one insert at a time.
+
+    Keys that exist in both tables are resolved by the merge policy (keep the destination's
+    values, overwrite them with the source's, or add them up). Every key occurs only once in the
+    source, so only one thread ever touches the value row of a given key and the values can be
+    combined with plain stores.
+
+    The destination is presized before the merge: if it hasn't got room for its own slots in use
+    plus the items of the source at BUILD_MAX_LOAD (see merge_capacity()), it is first rehashed
+    into a bigger table. Deleted slots of the destination count as in use, since the atomic
+    insert never reuses them. The destination can't have an expiry array; an attached filter is
+    rebuilt after the merge, at the size of the grown table if the destination had to grow.
+    Expired items of the source are skipped.
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <assert.h>
+
+# include "hash.h"
+
+
+#define MERGE_MAX_THREADS 256
+#define MERGE_CHUNK_SLOTS 4096 // source slots claimed by a merge thread at a time
+#define MERGE_BATCH       16   // items whose destination slots are prefetched before they are inserted
+
+
+
+typedef struct
+{
+    hashtable_t * dst;
+    const hashtable_t * src;
+    merge_policy_t policy;
+    uint64_t now;              // expiry time of the source items (0 if the source has no expiry array)
+    uint64_t * next_chunk;     // shared chunk counter
+    bool ok;
+
+} merge_worker_t;
+
+
+// slots of the table that are occupied (or deleted too, with deleted set)
+static uint64_t
+used_slots(const hashtable_t *table, const bool deleted)
+{
+    void *base_ptr = table->capacity;
+    uint64_t capacity = *(table->capacity);
+    uint64_t size_of_item = (1 + *(table->nvals_per_item)) * sizeof(uint64_t);
+    uint64_t i, n = 0, *p;
+
+    for(i = 0; i < capacity; i++)
+    {
+        p = base_ptr + 3*sizeof(uint64_t) + i*size_of_item;
+
+        uint64_t slot_status = slot_state(table, p);
+        if(slot_status == 1 || (deleted && slot_status == 2)) n++;
+    }
+
+    return n;
+}
+
+
+// capacity a destination table needs to take in the items of src at BUILD_MAX_LOAD (honoring the probe policy of dst)
+uint64_t
+merge_capacity(const hashtable_t *dst, const hashtable_t *src)
+{
+    assert(dst != NULL && src != NULL);
+
+    uint64_t capacity = (uint64_t) ((used_slots(dst, true) + used_slots(src, false)) / BUILD_MAX_LOAD) + 1;
+
+    if(dst->probe == PROBE_QUADRATIC)
+    {
+        uint64_t pow2 = 1;
+        while(pow2 < capacity) pow2 <<= 1;
+        capacity = pow2;
+    }
+    else if(dst->probe == PROBE_BUCKETED)
+    {
+        uint64_t group = probe_step(dst, 0);
+        capacity = (capacity + group - 1) / group * group;
+    }
+
+    return capacity;
+}
+
+
+static void
+merge_batch(merge_worker_t *w, uint64_t **batch, const int nbatch)
+{
+    uint64_t nvals = w->dst->nvals;
+    uint64_t j, *vals;
+    bool inserted;
+    int b;
+
+    for(b = 0; b < nbatch; b++)
+    {
+        vals = find_or_insert_atomic(w->dst, batch[b][1], batch[b] + 2, &inserted);
+
+        if(vals == NULL)
+        {
+            w->ok = false;
+            continue;
+        }
+
+        if(inserted || w->policy == MERGE_KEEP) continue;
+
+        for(j = 0; j < nvals; j++)
+        {
+            vals[j] = (w->policy == MERGE_SUM) ? vals[j] + batch[b][2 + j] : batch[b][2 + j];
+        }
+    }
+}
+
+
+static void *
+merge_worker(void *ptr)
+{
+    merge_worker_t *w = ptr;
+    const hashtable_t *src = w->src;
+    void *src_base = src->capacity, *dst_base = w->dst->capacity;
+    uint64_t src_capacity = *(src->capacity), dst_capacity = *(w->dst->capacity);
+    uint64_t src_size_of_item = (1 + *(src->nvals_per_item)) * sizeof(uint64_t);
+    uint64_t dst_size_of_item = (1 + *(w->dst->nvals_per_item)) * sizeof(uint64_t);
+    uint64_t *batch[MERGE_BATCH];
+    uint64_t i, *p;
+    int nbatch = 0;
+
+    for(;;)
+    {
+        uint64_t lo = __atomic_fetch_add(w->next_chunk, 1, __ATOMIC_RELAXED) * MERGE_CHUNK_SLOTS;
+        uint64_t hi = (lo + MERGE_CHUNK_SLOTS < src_capacity) ? lo + MERGE_CHUNK_SLOTS : src_capacity;
+
+        if(lo >= src_capacity) break;
+
+        for(i = lo; i < hi; i++)
+        {
+            p = src_base + 3*sizeof(uint64_t) + i*src_size_of_item;
+
+            if(slot_state(src, p) != 1) continue;
+
+            // only skipped, turning them into deleted slots would race on src->ntombstones
+            if(src->expiry != NULL && src->expiry[i] != 0 && src->expiry[i] <= w->now) continue;
+
+            __builtin_prefetch(dst_base + 3*sizeof(uint64_t) + hash(p[1], dst_capacity)*dst_size_of_item, 1, 1);
+            batch[nbatch++] = p;
+
+            if(nbatch == MERGE_BATCH)
+            {
+                merge_batch(w, batch, nbatch);
+                nbatch = 0;
+            }
+        }
+    }
+
+    merge_batch(w, batch, nbatch);
+
+    return NULL;
+}
+
+
+// merge src into dst (which has enough room) with nthreads threads
+static bool
+merge_into(hashtable_t *dst, const hashtable_t *src, const merge_policy_t policy, const int nthreads)
+{
+    uint64_t next_chunk = 0;
+    uint64_t now = (src->expiry != NULL) ? hash_time_now() : 0;
+    int t, T = nthreads, nstarted;
+    bool ok = true;
+
+    if(T < 1) T = 1;
+    if(T > MERGE_MAX_THREADS) T = MERGE_MAX_THREADS;
+
+    merge_worker_t workers[T];
+    pthread_t threads[T];
+
+    for(t = 0; t < T; t++)
+    {
+        workers[t] = (merge_worker_t) {.dst = dst, .src = src, .policy = policy, .now = now, .next_chunk = &next_chunk, .ok = true};
+    }
+
+    // chunks are claimed dynamically, so threads that can't be started just leave more of them to the others
+    for(nstarted = 1; nstarted < T; nstarted++)
+    {
+        if(pthread_create(&threads[nstarted], NULL, merge_worker, &workers[nstarted]) != 0) break;
+    }
+
+    merge_worker(&workers[0]);
+
+    for(t = 1; t < nstarted; t++)
+    {
+        pthread_join(threads[t], NULL);
+    }
+
+    for(t = 0; t < nstarted; t++)
+    {
+        ok = ok && workers[t].ok;
+    }
+
+    return ok;
+}
+
+
+/*
+    Merge the items of src into dst with nthreads threads, keys found in both are resolved by
+    policy. Returns the base_ptr of dst: the one it had, or if dst had to grow, the memory of the
+    bigger table it was rehashed into (allocated with hash_table_alloc(), release with
+    hash_table_free(); the old memory is left to the caller). An attached filter then gets
+    replaced by one sized for the bigger table (dst->filter, allocated with aligned_alloc(),
+    release with free(); the old one is left to the caller too). Returns NULL on failure: a dst
+    that had to grow is then left as it was, one that didn't may hold part of the items of src.
+*/
+void *
+hash_table_merge(hashtable_t *dst, const hashtable_t *src, const merge_policy_t policy, const int nthreads)
+{
+    assert(dst != NULL && src != NULL);
+
+    uint64_t nvals_per_item = dst->nvals + 2;
+    uint64_t capacity = merge_capacity(dst, src);
+    uint64_t *filter = dst->filter;
+    void *base_ptr = dst->capacity;
+    bool ok;
+
+    if(src->nvals != dst->nvals || dst->expiry != NULL)
+    {
+        printf("\n Warning! Tables with different nvals_per_item, or a destination with an expiry array, can't be merged. \n");
+        return NULL;
+    }
+
+    // the atomic insert doesn't maintain a filter, it is rebuilt at the end
+    dst->filter = NULL;
+
+    if(capacity > *(dst->capacity))
+    {
+        // padded slots stay padded
+        bool padded = *(dst->nvals_per_item) != nvals_per_item;
+        hashtable_t grown;
+        void *grown_ptr = hash_table_alloc(capacity, nvals_per_item, padded ? HASH_ALLOC_PAD_SLOTS : 0);
+
+        if(grown_ptr == NULL)
+        {
+            dst->filter = filter;
+            return NULL;
+        }
+
+        if(padded) init_hash_table_padded(&grown, grown_ptr, capacity, nvals_per_item);
+        else init_hash_table(&grown, grown_ptr, capacity, nvals_per_item);
+        set_probe_policy(&grown, dst->probe);
+
+        // dst is only replaced once the rehash and the merge both went through, a failure leaves it as it was
+        if(!merge_into(&grown, dst, MERGE_OVERWRITE, nthreads) || !merge_into(&grown, src, policy, nthreads))
+        {
+            printf("\n Warning! Unable to merge into the grown destination table, the destination is left as it was. \n");
+            free(grown.items);
+            hash_table_free(grown_ptr);
+            dst->filter = filter;
+            return NULL;
+        }
+
+        grown.max_tombstones = (dst->max_tombstones > 0) ? grown.max_tombstones : 0;
+        free(dst->items);
+        *dst = grown;
+
+        // the old filter is sized for the old capacity, a new one is filled from the grown table
+        if(filter != NULL)
+        {
+            uint64_t nbytes = filter_bytes(capacity);
+            uint64_t *grown_filter = aligned_alloc(64, nbytes);
+
+            if(grown_filter != NULL)
+            {
+                grown_filter[0] = nbytes / 64 - 1;
+                filter = grown_filter;
+            }
+            else
+            {
+                printf("\n Warning! Unable to allocate a filter for the grown table, keeping the old one. \n");
+            }
+
+            dst->filter = filter;
+            rebuild_filter(dst);
+        }
+
+        return grown_ptr;
+    }
+
+    ok = merge_into(dst, src, policy, nthreads);
+
+    dst->filter = filter;
+    if(filter != NULL) rebuild_filter(dst);
+
+    if(!ok)
+    {
+        printf("\n Warning! Ran out of empty slots while merging the hash tables. \n");
+        return NULL;
+    }
+
+    return base_ptr;
+}
@@ -0,0 +1,104 @@
+/*
+    Test driver for the parallel merge: merge a table into a smaller one that has to grow for it,
+    with every merge policy and several probe policies, and check every key of either table for
+    the values the policy asks for. The destination has a filter attached, which has to grow with
+    the table: no false negatives, and about the false positive rate of a filter of that size.
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+# include "hash.h"
+
+
+#define ITEM_NVALS 4      // needs to be >= 3
+#define NKEYS      200000 // keys of the source, the destination has a quarter of that
+#define DST_SIZE   65536  // a power of 2 and a multiple of the bucket group, so every probe policy applies
+#define NTHREADS   4
+#define NABSENT    100000
+
+
+
+int main()
+{
+
+    hashtable_t dst = {NULL}, src = {NULL};
+
+    uint64_t nvals_per_item = ITEM_NVALS;
+    uint64_t dst_capacity = DST_SIZE, src_capacity = 2 * NKEYS;
+    uint64_t dst_keys = NKEYS / 4, first_src_key = NKEYS / 8; // overlapping key ranges
+    uint64_t key, npassed, nwrong = 0;
+    merge_policy_t policy;
+    probe_policy_t probe;
+    uint64_t *vals;
+    bool inserted;
+
+
+    // testing...
+
+    for(policy = MERGE_KEEP; policy <= MERGE_SUM; policy++)
+    {
+        for(probe = PROBE_LINEAR; probe <= PROBE_BUCKETED; probe++)
+        {
+            uint64_t nbad = 0;
+            void * dst_ptr = hash_table_alloc(dst_capacity, nvals_per_item, 0);
+            void * src_ptr = hash_table_alloc(src_capacity, nvals_per_item, 0);
+            void * filter_ptr = aligned_alloc(64, filter_bytes(dst_capacity));
+
+            init_hash_table(&dst, dst_ptr, dst_capacity, nvals_per_item);
+            init_hash_table(&src, src_ptr, src_capacity, nvals_per_item);
+            set_probe_policy(&dst, probe);
+
+            for(key = 0; key < dst_keys; key++)
+            {
+                vals = find_or_insert(&dst, key, &inserted);
+                vals[0] = key, vals[1] = 1;
+            }
+            attach_filter(&dst, filter_ptr, filter_bytes(dst_capacity));
+
+            for(key = first_src_key; key < first_src_key + NKEYS; key++)
+            {
+                vals = find_or_insert(&src, key, &inserted);
+                vals[0] = 2 * key, vals[1] = 10;
+            }
+
+            void * merged_ptr = hash_table_merge(&dst, &src, policy, NTHREADS);
+            nbad += (merged_ptr == NULL || merged_ptr == dst_ptr);
+
+            for(key = 0; key < first_src_key + NKEYS && merged_ptr != NULL; key++)
+            {
+                bool in_dst = key < dst_keys, in_src = key >= first_src_key;
+                uint64_t v0 = in_dst ? key : 2 * key, v1 = in_dst ? 1 : 10;
+
+                if(in_dst && in_src && policy == MERGE_OVERWRITE) v0 = 2 * key, v1 = 10;
+                if(in_dst && in_src && policy == MERGE_SUM) v0 = 3 * key, v1 = 11;
+
+                vals = find_item(&dst, key);
+                nbad += (vals == NULL || vals[0] != v0 || vals[1] != v1 || !filter_may_contain(&dst, key));
+            }
+
+            // a filter of the grown table's size, not the old one filled with four times the keys
+            for(npassed = 0, key = 0; key < NABSENT; key++) npassed += filter_may_contain(&dst, murmur_hash_64(key, 5) | (1UL << 63));
+            nbad += (dst.filter == filter_ptr || dst.filter[0] != filter_bytes(*(dst.capacity)) / 64 - 1 || npassed > NABSENT / 50);
+
+            printf("\n merge policy %i, probe policy %i: capacity %lu -> %lu, %.2f%% filter false positives %s \n",
+                   policy,probe,dst_capacity,*(dst.capacity),100.0 * npassed / NABSENT,(nbad == 0) ? "ok" : "FAILED");
+            nwrong += nbad;
+
+            free(dst.items);
+            free(src.items);
+            if(dst.filter != filter_ptr) free(dst.filter);
+            if(merged_ptr != NULL && merged_ptr != dst_ptr) hash_table_free(merged_ptr);
+            hash_table_free(dst_ptr);
+            hash_table_free(src_ptr);
+            free(filter_ptr);
+        }
+    }
+
+    printf("\n %s \n\n",(nwrong == 0) ? "All checks passed." : "Some checks FAILED.");
+
+	return (nwrong == 0) ? 0 : 1;
+}
@@ -0,0 +1,196 @@
+/*
+    Hardware performance counters around table operations, with perf_event_open().
+
+    init_hash_perf() opens cycles, instructions, L1D/LLC/dTLB read misses and branch misses
+    for the calling thread (user space only, so perf_event_paranoid = 2 is fine). Each
+    counter is opened on its own rather than as a group, so a PMU with fewer slots than
+    counters multiplexes them instead of refusing the group, and the counts are scaled by
+    time enabled / time running. hash_perf_start()/hash_perf_stop() bracket a stretch of
+    operations and add up its counts, print_hash_perf() divides them by the number of
+    operations.
+
+    Counters that can't be opened (no PMU in a VM or container, perf_event_paranoid = 3, no
+    such cache event on this CPU, not Linux) are left out and print as "-". The wall time is
+    always measured, so with no counters at all the report still has ns per operation.
+
+    Reading the counters costs a system call each, so bracket whole batches of operations,
+    not single ones.
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <assert.h>
+
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+# include "hash.h"
+
+
+static const char *perf_names[PERF_NCOUNTERS] = {"cycles", "instr", "L1D miss", "LLC miss", "dTLB miss", "br miss"};
+
+
+
+#ifdef __linux__
+
+static int
+open_counter(const uint32_t type, const uint64_t config)
+{
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    return (int) syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+#define CACHE_READ_MISS(cache) ((cache) | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+#endif
+
+
+/*
+    Open the counters for the calling thread. Returns false if none of them is available (the
+    perf struct can be used all the same, it then only measures time).
+*/
+bool
+init_hash_perf(hash_perf_t *perf)
+{
+    assert(perf != NULL);
+
+    int c;
+
+    memset(perf, 0, sizeof(hash_perf_t));
+    for(c = 0; c < PERF_NCOUNTERS; c++) perf->fd[c] = -1;
+
+#ifdef __linux__
+    perf->fd[PERF_CYCLES]        = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    perf->fd[PERF_INSTRUCTIONS]  = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    perf->fd[PERF_L1D_MISSES]    = open_counter(PERF_TYPE_HW_CACHE, CACHE_READ_MISS(PERF_COUNT_HW_CACHE_L1D));
+    perf->fd[PERF_LLC_MISSES]    = open_counter(PERF_TYPE_HW_CACHE, CACHE_READ_MISS(PERF_COUNT_HW_CACHE_LL));
+    perf->fd[PERF_DTLB_MISSES]   = open_counter(PERF_TYPE_HW_CACHE, CACHE_READ_MISS(PERF_COUNT_HW_CACHE_DTLB));
+    perf->fd[PERF_BRANCH_MISSES] = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+#endif
+
+    for(c = 0; c < PERF_NCOUNTERS; c++)
+    {
+        if(perf->fd[c] < 0) perf->fd[c] = -1;
+        else perf->navailable++;
+    }
+
+    if(perf->navailable == 0)
+    {
+        printf("\n Warning! No hardware performance counters available (see /proc/sys/kernel/perf_event_paranoid), reporting time only. \n");
+        return false;
+    }
+
+    return true;
+}
+
+
+void
+hash_perf_start(hash_perf_t *perf)
+{
+    int c;
+
+    for(c = 0; c < PERF_NCOUNTERS; c++)
+    {
+        if(perf->fd[c] >= 0 && read(perf->fd[c], perf->start[c], sizeof(perf->start[c])) != sizeof(perf->start[c]))
+        {
+            close(perf->fd[c]);
+            perf->fd[c] = -1;
+            perf->navailable--;
+        }
+    }
+
+    perf->t_start = hash_time_now();
+}
+
+
+void
+hash_perf_stop(hash_perf_t *perf)
+{
+    uint64_t t_stop = hash_time_now(), now[3];
+    int c;
+
+    perf->ns += t_stop - perf->t_start;
+
+    for(c = 0; c < PERF_NCOUNTERS; c++)
+    {
+        if(perf->fd[c] < 0 || read(perf->fd[c], now, sizeof(now)) != sizeof(now)) continue;
+
+        // counted for (running / enabled) of the stretch while multiplexed
+        uint64_t value = now[0] - perf->start[c][0];
+        uint64_t enabled = now[1] - perf->start[c][1], running = now[2] - perf->start[c][2];
+
+        perf->counts[c] += (running > 0) ? (double) value * enabled / running : 0.0;
+    }
+}
+
+
+void
+hash_perf_reset(hash_perf_t *perf)
+{
+    memset(perf->counts, 0, sizeof(perf->counts));
+    perf->ns = 0;
+}
+
+
+// one line of time and counts per operation, print_hash_perf(NULL, ...) prints the column headings
+void
+print_hash_perf(const hash_perf_t *perf, const char *label, const uint64_t nops)
+{
+    int c;
+
+    if(perf == NULL)
+    {
+        printf(" %-16s %9s","",label);
+        for(c = 0; c < PERF_NCOUNTERS; c++) printf(" %9s",perf_names[c]);
+        printf(" %6s \n","IPC");
+        return;
+    }
+
+    double n = (nops > 0) ? (double) nops : 1.0;
+
+    printf(" %-16s %9.1f",label,perf->ns / n);
+
+    for(c = 0; c < PERF_NCOUNTERS; c++)
+    {
+        if(perf->fd[c] >= 0) printf(" %9.2f",perf->counts[c] / n);
+        else                 printf(" %9s","-");
+    }
+
+    if(perf->fd[PERF_CYCLES] >= 0 && perf->fd[PERF_INSTRUCTIONS] >= 0 && perf->counts[PERF_CYCLES] > 0.0)
+    {
+        printf(" %6.2f \n",perf->counts[PERF_INSTRUCTIONS] / perf->counts[PERF_CYCLES]);
+    }
+    else printf(" %6s \n","-");
+}
+
+
+void
+free_hash_perf(hash_perf_t *perf)
+{
+    int c;
+
+    for(c = 0; c < PERF_NCOUNTERS; c++)
+    {
+        if(perf->fd[c] >= 0) close(perf->fd[c]);
+        perf->fd[c] = -1;
+    }
+
+    perf->navailable = 0;
+}
@@ -0,0 +1,120 @@
+/*
+    Test driver for the hardware performance counters: bracket batches of lookups and check that
+    time is always measured, that the counters that could be opened count (at least one
+    instruction per lookup, about twice as many for twice the lookups) and those that couldn't
+    stay at 0 and print as "-", and that reset and free leave a perf struct that still measures
+    time. Without any counters (a VM, a container, perf_event_paranoid = 3) only the time checks
+    apply, that isn't a failure.
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+# include "hash.h"
+
+
+#define TABLE_SIZE (1 << 20)
+#define ITEM_NVALS 4 // needs to be >= 3
+#define NITEMS     (TABLE_SIZE / 2)
+#define NLOOKUPS   1000000
+
+
+
+static uint64_t
+lookups(hashtable_t *table, const uint64_t n)
+{
+    uint64_t i, nfound = 0;
+
+    for(i = 0; i < n; i++) nfound += (find_item(table, murmur_hash_64(i % NITEMS, 1)) != NULL);
+
+    return nfound;
+}
+
+
+
+int main()
+{
+
+    hashtable_t my_table = {NULL};
+    hash_perf_t perf;
+
+    uint64_t table_capacity = TABLE_SIZE;
+    uint64_t nvals_per_item = ITEM_NVALS;
+    uint64_t i, nwrong = 0;
+    bool inserted;
+    int c, navailable = 0;
+    void * base_ptr = hash_table_alloc(table_capacity, nvals_per_item, 0);
+
+    init_hash_table(&my_table, base_ptr, table_capacity, nvals_per_item);
+    for(i = 0; i < NITEMS; i++) nwrong += (find_or_insert(&my_table, murmur_hash_64(i, 1), &inserted) == NULL);
+
+
+    // testing...
+
+    bool have_counters = init_hash_perf(&perf);
+
+    for(c = 0; c < PERF_NCOUNTERS; c++) navailable += (perf.fd[c] >= 0);
+    nwrong += (have_counters != (perf.navailable > 0) || navailable != perf.navailable);
+    printf("\n %i of %i counters available \n\n",perf.navailable,PERF_NCOUNTERS);
+
+    hash_perf_start(&perf);
+    nwrong += (lookups(&my_table, NLOOKUPS) != NLOOKUPS);
+    hash_perf_stop(&perf);
+
+    print_hash_perf(NULL, "ns/op", 0);
+    print_hash_perf(&perf, "lookup", NLOOKUPS);
+
+    double single[PERF_NCOUNTERS];
+    uint64_t single_ns = perf.ns;
+
+    nwrong += (perf.ns == 0);
+    for(c = 0; c < PERF_NCOUNTERS; c++)
+    {
+        single[c] = perf.counts[c];
+        if(perf.fd[c] < 0) nwrong += (perf.counts[c] != 0.0);
+    }
+    if(perf.fd[PERF_INSTRUCTIONS] >= 0) nwrong += (perf.counts[PERF_INSTRUCTIONS] < NLOOKUPS);
+    if(perf.fd[PERF_CYCLES] >= 0) nwrong += (perf.counts[PERF_CYCLES] <= 0.0);
+
+    // a second stretch adds up with the first
+    hash_perf_start(&perf);
+    nwrong += (lookups(&my_table, NLOOKUPS) != NLOOKUPS);
+    hash_perf_stop(&perf);
+
+    print_hash_perf(&perf, "2 x lookup", NLOOKUPS);
+
+    nwrong += (perf.ns <= single_ns);
+    if(perf.fd[PERF_INSTRUCTIONS] >= 0)
+    {
+        double ratio = perf.counts[PERF_INSTRUCTIONS] / single[PERF_INSTRUCTIONS];
+        nwrong += (ratio < 1.5 || ratio > 2.5);
+    }
+
+    hash_perf_reset(&perf);
+    nwrong += (perf.ns != 0);
+    for(c = 0; c < PERF_NCOUNTERS; c++) nwrong += (perf.counts[c] != 0.0);
+
+    // closed counters print as "-", the time is still measured
+    free_hash_perf(&perf);
+    nwrong += (perf.navailable != 0);
+    for(c = 0; c < PERF_NCOUNTERS; c++) nwrong += (perf.fd[c] != -1);
+
+    hash_perf_start(&perf);
+    nwrong += (lookups(&my_table, NLOOKUPS / 10) != NLOOKUPS / 10);
+    hash_perf_stop(&perf);
+
+    print_hash_perf(&perf, "closed", NLOOKUPS / 10);
+    nwrong += (perf.ns == 0);
+    for(c = 0; c < PERF_NCOUNTERS; c++) nwrong += (perf.counts[c] != 0.0);
+    free_hash_perf(&perf);
+
+    printf("\n %s \n\n",(nwrong == 0) ? "All checks passed." : "Some checks FAILED.");
+
+    free(my_table.items);
+    hash_table_free(base_ptr);
+
+	return (nwrong == 0) ? 0 : 1;
+}
@@ -0,0 +1,136 @@
+/*
+    Constant time clearing of the generic hash table, and a pool of tables for reuse.
+
+    Every status word carries the generation of the table it was written in (see slot_state() in
+    hash.h), so clearing a table just bumps table->gen: all slots written before read as empty
+    from then on, and get overwritten as new items come in. Only after SLOT_GEN_MAX clears do the
+    status words actually get zeroed, when the generation wraps around. An attached filter still
+    has its bits zeroed, which is a small fraction of the table (see filter_bytes()).
+
+    The pool keeps cleared tables of one capacity and item size around, so short lived scratch
+    tables cost neither an allocation nor a zeroing pass over their memory.
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+# include "hash.h"
+
+
+
+// remove all items from the table in O(1)
+void
+hash_table_clear(hashtable_t *table)
+{
+    assert(table != NULL);
+
+    void *base_ptr = table->capacity;
+    uint64_t capacity = *(table->capacity);
+    uint64_t size_of_item = (1 + *(table->nvals_per_item)) * sizeof(uint64_t);
+    uint64_t i, *p;
+
+    if(table->gen == SLOT_GEN_MAX)
+    {
+        for(i = 0; i < capacity; i++)
+        {
+            p = base_ptr + 3*sizeof(uint64_t) + i*size_of_item;
+            p[0] = 0;
+        }
+        table->gen = 0;
+    }
+    else
+    {
+        table->gen++;
+    }
+
+    table->ntombstones = 0;
+    table->compact = 0;
+    table->sweep = 0;
+
+    if(table->filter != NULL) memset(table->filter + 8, 0, table->filter[0] * 64);
+}
+
+
+void
+init_table_pool(hashtable_pool_t *pool, const uint64_t table_capacity, const uint64_t nvals_per_item, const int alloc_flags)
+{
+    assert(pool != NULL);
+
+    *pool = (hashtable_pool_t) {.capacity = table_capacity, .nvals_per_item = nvals_per_item, .alloc_flags = alloc_flags};
+}
+
+
+// an empty table from the pool, or a newly allocated one if the pool has none left (NULL on failure)
+hashtable_t *
+table_pool_acquire(hashtable_pool_t *pool)
+{
+    assert(pool != NULL);
+
+    if(pool->nfree > 0) return pool->free[--pool->nfree];
+
+    hashtable_t *table = malloc(sizeof(hashtable_t));
+    void *base_ptr = hash_table_alloc(pool->capacity, pool->nvals_per_item, pool->alloc_flags);
+
+    if(table == NULL || base_ptr == NULL)
+    {
+        free(table);
+        hash_table_free(base_ptr);
+        return NULL;
+    }
+
+    // the one zeroing pass this table's memory gets
+    if(pool->alloc_flags & HASH_ALLOC_PAD_SLOTS) init_hash_table_padded(table, base_ptr, pool->capacity, pool->nvals_per_item);
+    else init_hash_table(table, base_ptr, pool->capacity, pool->nvals_per_item);
+    pool->nallocated++;
+
+    return table;
+}
+
+
+static void
+free_pool_table(hashtable_t *table)
+{
+    free(table->items);
+    hash_table_free(table->capacity);
+    free(table);
+}
+
+
+// hand a table back to the pool, it is cleared on the way in
+void
+table_pool_release(hashtable_pool_t *pool, hashtable_t *table)
+{
+    assert(pool != NULL && table != NULL);
+
+    // filters, expiry and access arrays belong to the user of the table, not the pool
+    table->filter = NULL;
+    table->expiry = NULL;
+    table->access = NULL;
+    hash_table_clear(table);
+
+    if(pool->nfree == TABLE_POOL_MAX)
+    {
+        free_pool_table(table);
+        pool->nallocated--;
+        return;
+    }
+
+    pool->free[pool->nfree++] = table;
+}
+
+
+// free the tables in the pool (tables that are still out have to be released first)
+void
+free_table_pool(hashtable_pool_t *pool)
+{
+    while(pool->nfree > 0)
+    {
+        free_pool_table(pool->free[--pool->nfree]);
+        pool->nallocated--;
+    }
+}
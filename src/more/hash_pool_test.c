@@ -0,0 +1,141 @@
+/*
+    Test driver for O(1) table clears and the table pool: fill, delete from and clear the same
+    table round after round, with a filter attached, and check that nothing of an earlier round
+    is found again and that the generation wrapping around still leaves an empty table (the time
+    per clear is printed, most of it is the filter being zeroed). Then check that the pool hands
+    out cleared tables, reuses released ones and frees those it has no room for.
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <time.h>
+
+# include "hash.h"
+
+
+#define TABLE_SIZE (1 << 20)
+#define ITEM_NVALS 4 // needs to be >= 3
+#define NITEMS     (TABLE_SIZE / 2)
+#define NROUNDS    20
+
+
+
+static double
+seconds_now()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+
+static inline uint64_t
+round_key(const uint64_t round, const uint64_t i)
+{
+    return murmur_hash_64(i, round + 1);
+}
+
+
+
+int main()
+{
+
+    hashtable_t my_table = {NULL};
+    hashtable_pool_t pool;
+
+    uint64_t table_capacity = TABLE_SIZE;
+    uint64_t nvals_per_item = ITEM_NVALS;
+    uint64_t nbytes = filter_bytes(table_capacity);
+    uint64_t i, round, nwrong = 0;
+    uint64_t *vals;
+    bool inserted;
+    double clear_seconds = 0.0;
+    void * base_ptr = hash_table_alloc(table_capacity, nvals_per_item, 0);
+    void * filter_ptr = aligned_alloc(64, nbytes);
+
+    init_hash_table(&my_table, base_ptr, table_capacity, nvals_per_item);
+    attach_filter(&my_table, filter_ptr, nbytes);
+
+
+    // testing...
+
+    for(round = 0; round < NROUNDS; round++)
+    {
+        for(i = 0; i < NITEMS; i++)
+        {
+            uint64_t row[2] = {i, round};
+            nwrong += (insert_or_assign(&my_table, round_key(round, i), row) == NULL);
+        }
+
+        // some deleted slots to be cleared as well
+        for(i = 0; i < NITEMS; i += 4) nwrong += !erase_item(&my_table, round_key(round, i));
+
+        for(i = 0; i < NITEMS; i++)
+        {
+            vals = find_item(&my_table, round_key(round, i));
+            nwrong += (i % 4 == 0) ? (vals != NULL) : (vals == NULL || vals[0] != i || vals[1] != round);
+        }
+
+        // nothing of the round before survived the last clear
+        if(round > 0)
+        {
+            for(i = 0; i < NITEMS; i += 7) nwrong += (find_item(&my_table, round_key(round - 1, i)) != NULL);
+        }
+
+        double start = seconds_now();
+        hash_table_clear(&my_table);
+        clear_seconds += seconds_now() - start;
+
+        nwrong += (my_table.ntombstones != 0);
+        for(i = 0; i < NITEMS; i += 7) nwrong += (find_item(&my_table, round_key(round, i)) != NULL);
+    }
+
+    printf("\n %i rounds of %i items: %.1f us per clear, generation %lu \n",NROUNDS,NITEMS,1e6 * clear_seconds / NROUNDS,my_table.gen);
+    nwrong += (my_table.gen != NROUNDS);
+
+    // the generation wraps around: the status words get zeroed for real
+    find_or_insert(&my_table, 1, &inserted);
+    my_table.gen = SLOT_GEN_MAX;
+    find_or_insert(&my_table, 2, &inserted);
+    hash_table_clear(&my_table);
+
+    nwrong += (my_table.gen != 0 || find_item(&my_table, 1) != NULL || find_item(&my_table, 2) != NULL);
+    find_or_insert(&my_table, 2, &inserted);
+    nwrong += (!inserted || find_item(&my_table, 2) == NULL);
+
+    // released tables come back cleared, and the pool keeps at most TABLE_POOL_MAX of them
+    hashtable_t *tables[TABLE_POOL_MAX + 4];
+    int t;
+
+    init_table_pool(&pool, 1024, nvals_per_item, 0);
+
+    for(t = 0; t < TABLE_POOL_MAX + 4; t++)
+    {
+        tables[t] = table_pool_acquire(&pool);
+        nwrong += (tables[t] == NULL || find_or_insert(tables[t], 7, &inserted) == NULL || !inserted);
+    }
+    for(t = 0; t < TABLE_POOL_MAX + 4; t++) table_pool_release(&pool, tables[t]);
+
+    nwrong += (pool.nfree != TABLE_POOL_MAX || pool.nallocated != TABLE_POOL_MAX);
+
+    hashtable_t *reused = table_pool_acquire(&pool);
+    nwrong += (reused != tables[TABLE_POOL_MAX - 1] || find_item(reused, 7) != NULL || pool.nallocated != TABLE_POOL_MAX);
+    table_pool_release(&pool, reused);
+
+    printf("\n Pool: %i tables kept, %lu allocated \n",pool.nfree,pool.nallocated);
+    free_table_pool(&pool);
+    nwrong += (pool.nallocated != 0);
+
+    printf("\n %s \n\n",(nwrong == 0) ? "All checks passed." : "Some checks FAILED.");
+
+    free(my_table.items);
+    hash_table_free(base_ptr);
+    free(filter_ptr);
+
+	return (nwrong == 0) ? 0 : 1;
+}
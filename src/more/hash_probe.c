@@ -0,0 +1,179 @@
+/*
+    Probe sequence policies of the generic hash table and their cluster statistics.
+
+    The probe sequences themselves are the inline probe_step()/probe_slot() in hash.h, which
+    every insert/lookup/delete walks. Here we select the policy of a table and measure how well
+    it spreads a given set of keys: clusters of non-empty slots and the number of probes
+    needed by successful and unsuccessful lookups.
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <assert.h>
+
+# include "hash.h"
+
+
+#define PROBE_MISS_SAMPLES 10000 // absent keys used to measure unsuccessful lookups
+
+
+
+// choose the probe sequence of an empty table, returns false if the policy doesn't suit its capacity
+bool
+set_probe_policy(hashtable_t *table, const probe_policy_t policy)
+{
+    assert(table != NULL);
+
+    void *base_ptr = table->capacity;
+    uint64_t capacity = *(table->capacity);
+    uint64_t nvals_per_item = *(table->nvals_per_item);
+    uint64_t size_of_item = (1 + nvals_per_item) * sizeof(uint64_t);
+    uint64_t i, *p;
+
+    /* items that are already in the table couldn't be found anymore with a different sequence */
+    for(i = 0; i < capacity; i++)
+    {
+        p = base_ptr + 3*sizeof(uint64_t) + i*size_of_item;
+        if(slot_state(table, p) != 0)
+        {
+            printf("\n Warning! Probe policy can only be changed on an empty table. \n");
+            return false;
+        }
+    }
+
+    if(policy == PROBE_QUADRATIC && (capacity & (capacity - 1)) != 0)
+    {
+        printf("\n Warning! Quadratic probing needs a power of 2 table capacity (capacity = %lu). \n",capacity);
+        return false;
+    }
+
+    table->probe = policy;
+
+    if(policy == PROBE_BUCKETED && capacity % probe_step(table, 0) != 0)
+    {
+        printf("\n Warning! Bucketed probing needs a table capacity that is a multiple of %lu. \n",probe_step(table, 0));
+        table->probe = PROBE_LINEAR;
+        return false;
+    }
+
+    return true;
+}
+
+
+// number of probes a lookup of key takes to reach slot (or to find out the key is absent if slot = capacity)
+static uint64_t
+count_probes(const hashtable_t *table, const uint64_t key, const uint64_t slot)
+{
+    void *base_ptr = table->capacity;
+    uint64_t capacity = *(table->capacity);
+    uint64_t nvals_per_item = *(table->nvals_per_item);
+    uint64_t size_of_item = (1 + nvals_per_item) * sizeof(uint64_t);
+    uint64_t index = hash(key, capacity);
+    uint64_t step = probe_step(table, key);
+    uint64_t i, try, *p;
+
+    for(i = 0; i < capacity; i++)
+    {
+        try = probe_slot(table, index, step, i);
+        if(try == slot) return i + 1;
+
+        p = base_ptr + 3*sizeof(uint64_t) + try*size_of_item;
+        if(slot_state(table, p) == 0) return i + 1;
+    }
+
+    return capacity;
+}
+
+
+void
+probe_stats(const hashtable_t *table, probe_stats_t *stats)
+{
+    assert(table != NULL && stats != NULL);
+
+    void *base_ptr = table->capacity;
+    uint64_t capacity = *(table->capacity);
+    uint64_t nvals_per_item = *(table->nvals_per_item);
+    uint64_t size_of_item = (1 + nvals_per_item) * sizeof(uint64_t);
+    uint64_t i, run = 0, first_run = 0, total_probes = 0, total_miss = 0;
+    uint64_t nsamples = (capacity < PROBE_MISS_SAMPLES) ? capacity : PROBE_MISS_SAMPLES;
+    uint64_t *p;
+
+    *stats = (probe_stats_t) {0};
+
+    for(i = 0; i < capacity; i++)
+    {
+        p = base_ptr + 3*sizeof(uint64_t) + i*size_of_item;
+
+        if(slot_state(table, p) == 0)
+        {
+            if(run > 0)
+            {
+                if(stats->nclusters == 0 && run == i) first_run = run;
+                stats->nclusters++;
+                if(run > stats->max_cluster) stats->max_cluster = run;
+            }
+            run = 0;
+            continue;
+        }
+
+        run++;
+
+        if(slot_state(table, p) == 2)
+        {
+            stats->ndeleted++;
+            continue;
+        }
+
+        uint64_t nprobes = count_probes(table, p[1], i);
+        stats->nitems++;
+        total_probes += nprobes;
+        if(nprobes > stats->max_probes) stats->max_probes = nprobes;
+    }
+
+    /* a run at the end of the table wraps around into the one at the start */
+    if(run > 0)
+    {
+        if(first_run > 0 && run < capacity)
+        {
+            run += first_run;
+        }
+        else
+        {
+            stats->nclusters++;
+        }
+        if(run > stats->max_cluster) stats->max_cluster = run;
+    }
+
+    /* unsuccessful lookups, with keys from a range nobody uses */
+    for(i = 0; i < nsamples; i++)
+    {
+        total_miss += count_probes(table, murmur_hash_64(i, PROBE_SEED) | (1UL << 63), capacity);
+    }
+
+    if(stats->nclusters > 0) stats->mean_cluster = (double) (stats->nitems + stats->ndeleted) / stats->nclusters;
+    if(stats->nitems > 0) stats->mean_probes = (double) total_probes / stats->nitems;
+    if(nsamples > 0) stats->mean_miss_probes = (double) total_miss / nsamples;
+}
+
+
+void
+print_probe_stats(const hashtable_t *table)
+{
+    const char *names[] = {"linear", "quadratic", "double hashing", "bucketed linear"};
+    probe_stats_t stats;
+
+    probe_stats(table, &stats);
+
+    printf("\n Probe policy = %s, capacity = %lu \n",names[table->probe],*(table->capacity));
+    printf("\n-------------------------------------------------------\n");
+    printf("\t items            = %lu \n",stats.nitems);
+    printf("\t deleted slots    = %lu \n",stats.ndeleted);
+    printf("\t load factor      = %.3f \n",(double) (stats.nitems + stats.ndeleted) / *(table->capacity));
+    printf("\t clusters         = %lu (mean length %.2f, max %lu) \n",stats.nclusters,stats.mean_cluster,stats.max_cluster);
+    printf("\t probes per hit   = %.2f (max %lu) \n",stats.mean_probes,stats.max_probes);
+    printf("\t probes per miss  = %.2f \n",stats.mean_miss_probes);
+    printf("-------------------------------------------------------\n");
+}
@@ -0,0 +1,95 @@
+/*
+    Test driver for the probe sequence policies: fill a table to 90% load with every policy,
+    check that all items are found, deleted and found again after reinsertion, and print the
+    cluster statistics of each. Also checks that policies which don't suit a table are refused.
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+# include "hash.h"
+
+
+#define TABLE_SIZE 65536 // a power of 2 and a multiple of the bucket group, so every policy applies
+#define ITEM_NVALS 3     // needs to be >= 3
+
+
+
+int main()
+{
+
+    hashtable_t my_table = {NULL};
+
+    uint64_t table_capacity = TABLE_SIZE;
+    uint64_t nvals_per_item = ITEM_NVALS;
+    uint64_t nitems = 9 * table_capacity / 10;
+    uint64_t table_bytes = 2 * sizeof(uint64_t) + table_capacity * (1 + nvals_per_item) * sizeof(uint64_t);
+    uint64_t i, nwrong = 0;
+    uint64_t *vals;
+    probe_stats_t stats;
+    probe_policy_t policy;
+    void * base_ptr = calloc(1, table_bytes);
+
+
+    // testing...
+
+    for(policy = PROBE_LINEAR; policy <= PROBE_BUCKETED; policy++)
+    {
+        uint64_t nbad = 0;
+
+        init_hash_table(&my_table, base_ptr, table_capacity, nvals_per_item);
+        nbad += !set_probe_policy(&my_table, policy);
+
+        for(i = 0; i < nitems; i++)
+        {
+            uint64_t val = i;
+            nbad += (insert_or_assign(&my_table, murmur_hash_64(i, 3), &val) == NULL);
+        }
+
+        for(i = 0; i < nitems; i++)
+        {
+            vals = find_item(&my_table, murmur_hash_64(i, 3));
+            nbad += (vals == NULL || vals[0] != i);
+        }
+
+        for(i = 0; i < nitems; i += 2) nbad += !erase_item(&my_table, murmur_hash_64(i, 3));
+        for(i = 0; i < nitems; i++) nbad += ((find_item(&my_table, murmur_hash_64(i, 3)) != NULL) != (i % 2 == 1));
+
+        for(i = 0; i < nitems; i += 2)
+        {
+            uint64_t val = i;
+            nbad += (insert_or_assign(&my_table, murmur_hash_64(i, 3), &val) == NULL);
+        }
+        for(i = 0; i < nitems; i++) nbad += (find_item(&my_table, murmur_hash_64(i, 3)) == NULL);
+
+        probe_stats(&my_table, &stats);
+        print_probe_stats(&my_table);
+
+        // every item is counted once, and the tombstone count of the table matches its deleted slots
+        nbad += (stats.nitems != nitems || stats.ndeleted != my_table.ntombstones);
+
+        printf(" %s \n",(nbad == 0) ? "ok" : "FAILED");
+        nwrong += nbad;
+
+        free(my_table.items);
+    }
+
+    // the policy can't change under existing items, and quadratic probing needs a power of 2 capacity
+    init_hash_table(&my_table, base_ptr, table_capacity, nvals_per_item);
+    insert_or_assign(&my_table, 1, &nitems);
+    nwrong += set_probe_policy(&my_table, PROBE_DOUBLE_HASH);
+    free(my_table.items);
+
+    init_hash_table(&my_table, base_ptr, table_capacity - 1, nvals_per_item);
+    nwrong += set_probe_policy(&my_table, PROBE_QUADRATIC);
+    free(my_table.items);
+
+    printf("\n %s \n\n",(nwrong == 0) ? "All checks passed." : "Some checks FAILED.");
+
+    free(base_ptr);
+
+	return (nwrong == 0) ? 0 : 1;
+}
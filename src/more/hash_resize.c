@@ -0,0 +1,654 @@
+/*
+    Concurrent growable version of the generic hash table with cooperative resizing.
+
+    Once more than max_load of the current table's slots are taken, the thread that notices allocates a new
+    table and publishes it as ct->next. The new table is sized for the live items (ct->nitems) at no
+    more than half of max_load: if deleted slots make up most of the used ones it has the same capacity
+    and the resize just drops them, otherwise the capacity doubles (or more). From then on the slot array of the old
+    table is migrated in chunks of RESIZE_CHUNK slots, and every thread that operates on the
+    table first claims and migrates one chunk (like the transfer of Java's ConcurrentHashMap), so
+    the migration work is spread over all threads using the table instead of stalling them all.
+    The thread that finishes the last chunk makes the new table current.
+
+    Migrating a slot swaps its status word, under a compare-and-swap, to a forwarding marker:
+    SLOT_MOVED_EMPTY for empty slots (which still terminates probes) and SLOT_MOVED for items
+    (copied into the new table while the slot is held at SLOT_BUSY) and tombstones. Operations
+    that run into a forwarding marker retry on the new table. Before an operation on a key uses
+    the new table it forwards the key's probe sequence in the old table up to and including the
+    empty slot that ends it, so that an item is never live in both tables and a thread still
+    inserting into the old table can't put the key there behind the forwarding thread's back.
+
+    Every slot of the old table that isn't migrated yet may still bring one item into the new table,
+    so inserts into the new table during the migration reserve their slot first and wait while
+    the new table has no room left beyond those. That keeps the migration itself from ever running
+    out of slots, which matters most for a rehash at the same capacity.
+
+    Updates of existing items hold the slot at SLOT_BUSY while writing the values, and lookups wait
+    for busy slots. On top of that every slot has a version (a seqlock in the word in front of its
+    status word, which the generic table leaves unused): an update makes it odd before writing the
+    values and even again after, and a lookup copies the values between two reads of it and copies
+    again if it changed, so multi-word value rows are never seen torn, not even by an update that
+    starts and finishes entirely within a lookup's copy.
+    Tables here are never cleared, so they stay at generation 0 and status words can be compared
+    as they are. Deleted slots are never reused, they are only dropped by the next resize. While
+    the new table is itself over max_load before the migration is done, inserts and updates wait
+    for it.
+
+    Other threads may still be probing a table after it has been replaced, so every operation pins
+    the current and the next table (a count per table, checked again after pinning, as a table
+    that stopped being current in between may be gone already). A table holds a pin on itself until
+    it is replaced, and is released by whoever unpins it last after that; its place in ct->tables
+    is reused RESIZE_MAX_TABLES tables later.
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <assert.h>
+#include <sched.h>
+
+# include "hash.h"
+
+
+enum { OP_LOOKUP, OP_UPSERT, OP_DELETE };
+enum { R_FOUND, R_INSERTED, R_ABSENT, R_FULL, R_RETRY };
+enum { TABLE_LIVE, TABLE_RETIRED, TABLE_RELEASING, TABLE_FREED };
+
+
+
+// version of the values of slot p, odd while an update writes them
+static inline uint64_t *
+slot_version(uint64_t *p)
+{
+    return p - 1;
+}
+
+
+static inline uint64_t
+wait_not_busy(uint64_t *p)
+{
+    uint64_t slot_status = __atomic_load_n(&p[0], __ATOMIC_ACQUIRE);
+
+    while(slot_status == SLOT_BUSY)
+    {
+        cpu_relax();
+        slot_status = __atomic_load_n(&p[0], __ATOMIC_ACQUIRE);
+    }
+
+    return slot_status;
+}
+
+
+static void
+release_table(hashtable_t *table)
+{
+    free(table->items);
+    free(table->capacity);
+    free(table);
+}
+
+
+static hashtable_t *
+alloc_table(conc_table_t *ct, const uint64_t capacity)
+{
+    uint64_t table_bytes = 2 * sizeof(uint64_t) + capacity * (1 + ct->nvals_per_item) * sizeof(uint64_t);
+    uint64_t id = ct->ntables % RESIZE_MAX_TABLES;
+    hashtable_t *table = NULL;
+    void *base_ptr = NULL;
+
+    // the table that had this place before must have been released (unless a thread is stuck on it, it is long gone)
+    if(ct->ntables < RESIZE_MAX_TABLES || __atomic_load_n(&ct->state[id], __ATOMIC_ACQUIRE) == TABLE_FREED)
+    {
+        table = calloc(1, sizeof(hashtable_t));
+        base_ptr = calloc(1, table_bytes);
+    }
+
+    if(table == NULL || base_ptr == NULL)
+    {
+        printf("\n Warning! Unable to allocate a hash table of capacity %lu. \n",capacity);
+        free(table);
+        free(base_ptr);
+        return NULL;
+    }
+
+    init_hash_table(table, base_ptr, capacity, ct->nvals_per_item);
+
+    if(table->items == NULL)
+    {
+        printf("\n Warning! Unable to allocate a hash table of capacity %lu. \n",capacity);
+        free(table);
+        free(base_ptr);
+        return NULL;
+    }
+
+    // users isn't reset, a thread that found the previous table just before it was released may still undo its pin;
+    // the table holds a pin of its own until it is replaced, so users can't drop to 0 before then
+    ct->transfer[id] = 0;
+    ct->nmigrated[id] = 0;
+    ct->nchunks[id] = 0;
+    ct->nused[id] = 0;
+    ct->state[id] = TABLE_LIVE;
+    __atomic_fetch_add(&ct->users[id], 1, __ATOMIC_SEQ_CST);
+
+    // only one thread at a time resizes, but others may be looking the table up in table_id()
+    __atomic_store_n(&ct->tables[id], table, __ATOMIC_RELEASE);
+    __atomic_store_n(&ct->ntables, ct->ntables + 1, __ATOMIC_RELEASE);
+
+    return table;
+}
+
+
+// position of table in ct->tables (and of its migration counters), RESIZE_MAX_TABLES if it has been released
+static inline uint64_t
+table_id(conc_table_t *ct, const hashtable_t *table)
+{
+    uint64_t n = __atomic_load_n(&ct->ntables, __ATOMIC_ACQUIRE);
+    uint64_t t;
+
+    for(t = n; t > 0 && t + RESIZE_MAX_TABLES > n; t--)
+    {
+        if(__atomic_load_n(&ct->tables[(t - 1) % RESIZE_MAX_TABLES], __ATOMIC_ACQUIRE) == table) return (t - 1) % RESIZE_MAX_TABLES;
+    }
+
+    return RESIZE_MAX_TABLES;
+}
+
+
+// keep table from being released, returns its id (RESIZE_MAX_TABLES if it is gone already)
+static inline uint64_t
+pin_table(conc_table_t *ct, const hashtable_t *table)
+{
+    uint64_t id = table_id(ct, table);
+
+    if(id < RESIZE_MAX_TABLES) __atomic_fetch_add(&ct->users[id], 1, __ATOMIC_SEQ_CST);
+
+    return id;
+}
+
+
+// the last thread to unpin a replaced table releases it (a table's own pin goes once it is replaced, so only then)
+static inline void
+unpin_table(conc_table_t *ct, const uint64_t id)
+{
+    uint64_t retired = TABLE_RETIRED;
+
+    if(id == RESIZE_MAX_TABLES) return;
+
+    if(__atomic_sub_fetch(&ct->users[id], 1, __ATOMIC_SEQ_CST) > 0) return;
+
+    if(!__atomic_compare_exchange_n(&ct->state[id], &retired, TABLE_RELEASING, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) return;
+
+    release_table(ct->tables[id]);
+    __atomic_store_n(&ct->state[id], TABLE_FREED, __ATOMIC_RELEASE);
+}
+
+
+// pin the current table and the next one (if any), returns false if they changed in the meantime
+static bool
+pin_tables(conc_table_t *ct, hashtable_t **table, hashtable_t **new, uint64_t *ids)
+{
+    // a consistent (current, next) pair: next didn't change while reading current
+    *new   = __atomic_load_n(&ct->next, __ATOMIC_SEQ_CST);
+    *table = __atomic_load_n(&ct->cur, __ATOMIC_SEQ_CST);
+
+    if(__atomic_load_n(&ct->next, __ATOMIC_SEQ_CST) != *new || *new == *table) return false;
+
+    ids[0] = pin_table(ct, *table);
+    ids[1] = (*new != NULL) ? pin_table(ct, *new) : RESIZE_MAX_TABLES;
+
+    // both still in place after pinning, so neither can have been released before, and the ids pinned are still theirs:
+    // a released table's memory may come back as a newer table with a different id
+    if(ids[0] < RESIZE_MAX_TABLES && (*new == NULL || ids[1] < RESIZE_MAX_TABLES) &&
+       __atomic_load_n(&ct->cur, __ATOMIC_SEQ_CST) == *table && __atomic_load_n(&ct->next, __ATOMIC_SEQ_CST) == *new &&
+       table_id(ct, *table) == ids[0] && (*new == NULL || table_id(ct, *new) == ids[1])) return true;
+
+    unpin_table(ct, ids[0]);
+    unpin_table(ct, ids[1]);
+    return false;
+}
+
+
+static inline bool
+over_load(conc_table_t *ct, const hashtable_t *table, const uint64_t id)
+{
+    return __atomic_load_n(&ct->nused[id], __ATOMIC_RELAXED) > ct->max_load * *(table->capacity);
+}
+
+
+// reserve a slot of new for an insert during the migration from old, returns false if the slots left are all needed by the migration
+static inline bool
+reserve_slot(conc_table_t *ct, const hashtable_t *old, const hashtable_t *new, const uint64_t id)
+{
+    uint64_t capacity = *(old->capacity);
+    uint64_t migrated = __atomic_load_n(&ct->nmigrated[id], __ATOMIC_ACQUIRE) * RESIZE_CHUNK;
+    uint64_t pending = (migrated < capacity) ? capacity - migrated : 0;
+
+    if(__atomic_add_fetch(&ct->nused[id], 1, __ATOMIC_ACQ_REL) + pending <= *(new->capacity)) return true;
+
+    __atomic_fetch_sub(&ct->nused[id], 1, __ATOMIC_RELAXED);
+    return false;
+}
+
+
+bool
+init_conc_table(conc_table_t *ct, const uint64_t table_capacity, const uint64_t nvals_per_item, const double max_load)
+{
+    assert(ct != NULL);
+
+    if(nvals_per_item < 3)
+    {
+        printf("\n Invalid nvals_per_item. Unable to initilize hash table. \n");
+        return false;
+    }
+
+    *ct = (conc_table_t) {.nvals_per_item = nvals_per_item, .max_load = max_load};
+
+    if(max_load <= 0.0 || max_load > 1.0) ct->max_load = 0.75;
+
+    ct->cur = alloc_table(ct, (table_capacity > RESIZE_CHUNK) ? table_capacity : RESIZE_CHUNK);
+
+    return ct->cur != NULL;
+}
+
+
+void
+free_conc_table(conc_table_t *ct)
+{
+    uint64_t t;
+
+    for(t = 0; t < ct->ntables && t < RESIZE_MAX_TABLES; t++)
+    {
+        if(ct->state[t] != TABLE_FREED) release_table(ct->tables[t]);
+    }
+
+    ct->ntables = 0;
+    ct->cur = NULL;
+    ct->next = NULL;
+}
+
+
+
+/*
+    Migration
+*/
+
+// forward one slot of the old table into the new one
+static void
+migrate_slot(conc_table_t *ct, hashtable_t *new, const uint64_t id, uint64_t *p)
+{
+    bool inserted;
+
+    uint64_t slot_status = __atomic_load_n(&p[0], __ATOMIC_ACQUIRE);
+
+    for(;;)
+    {
+        switch(slot_status)
+        {
+            case 0:
+                if(__atomic_compare_exchange_n(&p[0], &slot_status, SLOT_MOVED_EMPTY, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) return;
+                break;
+
+            case 2:
+                if(__atomic_compare_exchange_n(&p[0], &slot_status, SLOT_MOVED, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) return;
+                break;
+
+            case 1:
+                if(__atomic_compare_exchange_n(&p[0], &slot_status, SLOT_BUSY, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+                {
+                    /* a newer value of this key may already be in the new table, then the old one is dropped;
+                       reserve_slot() keeps a slot of new free for every slot of old that isn't migrated yet,
+                       so new can't be full here, but should it be the item stays busy rather than get lost */
+                    while(find_or_insert_atomic(new, p[1], p + 2, &inserted) == NULL) sched_yield();
+                    if(inserted) __atomic_fetch_add(&ct->nused[id], 1, __ATOMIC_RELAXED);
+                    __atomic_store_n(&p[0], SLOT_MOVED, __ATOMIC_RELEASE);
+                    return;
+                }
+                break;
+
+            case SLOT_BUSY:
+                slot_status = wait_not_busy(p);
+                break;
+
+            default: // already forwarded
+                return;
+        }
+    }
+}
+
+
+// start resizing table if it is over max_load (or regardless, if forced), returns false if table
+// is current and not being resized afterwards
+static bool
+start_resize(conc_table_t *ct, hashtable_t *table, const bool force)
+{
+    uint64_t capacity = *(table->capacity);
+    uint64_t new_capacity = capacity;
+    uint64_t expected = 0;
+
+    if(!force && !over_load(ct, table, table_id(ct, table))) return false;
+
+    if(!__atomic_compare_exchange_n(&ct->resizing, &expected, 1, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) return true;
+
+    if(__atomic_load_n(&ct->cur, __ATOMIC_ACQUIRE) != table)
+    {
+        __atomic_store_n(&ct->resizing, 0, __ATOMIC_RELEASE);
+        return true;
+    }
+
+    // the live items fill at most half of max_load, the same capacity if deleted slots took most of the room
+    uint64_t nitems = __atomic_load_n(&ct->nitems, __ATOMIC_RELAXED);
+    while(new_capacity * ct->max_load / 2 < nitems) new_capacity *= 2;
+
+    hashtable_t *new = alloc_table(ct, new_capacity);
+
+    if(new == NULL)
+    {
+        __atomic_store_n(&ct->resizing, 0, __ATOMIC_RELEASE);
+        return false;
+    }
+
+    // the migration counters have to be in place before other threads can see the new table
+    uint64_t id = table_id(ct, new);
+    __atomic_store_n(&ct->nchunks[id], (capacity + RESIZE_CHUNK - 1) / RESIZE_CHUNK, __ATOMIC_RELAXED);
+    __atomic_store_n(&ct->next, new, __ATOMIC_RELEASE);
+
+    // resizing stays set until finish_resize()
+    return true;
+}
+
+
+// the last chunk is done, make the new table current (the caller has old pinned, it is released once unpinned by everyone)
+static void
+finish_resize(conc_table_t *ct, hashtable_t *old, hashtable_t *new)
+{
+    // next is cleared first: a thread that sees no next but the old table still current just runs into forwarding markers and retries
+    __atomic_store_n(&ct->next, NULL, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&ct->cur, new, __ATOMIC_SEQ_CST);
+
+    // drop the pin old held on itself, the caller's pin keeps it around until the caller is done
+    uint64_t id = table_id(ct, old);
+    __atomic_store_n(&ct->state[id], TABLE_RETIRED, __ATOMIC_SEQ_CST);
+    unpin_table(ct, id);
+    __atomic_store_n(&ct->resizing, 0, __ATOMIC_RELEASE);
+
+    // inserts into new during the migration could not start the next resize
+    start_resize(ct, new, false);
+}
+
+
+// claim and migrate one chunk of the old table, returns false if there was none left to claim
+static bool
+help_migrate(conc_table_t *ct, hashtable_t *old, hashtable_t *new)
+{
+    uint64_t id = table_id(ct, new);
+    uint64_t nchunks = __atomic_load_n(&ct->nchunks[id], __ATOMIC_ACQUIRE);
+    uint64_t capacity = *(old->capacity);
+    uint64_t chunk, i;
+
+    // don't bump the claim counter past the end, it is read by every operation during the resize
+    if(__atomic_load_n(&ct->transfer[id], __ATOMIC_RELAXED) >= nchunks) return false;
+
+    chunk = __atomic_fetch_add(&ct->transfer[id], 1, __ATOMIC_ACQ_REL);
+
+    if(chunk >= nchunks) return false;
+
+    for(i = chunk * RESIZE_CHUNK; i < (chunk + 1) * RESIZE_CHUNK && i < capacity; i++)
+    {
+        migrate_slot(ct, new, id, slot_item(old, i));
+    }
+
+    if(__atomic_add_fetch(&ct->nmigrated[id], 1, __ATOMIC_ACQ_REL) == nchunks) finish_resize(ct, old, new);
+
+    return true;
+}
+
+
+// migrate all remaining chunks (e.g. from a background helper thread)
+void
+conc_help_resize(conc_table_t *ct)
+{
+    hashtable_t *old, *new;
+    uint64_t ids[2];
+
+    while(!pin_tables(ct, &old, &new, ids));
+
+    if(new != NULL) while(help_migrate(ct, old, new));
+
+    unpin_table(ct, ids[0]);
+    unpin_table(ct, ids[1]);
+}
+
+
+
+/*
+    Operations
+*/
+
+// make sure key is not live in the old table anymore (migrate its slot if it is)
+static void
+forward_key(conc_table_t *ct, hashtable_t *old, hashtable_t *new, const uint64_t id, const uint64_t key)
+{
+    uint64_t capacity = *(old->capacity);
+    uint64_t index = hash(key, capacity);
+    uint64_t step = probe_step(old, key);
+    uint64_t i, slot_status, *p;
+
+    for(i = 0; i < capacity; i++)
+    {
+        p = slot_item(old, probe_slot(old, index, step, i));
+
+        slot_status = wait_not_busy(p);
+
+        if(slot_status == SLOT_MOVED_EMPTY) return;
+
+        // seal the end of the probe sequence, an insert of key that lost the race gets R_RETRY
+        if(slot_status == 0)
+        {
+            migrate_slot(ct, new, id, p);
+            if(__atomic_load_n(&p[0], __ATOMIC_ACQUIRE) == SLOT_MOVED_EMPTY) return;
+            continue; // someone inserted here first, it has been migrated too
+        }
+
+        if(slot_status == 1 && p[1] == key)
+        {
+            migrate_slot(ct, new, id, p);
+            return;
+        }
+    }
+}
+
+
+// one operation on a single table, returns R_RETRY if it ran into a forwarding marker
+static int
+table_op(hashtable_t *table, const int op, const uint64_t key, const uint64_t *in, uint64_t *out)
+{
+    uint64_t capacity = *(table->capacity);
+    uint64_t nvals = table->nvals;
+    uint64_t index = hash(key, capacity);
+    uint64_t step = probe_step(table, key);
+    uint64_t i, j, slot_status, *p;
+
+    for(i = 0; i < capacity; i++)
+    {
+        p = slot_item(table, probe_slot(table, index, step, i));
+
+        slot_status = __atomic_load_n(&p[0], __ATOMIC_ACQUIRE);
+
+    retry_slot:
+        switch(slot_status)
+        {
+            case 0:
+                if(op != OP_UPSERT) return R_ABSENT;
+
+                if(!__atomic_compare_exchange_n(&p[0], &slot_status, SLOT_BUSY, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) goto retry_slot;
+
+                p[1] = key;
+                for(j = 0; j < nvals; j++) p[2 + j] = in[j];
+                __atomic_store_n(&p[0], 1, __ATOMIC_RELEASE);
+                return R_INSERTED;
+
+            case SLOT_BUSY:
+                slot_status = wait_not_busy(p);
+                goto retry_slot;
+
+            case SLOT_MOVED_EMPTY:
+            case SLOT_MOVED:
+                return R_RETRY;
+
+            case 2:
+                continue;
+        }
+
+        // occupied, keys never change once published
+        if(p[1] != key) continue;
+
+        if(op == OP_LOOKUP)
+        {
+            uint64_t version = __atomic_load_n(slot_version(p), __ATOMIC_ACQUIRE);
+
+            if(version % 2 == 0)
+            {
+                for(j = 0; j < nvals; j++) out[j] = __atomic_load_n(&p[2 + j], __ATOMIC_RELAXED);
+                __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+                if(__atomic_load_n(slot_version(p), __ATOMIC_RELAXED) == version) return R_FOUND;
+            }
+
+            // an update got in while copying
+            slot_status = wait_not_busy(p);
+            goto retry_slot;
+        }
+
+        if(op == OP_DELETE)
+        {
+            if(!__atomic_compare_exchange_n(&p[0], &slot_status, 2, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) goto retry_slot;
+            return R_FOUND;
+        }
+
+        if(!__atomic_compare_exchange_n(&p[0], &slot_status, SLOT_BUSY, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) goto retry_slot;
+
+        // only the thread holding the slot busy writes the version
+        uint64_t version = *slot_version(p);
+
+        __atomic_store_n(slot_version(p), version + 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        for(j = 0; j < nvals; j++) __atomic_store_n(&p[2 + j], in[j], __ATOMIC_RELAXED);
+        __atomic_store_n(slot_version(p), version + 2, __ATOMIC_RELEASE);
+        __atomic_store_n(&p[0], 1, __ATOMIC_RELEASE);
+        return R_FOUND;
+    }
+
+    return (op == OP_UPSERT) ? R_FULL : R_ABSENT;
+}
+
+
+static int
+conc_op(conc_table_t *ct, const int op, const uint64_t key, const uint64_t *in, uint64_t *out)
+{
+    hashtable_t *table, *new;
+    uint64_t id = 0, ids[2] = {RESIZE_MAX_TABLES, RESIZE_MAX_TABLES};
+    bool reserved;
+    int r;
+
+    for(;;)
+    {
+        reserved = false;
+
+        // the tables of the previous pass
+        unpin_table(ct, ids[0]);
+        unpin_table(ct, ids[1]);
+
+        if(!pin_tables(ct, &table, &new, ids))
+        {
+            ids[0] = ids[1] = RESIZE_MAX_TABLES;
+            continue;
+        }
+
+        if(new != NULL)
+        {
+            id = ids[1];
+            help_migrate(ct, table, new);
+
+            // the new table filled up faster than the old one got migrated, let the migration catch up
+            if(op == OP_UPSERT)
+            {
+                if(over_load(ct, new, id) || !reserve_slot(ct, table, new, id))
+                {
+                    sched_yield();
+                    continue;
+                }
+                reserved = true;
+            }
+
+            forward_key(ct, table, new, id, key);
+            table = new;
+        }
+        else
+        {
+            id = ids[0];
+        }
+
+        r = table_op(table, op, key, in, out);
+
+        // an update or a retry doesn't take the reserved slot
+        if(reserved && r != R_INSERTED) __atomic_fetch_sub(&ct->nused[id], 1, __ATOMIC_RELAXED);
+
+        if(r == R_RETRY)
+        {
+            cpu_relax();
+            continue;
+        }
+
+        // ran out of room before a resize got going (e.g. the resizing thread isn't running), wait for it
+        if(r == R_FULL && start_resize(ct, table, true))
+        {
+            sched_yield();
+            continue;
+        }
+
+        break;
+    }
+
+    if(r == R_INSERTED)
+    {
+        if(!reserved) __atomic_fetch_add(&ct->nused[id], 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&ct->nitems, 1, __ATOMIC_RELAXED);
+        start_resize(ct, table, false);
+    }
+
+    if(r == R_FOUND && op == OP_DELETE) __atomic_fetch_sub(&ct->nitems, 1, __ATOMIC_RELAXED);
+
+    unpin_table(ct, ids[0]);
+    unpin_table(ct, ids[1]);
+
+    return r;
+}
+
+
+// insert a new item or overwrite the values of the existing one
+bool
+conc_insert(conc_table_t *ct, const uint64_t key, const uint64_t *values)
+{
+    int r = conc_op(ct, OP_UPSERT, key, values, NULL);
+
+    if(r == R_FULL) printf("\n Warning! Unable to insert new item with key: %lu. Ran out of empty slots. \n",key);
+
+    return r == R_FOUND || r == R_INSERTED;
+}
+
+
+// copy the values of the item with given key into values, returns false if it's not in the table
+bool
+conc_lookup(conc_table_t *ct, const uint64_t key, uint64_t *values)
+{
+    return conc_op(ct, OP_LOOKUP, key, NULL, values) == R_FOUND;
+}
+
+
+bool
+conc_delete(conc_table_t *ct, const uint64_t key)
+{
+    return conc_op(ct, OP_DELETE, key, NULL, NULL) == R_FOUND;
+}
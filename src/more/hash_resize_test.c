@@ -0,0 +1,245 @@
+/*
+    Test driver for the concurrent table with cooperative resizing. Every thread owns its own
+    keys and keeps track of which of them are in the table, so every lookup, insert and delete
+    can be checked on the spot while other threads keep the table resizing underneath:
+
+    grow    threads insert their keys from a small initial capacity, deleting some and
+            overwriting others along the way, and look up earlier keys as they go
+    churn   threads insert new keys and delete their oldest ones, so the number of live items
+            stays put while deleted slots pile up: resizes have to drop them at the same
+            capacity instead of doubling the table again and again
+    torn    half the threads keep overwriting a few keys with wide rows of one repeated value,
+            the other half keep looking them up: every row read has to hold a single value
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <pthread.h>
+
+# include "hash.h"
+
+
+#define TABLE_SIZE   1024  // initial capacity
+#define ITEM_NVALS   4     // needs to be >= 3
+#define NTHREADS     8
+#define NKEYS        50000 // keys of every thread in the grow phase
+#define CHURN_WINDOW 2000  // live keys of every thread in the churn phase
+#define CHURN_ROUNDS 100000
+#define TORN_NVALS   66    // value rows of 64 words, so an update fits into the copy of a lookup
+#define TORN_KEYS    4
+#define TORN_ROUNDS  200000
+
+
+
+conc_table_t ct, torn_ct;
+uint64_t nwrong_ops = 0;
+
+
+static inline uint64_t
+thread_key(const long id, const uint64_t k)
+{
+    return k * NTHREADS + id + 1;
+}
+
+
+static void
+check_lookup(const uint64_t key, const bool present, const uint64_t value)
+{
+    uint64_t values[ITEM_NVALS - 2];
+    bool found = conc_lookup(&ct, key, values);
+
+    if(found != present || (found && (values[0] != value || values[1] != ~value))) __atomic_fetch_add(&nwrong_ops, 1, __ATOMIC_RELAXED);
+}
+
+
+static void
+put(const uint64_t key, const uint64_t value)
+{
+    uint64_t values[ITEM_NVALS - 2] = {value, ~value};
+
+    if(!conc_insert(&ct, key, values)) __atomic_fetch_add(&nwrong_ops, 1, __ATOMIC_RELAXED);
+}
+
+
+static void *
+grow_thread(void *arg)
+{
+    long id = (long) arg;
+    uint64_t k;
+
+    for(k = 0; k < NKEYS; k++)
+    {
+        uint64_t key = thread_key(id, k);
+
+        put(key, key);
+        check_lookup(key, true, key);
+
+        if(k % 7 == 0)
+        {
+            if(!conc_delete(&ct, key)) __atomic_fetch_add(&nwrong_ops, 1, __ATOMIC_RELAXED);
+            check_lookup(key, false, 0);
+        }
+        else if(k % 11 == 0)
+        {
+            put(key, 2 * key);
+            check_lookup(key, true, 2 * key);
+        }
+
+        // an earlier key, possibly migrated by now
+        if(k >= 100)
+        {
+            uint64_t old = k - 100, old_key = thread_key(id, old);
+            check_lookup(old_key, old % 7 != 0, (old % 11 == 0) ? 2 * old_key : old_key);
+        }
+    }
+
+    return NULL;
+}
+
+
+static void *
+churn_thread(void *arg)
+{
+    long id = (long) arg;
+    uint64_t k, base = NKEYS; // beyond the keys of the grow phase
+
+    for(k = base; k < base + CHURN_WINDOW; k++) put(thread_key(id, k), k);
+
+    for(k = base + CHURN_WINDOW; k < base + CHURN_WINDOW + CHURN_ROUNDS; k++)
+    {
+        uint64_t oldest = k - CHURN_WINDOW;
+
+        put(thread_key(id, k), k);
+        if(!conc_delete(&ct, thread_key(id, oldest))) __atomic_fetch_add(&nwrong_ops, 1, __ATOMIC_RELAXED);
+
+        check_lookup(thread_key(id, oldest), false, 0);
+        check_lookup(thread_key(id, k - CHURN_WINDOW / 2), true, k - CHURN_WINDOW / 2);
+    }
+
+    return NULL;
+}
+
+
+static void *
+torn_thread(void *arg)
+{
+    long id = (long) arg;
+    uint64_t values[TORN_NVALS - 2];
+    uint64_t k, j;
+
+    for(k = 0; k < TORN_ROUNDS; k++)
+    {
+        uint64_t key = k % TORN_KEYS + 1;
+
+        if(id % 2 == 0)
+        {
+            for(j = 0; j < TORN_NVALS - 2; j++) values[j] = k * NTHREADS + id;
+            if(!conc_insert(&torn_ct, key, values)) __atomic_fetch_add(&nwrong_ops, 1, __ATOMIC_RELAXED);
+            continue;
+        }
+
+        if(!conc_lookup(&torn_ct, key, values))
+        {
+            __atomic_fetch_add(&nwrong_ops, 1, __ATOMIC_RELAXED);
+            continue;
+        }
+
+        for(j = 1; j < TORN_NVALS - 2; j++)
+        {
+            if(values[j] != values[0])
+            {
+                __atomic_fetch_add(&nwrong_ops, 1, __ATOMIC_RELAXED);
+                break;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+
+static void
+run_threads(void *(*fn)(void *))
+{
+    pthread_t threads[NTHREADS];
+    long t;
+
+    for(t = 0; t < NTHREADS; t++) pthread_create(&threads[t], NULL, fn, (void *) t);
+    for(t = 0; t < NTHREADS; t++) pthread_join(threads[t], NULL);
+
+    conc_help_resize(&ct);
+}
+
+
+
+int main()
+{
+
+    uint64_t k, nwrong = 0;
+    long t;
+
+    init_conc_table(&ct, TABLE_SIZE, ITEM_NVALS, 0.75);
+
+
+    // testing...
+
+    run_threads(grow_thread);
+
+    uint64_t expected = 0;
+    for(t = 0; t < NTHREADS; t++)
+    {
+        for(k = 0; k < NKEYS; k++)
+        {
+            uint64_t key = thread_key(t, k);
+            check_lookup(key, k % 7 != 0, (k % 11 == 0) ? 2 * key : key);
+            expected += (k % 7 != 0);
+        }
+    }
+    nwrong += nwrong_ops;
+
+    printf("\n Grow: %lu items (expected %lu), capacity %lu, %lu tables, %lu wrong operations \n",ct.nitems,expected,*(ct.cur->capacity),ct.ntables,nwrong_ops);
+    nwrong += (ct.nitems != expected);
+
+    // the grow phase keys go, so the churn phase starts out with deleted slots only
+    for(t = 0; t < NTHREADS; t++)
+    {
+        for(k = 0; k < NKEYS; k++) if(k % 7 != 0) conc_delete(&ct, thread_key(t, k));
+    }
+
+    uint64_t capacity = *(ct.cur->capacity), ntables = ct.ntables;
+    nwrong_ops = 0;
+    run_threads(churn_thread);
+
+    printf("\n Churn: %lu items (expected %u), capacity %lu -> %lu, %lu resizes, %lu wrong operations \n",ct.nitems,NTHREADS * CHURN_WINDOW,capacity,*(ct.cur->capacity),ct.ntables - ntables,nwrong_ops);
+    nwrong += (ct.nitems != NTHREADS * CHURN_WINDOW);
+    nwrong += (ct.ntables == ntables || *(ct.cur->capacity) > capacity);
+
+    for(t = 0; t < NTHREADS; t++)
+    {
+        for(k = NKEYS + CHURN_ROUNDS; k < NKEYS + CHURN_ROUNDS + CHURN_WINDOW; k++) check_lookup(thread_key(t, k), true, k);
+    }
+    nwrong += nwrong_ops;
+
+    // rows wider than a cache line, updated and read concurrently
+    uint64_t values[TORN_NVALS - 2] = {0};
+
+    init_conc_table(&torn_ct, TABLE_SIZE, TORN_NVALS, 0.75);
+    for(k = 1; k <= TORN_KEYS; k++) conc_insert(&torn_ct, k, values);
+
+    nwrong_ops = 0;
+    run_threads(torn_thread);
+
+    printf("\n Torn: %i rounds of %i writers and %i readers on %i keys of %i values, %lu wrong operations \n",
+           TORN_ROUNDS,NTHREADS / 2,NTHREADS / 2,TORN_KEYS,TORN_NVALS - 2,nwrong_ops);
+    nwrong += nwrong_ops;
+
+    printf("\n %s \n\n",(nwrong == 0) ? "All checks passed." : "Some checks FAILED.");
+
+    free_conc_table(&ct);
+    free_conc_table(&torn_ct);
+
+	return (nwrong == 0) ? 0 : 1;
+}
@@ -0,0 +1,202 @@
+/*
+    Iteration over the occupied slots of the generic hash table.
+
+    The cursor walks the slot array front to back (so the hardware prefetcher sees a pure
+    sequential stream), skips empty and deleted slots by their status word and additionally
+    prefetches SCAN_PREFETCH_SLOTS ahead. scan_table_parallel() cuts the slot array into chunks
+    of SCAN_CHUNK slots, hands every thread a contiguous run of chunks and lets threads that
+    finish early steal the remaining chunks of the others.
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <assert.h>
+#include <pthread.h>
+
+# include "hash.h"
+
+
+#define SCAN_PREFETCH_SLOTS 16   // how far ahead of the cursor to prefetch
+#define SCAN_CHUNK          4096 // slots per unit of work in the parallel scan
+#define SCAN_MAX_THREADS    256
+
+
+
+void
+init_cursor_range(hash_cursor_t *cursor, const hashtable_t *table, const uint64_t begin, const uint64_t end, item_filter_t filter, void *arg)
+{
+    assert(cursor != NULL && table != NULL);
+
+    uint64_t capacity = *(table->capacity);
+
+    cursor->table  = table;
+    cursor->next   = (begin < capacity) ? begin : capacity;
+    cursor->end    = (end < capacity) ? end : capacity;
+    cursor->filter = filter;
+    cursor->arg    = arg;
+    cursor->now    = (table->expiry != NULL) ? hash_time_now() : 0;
+}
+
+
+void
+init_cursor(hash_cursor_t *cursor, const hashtable_t *table, item_filter_t filter, void *arg)
+{
+    init_cursor_range(cursor, table, 0, *(table->capacity), filter, arg);
+}
+
+
+// advance the cursor to the next occupied slot (that passes the filter), returns NULL once the range is exhausted
+uint64_t *
+next_item(hash_cursor_t *cursor)
+{
+    void *base_ptr = cursor->table->capacity;
+    uint64_t nvals_per_item = *(cursor->table->nvals_per_item);
+    uint64_t size_of_item = (1 + nvals_per_item) * sizeof(uint64_t);
+    uint64_t *p;
+
+    while(cursor->next < cursor->end)
+    {
+        uint64_t i = cursor->next++;
+
+        if(i + SCAN_PREFETCH_SLOTS < cursor->end)
+        {
+            __builtin_prefetch(base_ptr + 3*sizeof(uint64_t) + (i + SCAN_PREFETCH_SLOTS)*size_of_item, 0, 0);
+        }
+
+        p = base_ptr + 3*sizeof(uint64_t) + i*size_of_item;
+
+        if(slot_state(cursor->table, p) != 1) continue;
+
+        if(cursor->table->expiry != NULL && item_expired(cursor->table, p, i, cursor->now)) continue;
+
+        if(cursor->filter != NULL && !cursor->filter(p[1], p + 2, cursor->arg)) continue;
+
+        return p;
+    }
+
+    return NULL;
+}
+
+
+
+/*
+    Parallel scan. Every worker owns the chunk range [next, last) and claims chunks from the front
+    of it with an atomic fetch-add on its own counter. Once its own range is used up it goes round
+    the other workers and claims from their counters the same way, so every chunk is handed out
+    exactly once no matter who takes it.
+*/
+
+typedef struct
+{
+    uint64_t next;  // next chunk to claim (atomic)
+    uint64_t last;  // one past the last chunk of this worker's range
+    char pad[48];   // keep each worker's counter on its own cache line
+
+} scan_queue_t;
+
+
+typedef struct
+{
+    const hashtable_t * table;
+    scan_queue_t * queues;
+    int nthreads;
+    int id;
+    item_filter_t filter;
+    item_visit_t visit;
+    void * arg;
+    uint64_t nvisited;
+
+} scan_worker_t;
+
+
+static bool
+claim_chunk(scan_queue_t *queue, uint64_t *chunk)
+{
+    if(__atomic_load_n(&queue->next, __ATOMIC_RELAXED) >= queue->last) return false;
+
+    *chunk = __atomic_fetch_add(&queue->next, 1, __ATOMIC_RELAXED);
+
+    return *chunk < queue->last;
+}
+
+
+static void *
+scan_worker(void *ptr)
+{
+    scan_worker_t *w = ptr;
+    hash_cursor_t cursor;
+    uint64_t chunk, *p;
+    int k;
+
+    for(k = 0; k < w->nthreads; k++)
+    {
+        // own queue first, then steal round-robin from the others
+        scan_queue_t *queue = &w->queues[(w->id + k) % w->nthreads];
+
+        while(claim_chunk(queue, &chunk))
+        {
+            init_cursor_range(&cursor, w->table, chunk*SCAN_CHUNK, (chunk + 1)*SCAN_CHUNK, w->filter, w->arg);
+
+            while((p = next_item(&cursor)) != NULL)
+            {
+                if(w->visit != NULL) w->visit(p[1], p + 2, w->arg);
+                w->nvisited++;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+
+// visit every occupied slot (that passes the filter) using nthreads threads, returns the number of items visited
+uint64_t
+scan_table_parallel(const hashtable_t *table, const int nthreads, item_filter_t filter, item_visit_t visit, void *arg)
+{
+    assert(table != NULL);
+
+    uint64_t capacity = *(table->capacity);
+    uint64_t nchunks = (capacity + SCAN_CHUNK - 1) / SCAN_CHUNK;
+    uint64_t nvisited = 0;
+    int t, n = nthreads;
+
+    if(n < 1) n = 1;
+    if(n > SCAN_MAX_THREADS) n = SCAN_MAX_THREADS;
+    if((uint64_t) n > nchunks) n = (nchunks > 0) ? nchunks : 1;
+
+    scan_queue_t queues[n];
+    scan_worker_t workers[n];
+    pthread_t threads[n];
+    bool started[n];
+
+    for(t = 0; t < n; t++)
+    {
+        queues[t].next = nchunks * t / n;
+        queues[t].last = nchunks * (t + 1) / n;
+
+        workers[t] = (scan_worker_t) {.table = table, .queues = queues, .nthreads = n, .id = t,
+                                      .filter = filter, .visit = visit, .arg = arg, .nvisited = 0};
+    }
+
+    // calling thread works as worker 0
+    for(t = 1; t < n; t++)
+    {
+        started[t] = (pthread_create(&threads[t], NULL, scan_worker, &workers[t]) == 0);
+        
+        if(!started[t]) printf("\n Warning! Unable to start scan thread %i, its chunks will be stolen. \n",t);
+    }
+
+    scan_worker(&workers[0]);
+
+    for(t = 1; t < n; t++)
+    {
+        if(started[t]) pthread_join(threads[t], NULL);
+    }
+
+    for(t = 0; t < n; t++) nvisited += workers[t].nvisited;
+
+    return nvisited;
+}
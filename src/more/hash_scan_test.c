@@ -0,0 +1,111 @@
+/*
+    Test driver for cursor iteration and the parallel scan: fill a table, delete some items,
+    then count and sum the items with a plain cursor, a filtered cursor, cursors over ranges
+    and scan_table_parallel() with several thread counts.
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+# include "hash.h"
+
+
+#define TABLE_SIZE 100000
+#define ITEM_NVALS 3 // needs to be >= 3
+
+
+
+static bool
+is_even(const uint64_t key, const uint64_t *values, void *arg)
+{
+    (void) values;
+    (void) arg;
+
+    return key % 2 == 0;
+}
+
+static void
+add_value(const uint64_t key, uint64_t *values, void *arg)
+{
+    (void) key;
+
+    __atomic_fetch_add((uint64_t *) arg, values[0], __ATOMIC_RELAXED);
+}
+
+
+
+int main()
+{
+
+    hashtable_t my_table = {NULL};
+
+    uint64_t table_capacity = TABLE_SIZE;
+    uint64_t nvals_per_item = ITEM_NVALS;
+    uint64_t nitems = 3 * table_capacity / 4;
+    uint64_t i, n, sum, expected_sum = 0, expected_even = 0, nwrong = 0;
+    uint64_t *p;
+    int nthreads[] = {1, 2, 4, 64};
+    hash_cursor_t cursor;
+    void * base_ptr = calloc(1, 2 * sizeof(uint64_t) + table_capacity * (1 + nvals_per_item) * sizeof(uint64_t));
+
+    init_hash_table(&my_table, base_ptr, table_capacity, nvals_per_item);
+
+
+    // testing...
+
+    for(i = 1; i <= nitems; i++)
+    {
+        uint64_t val = i;
+        insert_or_assign(&my_table, i, &val);
+    }
+
+    // every third item goes, leaving tombstones for the cursors to skip
+    for(i = 3; i <= nitems; i += 3) erase_item(&my_table, i);
+
+    for(i = 1; i <= nitems; i++)
+    {
+        if(i % 3 == 0) continue;
+        expected_sum += i;
+        expected_even += (i % 2 == 0);
+    }
+    uint64_t expected = nitems - nitems / 3;
+
+    for(n = 0, sum = 0, init_cursor(&cursor, &my_table, NULL, NULL); (p = next_item(&cursor)) != NULL; n++) sum += p[2];
+    printf("\n Cursor: %lu items (expected %lu), sum %lu (expected %lu) \n",n,expected,sum,expected_sum);
+    nwrong += (n != expected || sum != expected_sum);
+
+    for(n = 0, init_cursor(&cursor, &my_table, is_even, NULL); (p = next_item(&cursor)) != NULL; n++) nwrong += (p[1] % 2 != 0);
+    printf("\n Filtered cursor: %lu even keys (expected %lu) \n",n,expected_even);
+    nwrong += (n != expected_even);
+
+    // ranges that together cover the table
+    for(n = 0, i = 0; i < table_capacity; i += 7777)
+    {
+        for(init_cursor_range(&cursor, &my_table, i, i + 7777, NULL, NULL); next_item(&cursor) != NULL; n++);
+    }
+    printf("\n Cursors over ranges: %lu items \n",n);
+    nwrong += (n != expected);
+
+    for(i = 0; i < sizeof(nthreads) / sizeof(nthreads[0]); i++)
+    {
+        sum = 0;
+        n = scan_table_parallel(&my_table, nthreads[i], NULL, add_value, &sum);
+        printf("\n Parallel scan, %i threads: %lu items, sum %lu \n",nthreads[i],n,sum);
+        nwrong += (n != expected || sum != expected_sum);
+    }
+
+    sum = 0;
+    n = scan_table_parallel(&my_table, 4, is_even, add_value, &sum);
+    printf("\n Filtered parallel scan: %lu items \n",n);
+    nwrong += (n != expected_even);
+
+    printf("\n %s \n\n",(nwrong == 0) ? "All checks passed." : "Some checks FAILED.");
+
+    free(my_table.items);
+    free(base_ptr);
+
+	return (nwrong == 0) ? 0 : 1;
+}
@@ -0,0 +1,646 @@
+/*
+    Key-value server over the concurrent table (hash_resize.c), speaking the memcached text
+    protocol on localhost, so several processes can share one table.
+
+        hash_server [-p port] [-t nthreads] [-c capacity] [-s max_item_bytes]
+
+    Every thread runs its own epoll event loop on its own listening socket, all bound to the same
+    port with SO_REUSEPORT, so the kernel spreads the connections over the threads and a
+    connection stays on one thread. All threads share one table, which grows as needed.
+
+    Commands: get <key>* (gets is the same), set <key> <flags> <exptime> <bytes> [noreply],
+    delete <key> [noreply], version, quit. exptime is accepted but ignored (items don't expire),
+    other commands get ERROR.
+
+    Requests are parsed in place in the receive buffer (no copies of lines or keys), and every
+    read handles all the complete requests it got, so pipelined requests are answered with one
+    write. Responses queue up in a per-connection output buffer; while it can't be sent, reading
+    from that connection stops.
+
+    Keys are byte strings of up to 250 bytes, hashed to the 64-bit table key. The item's value
+    row holds [flags | key length | value length][checksum][key bytes, value bytes], with room
+    for max_item_bytes (at most SERVER_MAX_ITEM) of key and value. Gets compare the stored key, so a collision of the
+    64-bit hashes reads as a miss rather than the other key's value (a set of one such key does
+    replace the other though), and they check the checksum and read again if a concurrent set
+    got in the way of the copy.
+*/
+
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+# include "hash.h"
+
+
+#define SERVER_MAX_THREADS  256
+#define SERVER_MAX_EVENTS   256
+#define SERVER_MAX_KEY      250          // memcached's key length limit
+#define SERVER_MAX_ITEM     ((1UL << 24) - 1) // largest max_item_bytes, the value length field of a row is 24 bits
+#define SERVER_MAX_LINE     2048         // longest command line
+#define SERVER_BUF_BYTES    65536        // initial receive and send buffer size
+#define SERVER_OUT_LIMIT    (1UL << 20)  // stop reading from a connection while this much output is queued
+#define SERVER_MAX_TOKENS   24
+#define SERVER_READ_RETRIES 8            // reads of an item whose checksum doesn't match before it counts as a miss
+#define SERVER_VERSION      "1.0"
+
+
+
+typedef struct
+{
+    int fd;
+    char * in;                 // receive buffer, in_len bytes of unprocessed input
+    uint64_t in_len, in_cap;
+    char * out;                // send buffer, out_sent of out_len bytes sent
+    uint64_t out_len, out_cap, out_sent;
+    bool closing;              // close once the output is sent
+
+} conn_t;
+
+
+typedef struct
+{
+    const char * p;
+    uint64_t len;
+
+} token_t;
+
+
+typedef struct
+{
+    int id;
+    int port;
+    conc_table_t * table;
+    uint64_t max_item_bytes;
+
+    uint64_t nconns, ngets, nhits, nsets, ndeletes;
+
+} server_thread_t;
+
+
+static volatile sig_atomic_t stop = 0;
+
+
+static void
+on_signal(int sig)
+{
+    (void) sig;
+    stop = 1;
+}
+
+
+// 64-bit table key of a key string
+static uint64_t
+key_hash(const char *key, const uint64_t len)
+{
+    uint64_t h = len, w, i;
+
+    for(i = 0; i + 8 <= len; i += 8)
+    {
+        memcpy(&w, key + i, 8);
+        h = murmur_hash_64(w ^ h, i);
+    }
+
+    w = 0;
+    memcpy(&w, key + i, len - i);
+
+    return murmur_hash_64(w ^ h, len);
+}
+
+
+// checksum of a value row (without the checksum word itself)
+static uint64_t
+row_check(const uint64_t *row)
+{
+    uint64_t nbytes = ((row[0] >> 32) & 0xff) + (row[0] >> 40);
+    uint64_t nwords = (nbytes + 7) / 8, h = murmur_hash_64(row[0], 1), i;
+
+    for(i = 0; i < nwords; i++) h = murmur_hash_64(row[2 + i] ^ h, 1);
+
+    return h;
+}
+
+
+static bool
+reserve(char **buf, uint64_t *cap, const uint64_t need)
+{
+    if(need <= *cap) return true;
+
+    uint64_t new_cap = *cap;
+    while(new_cap < need) new_cap *= 2;
+
+    char *p = realloc(*buf, new_cap);
+    if(p == NULL) return false;
+
+    *buf = p;
+    *cap = new_cap;
+    return true;
+}
+
+
+static void
+append(conn_t *c, const char *s, const uint64_t len)
+{
+    if(!reserve(&c->out, &c->out_cap, c->out_len + len))
+    {
+        c->closing = true;
+        return;
+    }
+    memcpy(c->out + c->out_len, s, len);
+    c->out_len += len;
+}
+
+
+#define APPEND_STR(c, s) append(c, s, sizeof(s) - 1)
+
+
+static inline bool
+token_is(const token_t *t, const char *s)
+{
+    return t->len == strlen(s) && memcmp(t->p, s, t->len) == 0;
+}
+
+
+static bool
+token_u64(const token_t *t, uint64_t *value)
+{
+    uint64_t v = 0, i;
+
+    if(t->len == 0 || t->len > 19) return false;
+
+    for(i = 0; i < t->len; i++)
+    {
+        if(t->p[i] < '0' || t->p[i] > '9') return false;
+        v = 10 * v + (uint64_t) (t->p[i] - '0');
+    }
+
+    *value = v;
+    return true;
+}
+
+
+static void
+do_get(server_thread_t *st, conn_t *c, const token_t *key)
+{
+    uint64_t nvals = st->table->nvals_per_item - 2;
+    uint64_t row[nvals];
+    uint64_t h = key_hash(key->p, key->len);
+    int r;
+
+    st->ngets++;
+
+    for(r = 0; r < SERVER_READ_RETRIES; r++)
+    {
+        if(!conc_lookup(st->table, h, row)) return;
+
+        uint64_t klen = (row[0] >> 32) & 0xff, vlen = row[0] >> 40;
+
+        if(klen + vlen > st->max_item_bytes || row[1] != row_check(row)) continue; // torn by a concurrent set, read again
+
+        const char *data = (const char *) (row + 2);
+
+        if(klen != key->len || memcmp(data, key->p, klen) != 0) return; // another key with the same hash
+
+        char line[SERVER_MAX_KEY + 64];
+        int n = snprintf(line, sizeof(line), "VALUE %.*s %u %lu\r\n",(int) klen,data,(uint32_t) row[0],vlen);
+
+        append(c, line, n);
+        append(c, data + klen, vlen);
+        APPEND_STR(c, "\r\n");
+        st->nhits++;
+        return;
+    }
+}
+
+
+/*
+    Handle the request at the start of the input, returns the number of bytes it took up, or 0
+    if it isn't complete yet.
+*/
+static uint64_t
+handle_request(server_thread_t *st, conn_t *c, const char *p, const uint64_t len)
+{
+    const char *nl = memchr(p, '\n', len);
+    token_t tokens[SERVER_MAX_TOKENS];
+    int ntokens = 0;
+
+    if(nl == NULL)
+    {
+        if(len > SERVER_MAX_LINE)
+        {
+            APPEND_STR(c, "CLIENT_ERROR line too long\r\n");
+            c->closing = true;
+            return len;
+        }
+        return 0;
+    }
+
+    uint64_t line_len = nl - p, used = line_len + 1;
+    if(line_len > 0 && p[line_len - 1] == '\r') line_len--;
+
+    /* split the line into tokens, pointing into the receive buffer */
+    const char *s = p, *end = p + line_len;
+    while(s < end && ntokens < SERVER_MAX_TOKENS)
+    {
+        while(s < end && *s == ' ') s++;
+        if(s == end) break;
+
+        tokens[ntokens].p = s;
+        while(s < end && *s != ' ') s++;
+        tokens[ntokens].len = s - tokens[ntokens].p;
+        ntokens++;
+    }
+
+    if(ntokens == 0)
+    {
+        APPEND_STR(c, "ERROR\r\n");
+        return used;
+    }
+
+    if(token_is(&tokens[0], "get") || token_is(&tokens[0], "gets"))
+    {
+        // any number of keys, so walk the line itself rather than the tokens
+        token_t key;
+        for(s = tokens[0].p + tokens[0].len; s < end; )
+        {
+            while(s < end && *s == ' ') s++;
+            if(s == end) break;
+
+            key.p = s;
+            while(s < end && *s != ' ') s++;
+            key.len = s - key.p;
+
+            if(key.len <= SERVER_MAX_KEY) do_get(st, c, &key);
+        }
+        APPEND_STR(c, "END\r\n");
+        return used;
+    }
+
+    if(token_is(&tokens[0], "set"))
+    {
+        uint64_t flags, exptime, nbytes;
+        bool noreply = (ntokens == 6 && token_is(&tokens[5], "noreply"));
+
+        if((ntokens != 5 && !noreply) || tokens[1].len > SERVER_MAX_KEY || !token_u64(&tokens[2], &flags) || flags > UINT32_MAX ||
+           !token_u64(&tokens[3], &exptime) || !token_u64(&tokens[4], &nbytes))
+        {
+            APPEND_STR(c, "CLIENT_ERROR bad command line format\r\n");
+            return used;
+        }
+
+        // too big to store: answer right away and drop the connection rather than wait for all of the data
+        if(tokens[1].len + nbytes > st->max_item_bytes)
+        {
+            APPEND_STR(c, "SERVER_ERROR object too large for cache\r\n");
+            c->closing = true;
+            return len;
+        }
+
+        // the data block follows the line
+        if(len < used + nbytes + 2) return 0;
+
+        const char *data = p + used;
+        used += nbytes + 2;
+
+        if(data[nbytes] != '\r' || data[nbytes + 1] != '\n')
+        {
+            APPEND_STR(c, "CLIENT_ERROR bad data chunk\r\n");
+            c->closing = true;
+            return used;
+        }
+
+        uint64_t nvals = st->table->nvals_per_item - 2;
+        uint64_t row[nvals];
+
+        memset(row, 0, nvals * sizeof(uint64_t));
+        row[0] = flags | (tokens[1].len << 32) | (nbytes << 40);
+        memcpy((char *) (row + 2), tokens[1].p, tokens[1].len);
+        memcpy((char *) (row + 2) + tokens[1].len, data, nbytes);
+        row[1] = row_check(row);
+
+        st->nsets++;
+
+        if(!conc_insert(st->table, key_hash(tokens[1].p, tokens[1].len), row))
+        {
+            APPEND_STR(c, "SERVER_ERROR out of memory storing object\r\n");
+        }
+        else if(!noreply)
+        {
+            APPEND_STR(c, "STORED\r\n");
+        }
+        return used;
+    }
+
+    if(token_is(&tokens[0], "delete"))
+    {
+        bool noreply = (ntokens == 3 && token_is(&tokens[2], "noreply"));
+
+        if((ntokens != 2 && !noreply) || tokens[1].len > SERVER_MAX_KEY)
+        {
+            APPEND_STR(c, "CLIENT_ERROR bad command line format\r\n");
+            return used;
+        }
+
+        uint64_t nvals = st->table->nvals_per_item - 2;
+        uint64_t row[nvals], h = key_hash(tokens[1].p, tokens[1].len);
+        bool deleted = false;
+
+        st->ndeletes++;
+
+        // only delete the item if it is this key's (and not another key's with the same hash)
+        if(conc_lookup(st->table, h, row) && ((row[0] >> 32) & 0xff) == tokens[1].len &&
+           memcmp((char *) (row + 2), tokens[1].p, tokens[1].len) == 0)
+        {
+            deleted = conc_delete(st->table, h);
+        }
+
+        if(!noreply)
+        {
+            if(deleted) APPEND_STR(c, "DELETED\r\n");
+            else APPEND_STR(c, "NOT_FOUND\r\n");
+        }
+        return used;
+    }
+
+    if(token_is(&tokens[0], "version"))
+    {
+        APPEND_STR(c, "VERSION " SERVER_VERSION "\r\n");
+        return used;
+    }
+
+    if(token_is(&tokens[0], "quit"))
+    {
+        c->closing = true;
+        return len; // drop whatever follows
+    }
+
+    APPEND_STR(c, "ERROR\r\n");
+    return used;
+}
+
+
+// send queued output, returns false if the connection is gone
+static bool
+flush_output(conn_t *c)
+{
+    while(c->out_sent < c->out_len)
+    {
+        ssize_t n = send(c->fd, c->out + c->out_sent, c->out_len - c->out_sent, MSG_NOSIGNAL);
+
+        if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return true;
+        if(n < 0 && errno == EINTR) continue;
+        if(n <= 0) return false;
+
+        c->out_sent += n;
+    }
+
+    c->out_len = c->out_sent = 0;
+    return true;
+}
+
+
+static void
+close_conn(int epfd, conn_t *c)
+{
+    epoll_ctl(epfd, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    free(c->in);
+    free(c->out);
+    free(c);
+}
+
+
+// read and handle everything the connection has sent, returns false once it is to be closed
+static bool
+serve(server_thread_t *st, int epfd, conn_t *c)
+{
+    uint64_t pos, n;
+
+    if(!flush_output(c)) return false;
+
+    while(!c->closing && c->out_len - c->out_sent < SERVER_OUT_LIMIT)
+    {
+        if(c->in_len == c->in_cap && !reserve(&c->in, &c->in_cap, 2 * c->in_cap)) return false;
+
+        ssize_t r = recv(c->fd, c->in + c->in_len, c->in_cap - c->in_len, 0);
+
+        if(r < 0 && errno == EINTR) continue;
+        if(r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        if(r <= 0) return false;
+
+        c->in_len += r;
+
+        /* every complete request in the buffer */
+        for(pos = 0; pos < c->in_len && !c->closing; pos += n)
+        {
+            n = handle_request(st, c, c->in + pos, c->in_len - pos);
+            if(n == 0) break;
+        }
+
+        // keep the incomplete rest for the next read
+        memmove(c->in, c->in + pos, c->in_len - pos);
+        c->in_len -= pos;
+
+        if(!flush_output(c)) return false;
+    }
+
+    if(c->closing && c->out_sent == c->out_len) return false;
+
+    // over the output limit (or closing) wait for the socket to take more output before reading on, input
+    // that is left unread would keep a level triggered EPOLLIN firing
+    uint64_t pending = c->out_len - c->out_sent;
+    uint32_t events = (c->closing || pending >= SERVER_OUT_LIMIT) ? EPOLLOUT : EPOLLIN | ((pending > 0) ? EPOLLOUT : 0);
+    struct epoll_event ev = {.events = events, .data.ptr = c};
+    epoll_ctl(epfd, EPOLL_CTL_MOD, c->fd, &ev);
+
+    return true;
+}
+
+
+static int
+open_listener(const int port)
+{
+    struct sockaddr_in addr = {.sin_family = AF_INET, .sin_port = htons(port), .sin_addr.s_addr = htonl(INADDR_LOOPBACK)};
+    int one = 1;
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+
+    if(fd < 0) return -1;
+
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    if(setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) != 0 || bind(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0 ||
+       listen(fd, 1024) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+
+static void *
+server_thread(void *ptr)
+{
+    server_thread_t *st = ptr;
+    struct epoll_event events[SERVER_MAX_EVENTS];
+    int listen_fd = open_listener(st->port);
+    int epfd = epoll_create1(0);
+    int i, n;
+
+    if(listen_fd < 0 || epfd < 0)
+    {
+        printf("\n Warning! Thread %i is unable to listen on port %i. \n",st->id,st->port);
+        stop = 1;
+        return NULL;
+    }
+
+    struct epoll_event ev = {.events = EPOLLIN, .data.ptr = NULL}; // NULL marks the listening socket
+    epoll_ctl(epfd, EPOLL_CTL_ADD, listen_fd, &ev);
+
+    while(!stop)
+    {
+        n = epoll_wait(epfd, events, SERVER_MAX_EVENTS, 100);
+
+        for(i = 0; i < n; i++)
+        {
+            conn_t *c = events[i].data.ptr;
+
+            if(c == NULL)
+            {
+                int fd;
+                while((fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK)) >= 0)
+                {
+                    int one = 1;
+                    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+                    c = calloc(1, sizeof(conn_t));
+                    if(c != NULL)
+                    {
+                        c->in_cap = c->out_cap = SERVER_BUF_BYTES;
+                        c->in = malloc(c->in_cap);
+                        c->out = malloc(c->out_cap);
+                    }
+                    if(c == NULL || c->in == NULL || c->out == NULL)
+                    {
+                        if(c != NULL) { free(c->in); free(c->out); free(c); }
+                        close(fd);
+                        continue;
+                    }
+                    c->fd = fd;
+
+                    struct epoll_event cev = {.events = EPOLLIN, .data.ptr = c};
+                    epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &cev);
+                    st->nconns++;
+                }
+                continue;
+            }
+
+            if((events[i].events & (EPOLLERR | EPOLLHUP)) || !serve(st, epfd, c)) close_conn(epfd, c);
+        }
+    }
+
+    // connections still open at shutdown are simply dropped (their memory goes with the process)
+    close(listen_fd);
+    close(epfd);
+
+    return NULL;
+}
+
+
+static void
+usage(const char *name)
+{
+    printf("\n usage: %s [-p port] [-t nthreads] [-c capacity] [-s max_item_bytes] \n",name);
+    printf("\n   -p   port on 127.0.0.1 (default 11211) \n");
+    printf("   -t   number of event loop threads (default: all cores) \n");
+    printf("   -c   initial table capacity (default 1048576, the table grows as needed) \n");
+    printf("   -s   room for key + value bytes per item (default 256) \n\n");
+}
+
+
+int main(int argc, char **argv)
+{
+
+    conc_table_t my_table;
+
+    int port = 11211;
+    int nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+    uint64_t capacity = 1UL << 20, max_item_bytes = 256;
+    int opt, t;
+
+    while((opt = getopt(argc, argv, "p:t:c:s:h")) != -1)
+    {
+        switch(opt)
+        {
+            case 'p': port = atoi(optarg); break;
+            case 't': nthreads = atoi(optarg); break;
+            case 'c': capacity = strtoul(optarg, NULL, 10); break;
+            case 's': max_item_bytes = strtoul(optarg, NULL, 10); break;
+            default:  usage(argv[0]); return 1;
+        }
+    }
+
+    if(nthreads < 1) nthreads = 1;
+    if(nthreads > SERVER_MAX_THREADS) nthreads = SERVER_MAX_THREADS;
+    if(max_item_bytes < SERVER_MAX_KEY + 1) max_item_bytes = SERVER_MAX_KEY + 1;
+    if(max_item_bytes > SERVER_MAX_ITEM)
+    {
+        printf("\n Warning! max_item_bytes is limited to %lu. \n",SERVER_MAX_ITEM);
+        max_item_bytes = SERVER_MAX_ITEM;
+    }
+
+    // value row: [flags | lengths][checksum][key and value bytes]
+    if(!init_conc_table(&my_table, capacity, 2 + 2 + (max_item_bytes + 7) / 8, 0.75)) return 1;
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    server_thread_t threads[nthreads];
+    pthread_t tids[nthreads];
+
+    for(t = 0; t < nthreads; t++)
+    {
+        threads[t] = (server_thread_t) {.id = t, .port = port, .table = &my_table, .max_item_bytes = max_item_bytes};
+        if(pthread_create(&tids[t], NULL, server_thread, &threads[t]) != 0)
+        {
+            printf("\n Unable to start server thread %i. \n",t);
+            return 1;
+        }
+    }
+
+    printf("\n Serving on 127.0.0.1:%i with %i threads \n",port,nthreads);
+    fflush(stdout);
+
+    uint64_t nconns = 0, ngets = 0, nhits = 0, nsets = 0, ndeletes = 0;
+
+    for(t = 0; t < nthreads; t++)
+    {
+        pthread_join(tids[t], NULL);
+        nconns += threads[t].nconns;
+        ngets += threads[t].ngets;
+        nhits += threads[t].nhits;
+        nsets += threads[t].nsets;
+        ndeletes += threads[t].ndeletes;
+    }
+
+    printf("\n Served %lu connections: %lu gets (%lu hits), %lu sets, %lu deletes, %lu items in the table \n",
+           nconns,ngets,nhits,nsets,ndeletes,my_table.nitems);
+
+    free_conc_table(&my_table);
+
+	return 0;
+}
@@ -0,0 +1,280 @@
+/*
+    Key-only specialization of the generic fixed size hash table (i.e. nvals_per_item = 0).
+
+    Every slot is a single uint64_t key. Empty and deleted slots are marked with the reserved
+    key values SET_EMPTY_KEY and SET_DELETED_KEY, so there is no status word and no value row.
+    Collisions are circumvented via linear probing (stride of 1), same as the generic table.
+
+    Memory layout of the set (starting at base_ptr):  [capacity][key_0][key_1]...[key_capacity-1]
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <assert.h>
+
+# include "hash.h"
+
+
+#define SET_BATCH 8 // number of keys hashed and prefetched ahead in the batch routines
+
+
+
+// initialization of an empty hash set
+void
+init_hash_set(hashset_t *set, void *base_ptr, const uint64_t set_capacity)
+{
+    uint64_t i;
+
+    /* make sure we're getting a valid base_ptr */
+    if(base_ptr == NULL)
+    {
+        printf("\n Invalid base_ptr provided. Unable to initilize hash set. \n");
+        return;
+    }
+
+    if(set_capacity < 1)
+    {
+        printf("\n Invalid set_capacity. Unable to initilize hash set. \n");
+        return;
+    }
+
+    /* map set into memory via the base_ptr */
+    set->capacity = base_ptr;
+    set->keys     = (uint64_t *) base_ptr + 1;
+
+    *(set->capacity) = set_capacity;
+
+    for(i = 0; i < set_capacity; i++)
+    {
+        set->keys[i] = SET_EMPTY_KEY;
+    }
+
+}
+
+
+/*
+    The probes start from a home slot that the caller has already hashed (the batch routines
+    hash a whole group up front for the prefetch and reuse the slots).
+*/
+static bool
+contains_from(const hashset_t *set, const uint64_t key, const uint64_t index)
+{
+
+    if(key == SET_EMPTY_KEY || key == SET_DELETED_KEY) return false;
+
+    uint64_t capacity = *(set->capacity);
+    uint64_t i, try;
+
+    for(i = 0; i < capacity; i++)
+    {
+        try = index + i;
+        if(try >= capacity) try -= capacity;
+
+        if(set->keys[try] == key) return true;
+
+        if(set->keys[try] == SET_EMPTY_KEY) break;
+    }
+
+    return false;
+
+}
+
+
+static bool
+add_from(hashset_t *set, const uint64_t key, const uint64_t index)
+{
+
+    if(key == SET_EMPTY_KEY || key == SET_DELETED_KEY)
+    {
+        printf("\n Warning! Key %lu is reserved by the hash set. Unable to add. \n",key);
+        return false;
+    }
+
+    uint64_t capacity = *(set->capacity);
+    uint64_t i, try;
+    int64_t first_deleted = -1;
+
+    /* walk the cluster to make sure the key isn't already present, remembering the leading deleted slot for reuse */
+    for(i = 0; i < capacity; i++)
+    {
+        try = index + i;
+        if(try >= capacity) try -= capacity;
+
+        if(set->keys[try] == key) return false;
+
+        if(set->keys[try] == SET_DELETED_KEY)
+        {
+            if(first_deleted < 0) first_deleted = try;
+            continue;
+        }
+
+        if(set->keys[try] == SET_EMPTY_KEY)
+        {
+            if(first_deleted >= 0) try = first_deleted;
+            set->keys[try] = key;
+            return true;
+        }
+    }
+
+    if(first_deleted >= 0)
+    {
+        set->keys[first_deleted] = key;
+        return true;
+    }
+
+    printf("\n Warning! Unable to add key: %lu. Ran out of empty slots. \n",key);
+    return false;
+
+}
+
+
+static bool
+remove_from(hashset_t *set, const uint64_t key, const uint64_t index)
+{
+
+    if(key == SET_EMPTY_KEY || key == SET_DELETED_KEY) return false;
+
+    uint64_t capacity = *(set->capacity);
+    uint64_t i, try;
+
+    for(i = 0; i < capacity; i++)
+    {
+        try = index + i;
+        if(try >= capacity) try -= capacity;
+
+        if(set->keys[try] == key)
+        {
+            set->keys[try] = SET_DELETED_KEY;
+            return true;
+        }
+
+        if(set->keys[try] == SET_EMPTY_KEY) break;
+    }
+
+    return false;
+
+}
+
+
+
+// check whether key is in the set
+bool
+set_contains(const hashset_t *set, const uint64_t key)
+{
+    assert(set != NULL);
+
+    return contains_from(set, key, hash(key, *(set->capacity)));
+}
+
+
+// add key to the set, returns true if the key was not already present
+bool
+set_add(hashset_t *set, const uint64_t key)
+{
+    assert(set != NULL);
+
+    return add_from(set, key, hash(key, *(set->capacity)));
+}
+
+
+// remove key from the set, returns true if the key was present
+bool
+set_remove(hashset_t *set, const uint64_t key)
+{
+    assert(set != NULL);
+
+    return remove_from(set, key, hash(key, *(set->capacity)));
+}
+
+
+
+/*
+    Batch variants. Keys are processed SET_BATCH at a time: the home slots of the whole group are
+    hashed and prefetched first, so the cache misses of the group overlap instead of being paid one
+    after the other. The probes then start from those home slots, every key is hashed once.
+*/
+
+
+static void
+prefetch_group(const hashset_t *set, const uint64_t *keys, const uint64_t nkeys, uint64_t *home)
+{
+    uint64_t k;
+    uint64_t capacity = *(set->capacity);
+
+    for(k = 0; k < nkeys; k++)
+    {
+        home[k] = hash(keys[k], capacity);
+        __builtin_prefetch(&set->keys[home[k]], 0, 1);
+    }
+}
+
+
+// returns the number of keys found, found[k] is set for every key (found may be NULL)
+uint64_t
+set_contains_batch(const hashset_t *set, const uint64_t *keys, const uint64_t nkeys, bool *found)
+{
+    uint64_t n, k, len, nfound = 0;
+    uint64_t home[SET_BATCH];
+
+    for(n = 0; n < nkeys; n += SET_BATCH)
+    {
+        len = (nkeys - n < SET_BATCH) ? nkeys - n : SET_BATCH;
+        prefetch_group(set, keys + n, len, home);
+
+        for(k = n; k < n + len; k++)
+        {
+            bool is_member = contains_from(set, keys[k], home[k - n]);
+            if(found != NULL) found[k] = is_member;
+            nfound += is_member;
+        }
+    }
+
+    return nfound;
+}
+
+
+// returns the number of keys that were newly added
+uint64_t
+set_add_batch(hashset_t *set, const uint64_t *keys, const uint64_t nkeys)
+{
+    uint64_t n, k, len, nadded = 0;
+    uint64_t home[SET_BATCH];
+
+    for(n = 0; n < nkeys; n += SET_BATCH)
+    {
+        len = (nkeys - n < SET_BATCH) ? nkeys - n : SET_BATCH;
+        prefetch_group(set, keys + n, len, home);
+
+        for(k = n; k < n + len; k++)
+        {
+            nadded += add_from(set, keys[k], home[k - n]);
+        }
+    }
+
+    return nadded;
+}
+
+
+// returns the number of keys that were removed
+uint64_t
+set_remove_batch(hashset_t *set, const uint64_t *keys, const uint64_t nkeys)
+{
+    uint64_t n, k, len, nremoved = 0;
+    uint64_t home[SET_BATCH];
+
+    for(n = 0; n < nkeys; n += SET_BATCH)
+    {
+        len = (nkeys - n < SET_BATCH) ? nkeys - n : SET_BATCH;
+        prefetch_group(set, keys + n, len, home);
+
+        for(k = n; k < n + len; k++)
+        {
+            nremoved += remove_from(set, keys[k], home[k - n]);
+        }
+    }
+
+    return nremoved;
+}
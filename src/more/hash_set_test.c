@@ -0,0 +1,77 @@
+/*
+    Test driver for the key-only hash set: add keys one at a time and in batches, look them up,
+    remove every other one and check that the rest is still found and that removed slots are
+    reused.
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+# include "hash.h"
+
+
+#define SET_SIZE 10000
+
+
+
+int main()
+{
+
+    hashset_t my_set;
+
+    uint64_t set_capacity = SET_SIZE;
+    uint64_t nkeys = 3 * set_capacity / 4;
+    uint64_t i, nadded, nfound, nwrong = 0;
+    uint64_t *keys = malloc(nkeys * sizeof(uint64_t));
+    bool *found = malloc(nkeys * sizeof(bool));
+    void * base_ptr = malloc((1 + set_capacity) * sizeof(uint64_t));
+
+    init_hash_set(&my_set, base_ptr, set_capacity);
+
+
+    // testing...
+
+    for(i = 0; i < nkeys; i++) keys[i] = 7 * i + 1;
+
+    // first half one at a time, second half as a batch, with the first half repeated (already present)
+    for(nadded = 0, i = 0; i < nkeys / 2; i++) nadded += set_add(&my_set, keys[i]);
+    nadded += set_add_batch(&my_set, keys, nkeys);
+    printf("\n Added %lu of %lu keys \n",nadded,nkeys);
+    if(nadded != nkeys) nwrong++;
+
+    nfound = set_contains_batch(&my_set, keys, nkeys, found);
+    for(i = 0; i < nkeys; i++) nwrong += (found[i] != set_contains(&my_set, keys[i]));
+    printf("\n Found %lu keys, key %lu (never added): %s \n",nfound,7 * nkeys + 1,set_contains(&my_set, 7 * nkeys + 1) ? "found" : "not found");
+    if(nfound != nkeys || set_contains(&my_set, 7 * nkeys + 1)) nwrong++;
+
+    // remove the odd positions in one batch
+    uint64_t nremoved = 0;
+    for(i = 1; i < nkeys; i += 2) keys[nremoved++] = keys[i];
+    nremoved = set_remove_batch(&my_set, keys, nremoved);
+    for(i = 0; i < nkeys; i++) keys[i] = 7 * i + 1;
+
+    nfound = set_contains_batch(&my_set, keys, nkeys, found);
+    for(i = 0; i < nkeys; i++) nwrong += (found[i] != (i % 2 == 0));
+    printf("\n Removed %lu keys, %lu left \n",nremoved,nfound);
+
+    // the removed keys go back in, into the deleted slots on their paths
+    nadded = set_add_batch(&my_set, keys, nkeys);
+    nfound = set_contains_batch(&my_set, keys, nkeys, NULL);
+    printf("\n Added back %lu keys, %lu in the set \n",nadded,nfound);
+    if(nadded != nremoved || nfound != nkeys) nwrong++;
+
+    bool reserved_added = set_add(&my_set, SET_EMPTY_KEY);
+    printf("\n Reserved key: %s \n",reserved_added ? "added" : "rejected");
+    if(reserved_added) nwrong++;
+
+    printf("\n %s \n\n",(nwrong == 0) ? "All checks passed." : "Some checks FAILED.");
+
+    free(keys);
+    free(found);
+    free(base_ptr);
+
+	return (nwrong == 0) ? 0 : 1;
+}
@@ -0,0 +1,297 @@
+/*
+    Header-only C++ version of the generic fixed size hash table.
+
+    Same open addressing scheme as hash.c (status word per slot, 0 = empty, 1 = occupied,
+    2 = deleted, probe until the leading empty slot), but the slot width, the hash function
+    and the probing policy are template parameters, so they are all known at compile time
+    and the probe loop gets inlined into the caller. Values are stored typed (constructed
+    in place, moved in and destroyed on erase) instead of as raw uint64_t rows.
+
+    Usage:
+
+        HashTable<uint64_t, uint64_t> table(1000);
+        table.insert(42, 7);
+        uint64_t *v = table.find(42);
+
+    Needs C++14 (std::launder is used where the library has it, i.e. from C++17 on). A table
+    that has been moved from is empty with no slots, and gets a fresh table of
+    MOVED_FROM_CAPACITY slots on its next insert.
+*/
+
+#ifndef HASH_TABLE_HPP
+#define HASH_TABLE_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+
+namespace hash_table
+{
+
+
+// 64-bit MurMur hash 2 of a single 8-byte key (same mixing as hash() in hash.c)
+template <typename Key>
+struct MurmurHash
+{
+    static_assert(std::is_integral<Key>::value && sizeof(Key) <= 8, "MurmurHash needs an integral key of up to 8 bytes");
+
+    std::uint64_t operator()(const Key key) const noexcept
+    {
+        const std::uint64_t m = 0xc6a4a7935bd1e995ULL;
+        const unsigned r = 47;
+
+        std::uint64_t k = static_cast<std::uint64_t>(key);
+        std::uint64_t hash_val = 8 * m;
+
+        k *= m;
+        k ^= k >> r;
+        k *= m;
+
+        hash_val ^= k;
+        hash_val *= m;
+
+        hash_val ^= hash_val >> r;
+        hash_val *= m;
+        hash_val ^= hash_val >> r;
+
+        return hash_val;
+    }
+};
+
+
+// probing policies: slot to try on the i-th step away from the home slot (capacity is a power of 2)
+struct LinearProbe
+{
+    static constexpr std::uint64_t slot(const std::uint64_t index, const std::uint64_t i, const std::uint64_t mask) noexcept
+    {
+        return (index + i) & mask;
+    }
+};
+
+struct QuadraticProbe
+{
+    // triangular numbers visit every slot of a power of 2 table exactly once
+    static constexpr std::uint64_t slot(const std::uint64_t index, const std::uint64_t i, const std::uint64_t mask) noexcept
+    {
+        return (index + ((i * (i + 1)) >> 1)) & mask;
+    }
+};
+
+
+template <typename Key, typename Value, typename Hash = MurmurHash<Key>, typename Probe = LinearProbe>
+class HashTable
+{
+public:
+
+    enum : std::uint8_t { EMPTY = 0, OCCUPIED = 1, DELETED = 2 };
+
+    struct Slot
+    {
+        std::uint8_t status = EMPTY;
+        Key key;
+        alignas(Value) unsigned char storage[sizeof(Value)];
+
+#if defined(__cpp_lib_launder)
+        Value *value() noexcept { return std::launder(reinterpret_cast<Value *>(storage)); }
+        const Value *value() const noexcept { return std::launder(reinterpret_cast<const Value *>(storage)); }
+#else
+        Value *value() noexcept { return reinterpret_cast<Value *>(storage); }
+        const Value *value() const noexcept { return reinterpret_cast<const Value *>(storage); }
+#endif
+    };
+
+    // slot width, fixed at compile time (the C table computes it from *nvals_per_item on every call)
+    static constexpr std::size_t size_of_item = sizeof(Slot);
+
+    // capacity a moved-from table starts over with
+    static constexpr std::uint64_t MOVED_FROM_CAPACITY = 16;
+
+
+    // table_capacity is rounded up to the next power of 2 so that probing can mask instead of divide
+    explicit HashTable(const std::uint64_t table_capacity)
+        : mask_(round_up_pow2(table_capacity) - 1),
+          slots_(new Slot[mask_ + 1])
+    {
+    }
+
+    HashTable(const HashTable &) = delete;
+    HashTable &operator=(const HashTable &) = delete;
+
+    HashTable(HashTable &&other) noexcept
+        : mask_(other.mask_), size_(other.size_), slots_(std::move(other.slots_)), hash_(std::move(other.hash_))
+    {
+        other.mask_ = 0;
+        other.size_ = 0;
+    }
+
+    HashTable &operator=(HashTable &&other) noexcept
+    {
+        if(this != &other)
+        {
+            clear();
+            mask_  = other.mask_;
+            size_  = other.size_;
+            slots_ = std::move(other.slots_);
+            hash_  = std::move(other.hash_);
+            other.mask_ = 0;
+            other.size_ = 0;
+        }
+        return *this;
+    }
+
+    ~HashTable() { clear(); }
+
+
+    std::uint64_t capacity() const noexcept { return slots_ ? mask_ + 1 : 0; }
+    std::uint64_t size() const noexcept { return size_; }
+
+
+    // insert a new item, returns false if the key is already present or the table is full
+    template <typename V>
+    bool insert(const Key &key, V &&value)
+    {
+        return emplace(key, std::forward<V>(value)).second;
+    }
+
+    // construct the value in place, returns the value of the item with this key and whether it was inserted
+    template <typename... Args>
+    std::pair<Value *, bool> emplace(const Key &key, Args &&... args)
+    {
+        if(!slots_)
+        {
+            slots_.reset(new Slot[MOVED_FROM_CAPACITY]);
+            mask_ = MOVED_FROM_CAPACITY - 1;
+        }
+
+        const std::uint64_t capacity = mask_ + 1;
+        const std::uint64_t index = hash_(key) & mask_;
+        Slot *first_deleted = nullptr;
+
+        for(std::uint64_t i = 0; i < capacity; i++)
+        {
+            Slot &slot = slots_[Probe::slot(index, i, mask_)];
+
+            if(slot.status == OCCUPIED)
+            {
+                if(slot.key == key) return {slot.value(), false};
+                continue;
+            }
+
+            if(slot.status == DELETED)
+            {
+                if(first_deleted == nullptr) first_deleted = &slot;
+                continue;
+            }
+
+            return {construct(first_deleted ? *first_deleted : slot, key, std::forward<Args>(args)...), true};
+        }
+
+        if(first_deleted != nullptr) return {construct(*first_deleted, key, std::forward<Args>(args)...), true};
+
+        return {nullptr, false};
+    }
+
+    // find the value of the item with given key (nullptr if not present)
+    Value *find(const Key &key) noexcept
+    {
+        Slot *slot = find_slot(key);
+        return slot ? slot->value() : nullptr;
+    }
+
+    const Value *find(const Key &key) const noexcept
+    {
+        const Slot *slot = const_cast<HashTable *>(this)->find_slot(key);
+        return slot ? slot->value() : nullptr;
+    }
+
+    bool contains(const Key &key) const noexcept { return find(key) != nullptr; }
+
+    // delete the item with given key (destroys its value and leaves a tombstone)
+    bool erase(const Key &key)
+    {
+        Slot *slot = find_slot(key);
+        if(slot == nullptr) return false;
+
+        slot->value()->~Value();
+        slot->status = DELETED;
+        size_--;
+        return true;
+    }
+
+    // visit every item as fn(key, value)
+    template <typename Fn>
+    void for_each(Fn &&fn)
+    {
+        for(std::uint64_t i = 0; i < capacity(); i++)
+        {
+            if(slots_[i].status == OCCUPIED) fn(static_cast<const Key &>(slots_[i].key), *slots_[i].value());
+        }
+    }
+
+    // destroy all items and mark every slot empty
+    void clear() noexcept
+    {
+        if(!slots_) return;
+
+        for(std::uint64_t i = 0; i <= mask_; i++)
+        {
+            if(slots_[i].status == OCCUPIED) slots_[i].value()->~Value();
+            slots_[i].status = EMPTY;
+        }
+        size_ = 0;
+    }
+
+
+private:
+
+    static std::uint64_t round_up_pow2(std::uint64_t n) noexcept
+    {
+        std::uint64_t p = 1;
+        while(p < n) p <<= 1;
+        return p;
+    }
+
+    template <typename... Args>
+    Value *construct(Slot &slot, const Key &key, Args &&... args)
+    {
+        ::new (static_cast<void *>(slot.storage)) Value(std::forward<Args>(args)...);
+        slot.key = key;
+        slot.status = OCCUPIED;
+        size_++;
+        return slot.value();
+    }
+
+    Slot *find_slot(const Key &key) noexcept
+    {
+        if(!slots_) return nullptr;
+
+        const std::uint64_t capacity = mask_ + 1;
+        const std::uint64_t index = hash_(key) & mask_;
+
+        for(std::uint64_t i = 0; i < capacity; i++)
+        {
+            Slot &slot = slots_[Probe::slot(index, i, mask_)];
+
+            if(slot.status == EMPTY) break;
+
+            if(slot.status == OCCUPIED && slot.key == key) return &slot;
+        }
+
+        return nullptr;
+    }
+
+
+    std::uint64_t mask_;
+    std::uint64_t size_ = 0;
+    std::unique_ptr<Slot[]> slots_;
+    Hash hash_;
+};
+
+
+} // namespace hash_table
+
+#endif
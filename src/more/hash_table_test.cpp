@@ -0,0 +1,87 @@
+/*
+    Test driver for the header-only C++ HashTable: insert, look up and erase with both probing
+    policies, typed values that own memory, and reuse of a table after it has been moved from.
+    Builds with -std=c++14 and later.
+*/
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <utility>
+
+#include "hash_table.hpp"
+
+
+#define TABLE_SIZE 10000
+
+using hash_table::HashTable;
+
+
+
+template <typename Probe>
+static int
+run_probe_test(const char *name)
+{
+    HashTable<std::uint64_t, std::uint64_t, hash_table::MurmurHash<std::uint64_t>, Probe> table(TABLE_SIZE);
+    std::uint64_t nitems = 3 * table.capacity() / 4;
+    std::uint64_t i, nfound = 0, nwrong = 0;
+
+    for(i = 1; i <= nitems; i++) nwrong += !table.insert(i, 3 * i);
+    nwrong += table.insert(1, 0);  // already present
+
+    for(i = 1; i <= nitems; i++)
+    {
+        std::uint64_t *v = table.find(i);
+        if(v != nullptr)
+        {
+            nfound++;
+            nwrong += (*v != 3 * i);
+        }
+    }
+
+    for(i = 1; i <= nitems; i += 2) nwrong += !table.erase(i);
+    for(i = 1; i <= nitems; i++) nwrong += (table.contains(i) != (i % 2 == 0));
+
+    std::printf("\n %s: capacity %lu, found %lu of %lu, %lu left after erasing odd keys, %lu errors \n",name,
+                (unsigned long) table.capacity(),(unsigned long) nfound,(unsigned long) nitems,(unsigned long) table.size(),(unsigned long) nwrong);
+
+    return nwrong == 0 && table.size() == nitems / 2;
+}
+
+
+
+int main()
+{
+
+    int ok = run_probe_test<hash_table::LinearProbe>("linear") & run_probe_test<hash_table::QuadraticProbe>("quadratic");
+
+
+    // testing typed values and moves...
+
+    HashTable<std::uint64_t, std::string> names(100);
+
+    names.insert(1, "one");
+    names.emplace(2, 3, 'x');
+    names.insert(3, std::string(100, 'y'));
+    names.erase(3);
+
+    HashTable<std::uint64_t, std::string> moved(std::move(names));
+
+    ok &= (moved.size() == 2 && *moved.find(2) == "xxx" && names.size() == 0 && names.capacity() == 0 && names.find(1) == nullptr);
+
+    // the moved-from table is usable again
+    names.insert(5, "five");
+    ok &= (names.size() == 1 && *names.find(5) == "five" && names.capacity() == names.MOVED_FROM_CAPACITY);
+
+    names = std::move(moved);
+    ok &= (names.size() == 2 && *names.find(1) == "one" && moved.find(1) == nullptr);
+
+    moved.emplace(7, "seven");
+    ok &= (moved.size() == 1 && moved.contains(7));
+
+    std::printf("\n Typed values and moves: %s \n",ok ? "ok" : "FAILED");
+
+    std::printf("\n %s \n\n",ok ? "All checks passed." : "Some checks FAILED.");
+
+    return ok ? 0 : 1;
+}
@@ -45,7 +45,7 @@ void print_table(const hashtable_t *table)
         p = base_ptr + 3*sizeof(uint64_t) + i*size_of_item;
 
         // get status of this slot
-        slot_status = p[0]; 
+        slot_status = slot_state(table, p); 
    
         if(slot_status == 0)   
         {
@@ -85,7 +85,7 @@ int main()
     table_bytes = 2 * sizeof(uint64_t)  +  table_capacity *  item_bytes ;     
     printf("\n Table capacity = %i, nvals_per_item = %i, table_bytes = %i \n",table_capacity,nvals_per_item,table_bytes);
 
-    base_ptr = malloc(table_bytes);
+    base_ptr = hash_table_alloc(table_capacity, nvals_per_item, 0);
     
     // initialize hash table
     init_hash_table(&my_table, base_ptr, table_capacity, nvals_per_item);
@@ -115,6 +115,9 @@ int main()
     found = delete_item(&my_table, 7);
     print_table(&my_table);
 
+    free(my_table.items);
+    hash_table_free(base_ptr);
+
 
 	return 0;
 }
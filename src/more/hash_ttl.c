@@ -0,0 +1,120 @@
+/*
+    Per-item expiration for the generic hash table.
+
+    Expiration times live in a parallel array of capacity words (expiry[slot], 0 = never expires),
+    so the key/value layout of the table is unchanged. Once attached, expired items read as absent
+    right away: lookups, cursors and parallel scans only skip them (item_expired() in hash.h), since
+    they don't modify the table and may run concurrently, while inserts and deletes turn every expired
+    item their probe runs into into a deleted slot (expire_item()). On top of that, every insert and
+    delete advances an incremental sweeper over EXPIRE_SWEEP_SLOTS slots, so items nobody looks up
+    get reclaimed too, without full scans.
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <time.h>
+#include <assert.h>
+
+# include "hash.h"
+
+
+
+// current time in ns
+uint64_t
+hash_time_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t) ts.tv_sec * 1000000000UL + ts.tv_nsec;
+}
+
+
+// attach an expiry array of capacity words, all items currently in the table never expire
+void
+attach_expiry(hashtable_t *table, uint64_t *expiry)
+{
+    assert(table != NULL);
+
+    uint64_t capacity = *(table->capacity);
+    uint64_t i;
+
+    if(expiry == NULL)
+    {
+        printf("\n Invalid expiry array. Unable to attach expiry. \n");
+        return;
+    }
+
+    for(i = 0; i < capacity; i++)
+    {
+        expiry[i] = 0;
+    }
+
+    table->expiry = expiry;
+    table->sweep = 0;
+}
+
+
+// insert or update an item that expires ttl ns from now (ttl = 0 never expires)
+uint64_t *
+insert_with_ttl(hashtable_t *table, const uint64_t key, const uint64_t *values, const uint64_t ttl)
+{
+    uint64_t *vals = insert_or_assign(table, key, values);
+
+    if(vals == NULL || table->expiry == NULL) return vals;
+
+    table->expiry[slot_of(table, vals)] = (ttl > 0) ? hash_time_now() + ttl : 0;
+
+    return vals;
+}
+
+
+// change the time to live of an existing item, returns false if it's not in the table
+bool
+set_item_ttl(hashtable_t *table, const uint64_t key, const uint64_t ttl)
+{
+    assert(table != NULL);
+
+    if(table->expiry == NULL) return false;
+
+    uint64_t *vals = find_item(table, key);
+
+    if(vals == NULL) return false;
+
+    table->expiry[slot_of(table, vals)] = (ttl > 0) ? hash_time_now() + ttl : 0;
+
+    return true;
+}
+
+
+// advance the sweeper over the next nslots slots, returns the number of items that expired
+uint64_t
+expire_step(hashtable_t *table, const uint64_t nslots)
+{
+    assert(table != NULL);
+
+    if(table->expiry == NULL) return 0;
+
+    void *base_ptr = table->capacity;
+    uint64_t capacity = *(table->capacity);
+    uint64_t nvals_per_item = *(table->nvals_per_item);
+    uint64_t size_of_item = (1 + nvals_per_item) * sizeof(uint64_t);
+    uint64_t now = hash_time_now();
+    uint64_t i, nexpired = 0, *p;
+
+    for(i = 0; i < nslots && i < capacity; i++)
+    {
+        uint64_t slot = table->sweep;
+        table->sweep = (slot + 1 == capacity) ? 0 : slot + 1;
+
+        p = base_ptr + 3*sizeof(uint64_t) + slot*size_of_item;
+
+        nexpired += expire_item(table, p, slot, now);
+    }
+
+    return nexpired;
+}
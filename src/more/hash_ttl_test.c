@@ -0,0 +1,68 @@
+/*
+    Test driver for per-item expiration: let half of the items of a table expire and check that
+    lookups and scans report them absent without modifying the table, and that inserts and deletes
+    let the sweeper reclaim all of them.
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+# include "hash.h"
+
+
+#define TABLE_SIZE 10000
+#define ITEM_NVALS 3 // needs to be >= 3
+
+
+
+int main()
+{
+
+    hashtable_t my_table = {NULL};
+
+    uint64_t table_capacity = TABLE_SIZE;
+    uint64_t nvals_per_item = ITEM_NVALS;
+    uint64_t nitems = table_capacity / 2;
+    uint64_t i, n, nwrong = 0;
+    hash_cursor_t cursor;
+    void * base_ptr = calloc(1, 2 * sizeof(uint64_t) + table_capacity * (1 + nvals_per_item) * sizeof(uint64_t));
+    uint64_t * expiry = calloc(table_capacity, sizeof(uint64_t));
+
+    init_hash_table(&my_table, base_ptr, table_capacity, nvals_per_item);
+    attach_expiry(&my_table, expiry);
+
+
+    // testing...
+
+    // odd keys expire after 1 ns, that is right away
+    for(i = 1; i <= nitems; i++) insert_with_ttl(&my_table, i, &i, (i % 2 == 1) ? 1 : 0);
+
+    // the inserts have swept part of the table already, lookups and scans leave the rest alone
+    uint64_t nexpired = my_table.nexpired, ntombstones = my_table.ntombstones;
+
+    for(i = 1; i <= nitems; i++) nwrong += ((find_item(&my_table, i) != NULL) != (i % 2 == 0));
+    for(n = 0, init_cursor(&cursor, &my_table, NULL, NULL); next_item(&cursor) != NULL; n++);
+    n += scan_table_parallel(&my_table, 4, NULL, NULL, NULL);
+
+    printf("\n Lookups and scans: %lu items (expected %lu), %lu of %lu expired so far \n",n,nitems,my_table.nexpired,nitems / 2);
+    nwrong += (n != nitems || my_table.nexpired != nexpired || my_table.ntombstones != ntombstones);
+
+    // each delete sweeps a few slots
+    for(i = 2; i <= nitems; i += 2) nwrong += !erase_item(&my_table, i);
+
+    printf("\n After %lu deletes: %lu items expired \n",nitems / 2,my_table.nexpired);
+    nwrong += (my_table.nexpired != nitems / 2);
+
+    for(i = 1; i <= nitems; i++) nwrong += (find_item(&my_table, i) != NULL);
+
+    printf("\n %s \n\n",(nwrong == 0) ? "All checks passed." : "Some checks FAILED.");
+
+    free(my_table.items);
+    free(base_ptr);
+    free(expiry);
+
+	return (nwrong == 0) ? 0 : 1;
+}
@@ -0,0 +1,105 @@
+/*
+    Test driver for the single probe upsert API: count key occurrences through the value
+    pointer of find_or_insert(), overwrite with insert_or_assign(), reuse deleted slots and
+    run a small table full.
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+# include "hash.h"
+
+
+#define TABLE_SIZE 10000
+#define ITEM_NVALS 4 // needs to be >= 3
+
+
+
+int main()
+{
+
+    hashtable_t my_table = {NULL};
+
+    uint64_t table_capacity = TABLE_SIZE;
+    uint64_t nvals_per_item = ITEM_NVALS;
+    uint64_t nkeys = table_capacity / 2;
+    uint64_t i, ninserted = 0, nwrong = 0;
+    uint64_t *vals;
+    bool inserted;
+    void * base_ptr = calloc(1, 2 * sizeof(uint64_t) + table_capacity * (1 + nvals_per_item) * sizeof(uint64_t));
+
+    init_hash_table(&my_table, base_ptr, table_capacity, nvals_per_item);
+
+
+    // testing...
+
+    // key k occurs k % 5 + 1 times
+    for(i = 0; i < 5 * nkeys; i++)
+    {
+        uint64_t key = i % nkeys;
+        if(i / nkeys > key % 5) continue;
+
+        vals = find_or_insert(&my_table, key, &inserted);
+        if(inserted)
+        {
+            ninserted++;
+            nwrong += (vals[0] != 0 || vals[1] != 0);  // new items start out zeroed
+        }
+        vals[0]++;
+    }
+
+    for(i = 0; i < nkeys; i++)
+    {
+        vals = find_item(&my_table, i);
+        nwrong += (vals == NULL || vals[0] != i % 5 + 1);
+    }
+    printf("\n find_or_insert: %lu new keys of %lu, counts %s \n",ninserted,nkeys,(nwrong == 0) ? "ok" : "WRONG");
+    nwrong += (ninserted != nkeys);
+
+    // overwrite half of them
+    for(i = 0; i < nkeys; i += 2)
+    {
+        uint64_t values[2] = {100 + i, 200 + i};
+        nwrong += (insert_or_assign(&my_table, i, values) == NULL);
+    }
+    for(i = 0; i < nkeys; i++)
+    {
+        vals = find_item(&my_table, i);
+        nwrong += (i % 2 == 0) ? (vals[0] != 100 + i || vals[1] != 200 + i) : (vals[0] != i % 5 + 1);
+    }
+    printf("\n insert_or_assign: %s \n",(nwrong == 0) ? "ok" : "WRONG");
+
+    // deleted keys come back into the deleted slots, the table doesn't gain used slots
+    for(i = 0; i < nkeys; i += 2) erase_item(&my_table, i);
+    uint64_t ntombstones = my_table.ntombstones;
+    for(i = 0; i < nkeys; i += 2)
+    {
+        vals = find_or_insert(&my_table, i, &inserted);
+        nwrong += (!inserted || vals[0] != 0);
+    }
+    printf("\n Reinserted %lu deleted keys, tombstones %lu -> %lu \n",nkeys / 2,ntombstones,my_table.ntombstones);
+    nwrong += (my_table.ntombstones >= ntombstones);
+
+    // a full table has no slot for a new key, but still finds the old ones
+    hashtable_t small_table = {NULL};
+    void * small_base = calloc(1, 2 * sizeof(uint64_t) + 8 * (1 + nvals_per_item) * sizeof(uint64_t));
+
+    init_hash_table(&small_table, small_base, 8, nvals_per_item);
+    for(i = 0; i < 8; i++) nwrong += (find_or_insert(&small_table, i, NULL) == NULL);
+    nwrong += (find_or_insert(&small_table, 3, &inserted) == NULL || inserted);
+    vals = find_or_insert(&small_table, 100, &inserted);
+    printf("\n Full table: new key %s \n",(vals == NULL) ? "rejected" : "INSERTED");
+    nwrong += (vals != NULL || inserted);
+
+    printf("\n %s \n\n",(nwrong == 0) ? "All checks passed." : "Some checks FAILED.");
+
+    free(my_table.items);
+    free(small_table.items);
+    free(base_ptr);
+    free(small_base);
+
+	return (nwrong == 0) ? 0 : 1;
+}
@@ -0,0 +1,258 @@
+/*
+    Implementation of a fixed size hopscotch hash table.
+
+    Every slot doubles as the home bucket of the keys that hash to it and keeps a HOP_RANGE-bit
+    bitmap of which of the following HOP_RANGE slots hold those keys. A lookup therefore only
+    inspects the slots flagged in a single bitmap, all within one neighborhood. Inserts probe
+    linearly for the leading empty slot and, if that is too far from home, hop it backwards by
+    moving items that may legally move there (i.e. stay within their own neighborhood) until
+    the empty slot falls inside the neighborhood of the new key. Deletes just clear the slot and
+    the bitmap bit, no tombstones are needed.
+
+    Memory layout of the table (starting at base_ptr), same slot size and offsets as hashtable_t
+    with the otherwise unused leading word of every item holding the neighborhood bitmap:
+
+        [capacity][nvals_per_item][hop bits][status][key][values...][hop bits][status][key] ...
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <assert.h>
+
+# include "hash.h"
+# include "hopscotch.h"
+
+
+#define HOP_ADD_RANGE 4096 // max distance from home searched for an empty slot on insert
+
+
+
+// pointer to slot i: s[0] = hop bitmap of home slot i, s[1] = status, s[2] = key, s+3 = values
+static inline uint64_t *
+get_slot(const hopscotch_table_t *table, const uint64_t i)
+{
+    uint64_t size_of_item = (1 + *(table->nvals_per_item)) * sizeof(uint64_t);
+
+    return (void *) table->capacity + 2*sizeof(uint64_t) + i*size_of_item;
+}
+
+
+static inline uint64_t
+wrap(const uint64_t i, const uint64_t capacity)
+{
+    return (i >= capacity) ? i - capacity : i;
+}
+
+
+uint64_t
+hopscotch_table_bytes(const uint64_t table_capacity, const uint64_t nvals_per_item)
+{
+    return 2*sizeof(uint64_t) + table_capacity*(1 + nvals_per_item)*sizeof(uint64_t);
+}
+
+
+// initialization of an empty hopscotch table (base_ptr must point at hopscotch_table_bytes() bytes)
+void
+init_hopscotch_table(hopscotch_table_t *table, void *base_ptr, const uint64_t table_capacity, const uint64_t nvals_per_item)
+{
+    uint64_t i;
+
+    if(base_ptr == NULL)
+    {
+        printf("\n Invalid base_ptr provided. Unable to initilize hopscotch table. \n");
+        return;
+    }
+
+    if(table_capacity < HOP_RANGE || nvals_per_item < 3)
+    {
+        printf("\n Invalid table_capacity or nvals_per_item. Unable to initilize hopscotch table. \n");
+        return;
+    }
+
+    table->capacity       = base_ptr;
+    table->nvals_per_item = (uint64_t *) base_ptr + 1;
+
+    *(table->capacity)       = table_capacity;
+    *(table->nvals_per_item) = nvals_per_item;
+
+    for(i = 0; i < table_capacity; i++)
+    {
+        uint64_t *s = get_slot(table, i);
+        s[0] = 0;
+        s[1] = 0;
+    }
+
+}
+
+
+// find the item with given key and return a pointer to its values (NULL if not present)
+uint64_t *
+hopscotch_lookup_item(const hopscotch_table_t *table, const uint64_t key)
+{
+
+    assert(table != NULL);
+
+    uint64_t capacity = *(table->capacity);
+    uint64_t index = hash(key, capacity);
+    uint64_t hop = get_slot(table, index)[0];
+
+    while(hop != 0)
+    {
+        uint64_t d = __builtin_ctzl(hop);
+        uint64_t *s = get_slot(table, wrap(index + d, capacity));
+
+        if(s[2] == key) return s + 3;
+
+        hop &= hop - 1;
+    }
+
+    return NULL;
+
+}
+
+
+/*
+    Move the empty slot at distance free_dist from its start slot closer. Look at the HOP_RANGE-1
+    home slots before the empty slot, starting with the furthest one, for an item that sits
+    before the empty slot and would still be within its own neighborhood after moving into it.
+    Returns the new empty slot, or capacity if no item can be moved (table needs to be rebuilt).
+*/
+static uint64_t
+hop_back(hopscotch_table_t *table, const uint64_t free)
+{
+    uint64_t capacity = *(table->capacity);
+    uint64_t nvals_per_item = *(table->nvals_per_item);
+    uint64_t dist, j;
+
+    for(dist = HOP_RANGE - 1; dist > 0; dist--)
+    {
+        uint64_t home = wrap(free + capacity - dist, capacity);
+        uint64_t *h = get_slot(table, home);
+
+        // only items of this home slot that are before the empty slot (offset < dist) can move into it
+        uint64_t movable = h[0] & ((1UL << dist) - 1);
+
+        if(movable == 0) continue;
+
+        uint64_t offset = __builtin_ctzl(movable);
+        uint64_t from = wrap(home + offset, capacity);
+        uint64_t *src = get_slot(table, from);
+        uint64_t *dst = get_slot(table, free);
+
+        dst[1] = 1;
+        for(j = 1; j < nvals_per_item; j++)
+        {
+            dst[1 + j] = src[1 + j]; // key and values
+        }
+        src[1] = 0;
+
+        h[0] &= ~(1UL << offset);
+        h[0] |= (1UL << dist);
+
+        return from;
+    }
+
+    return capacity;
+}
+
+
+// insert a new item into the table (overwrites the values if the key is already present)
+bool
+hopscotch_insert_item(hopscotch_table_t *table, const uint64_t key, const uint64_t *values)
+{
+
+    assert(table != NULL);
+
+    uint64_t capacity = *(table->capacity);
+    uint64_t nvals_per_item = *(table->nvals_per_item);
+    uint64_t index = hash(key, capacity);
+    uint64_t i, j, dist, free;
+    uint64_t *vals, *s;
+
+    vals = hopscotch_lookup_item(table, key);
+    if(vals != NULL)
+    {
+        for(j = 0; j < nvals_per_item - 2; j++)
+        {
+            vals[j] = values[j];
+        }
+        return true;
+    }
+
+    /* linear probe for the leading empty slot */
+    uint64_t max_dist = (capacity < HOP_ADD_RANGE) ? capacity : HOP_ADD_RANGE;
+    for(i = 0; i < max_dist; i++)
+    {
+        if(get_slot(table, wrap(index + i, capacity))[1] == 0) break;
+    }
+
+    if(i == max_dist)
+    {
+        printf("\n Warning! Unable to insert new item with key: %lu. No empty slot within %lu slots of home. \n",key,max_dist);
+        return false;
+    }
+
+    /* hop the empty slot back into the neighborhood of the home slot */
+    free = wrap(index + i, capacity);
+    dist = i;
+    while(dist >= HOP_RANGE)
+    {
+        uint64_t next = hop_back(table, free);
+
+        if(next == capacity)
+        {
+            printf("\n Warning! Unable to insert new item with key: %lu. Neighborhood is full. \n",key);
+            return false;
+        }
+
+        dist -= (free + capacity - next) % capacity;
+        free = next;
+    }
+
+    s = get_slot(table, free);
+    s[1] = 1;
+    s[2] = key;
+    for(j = 0; j < nvals_per_item - 2; j++)
+    {
+        s[3 + j] = values[j];
+    }
+
+    get_slot(table, index)[0] |= (1UL << dist);
+
+    return true;
+
+}
+
+
+bool
+hopscotch_delete_item(hopscotch_table_t *table, const uint64_t key)
+{
+
+    assert(table != NULL);
+
+    uint64_t capacity = *(table->capacity);
+    uint64_t index = hash(key, capacity);
+    uint64_t *h = get_slot(table, index);
+    uint64_t hop = h[0];
+
+    while(hop != 0)
+    {
+        uint64_t d = __builtin_ctzl(hop);
+        uint64_t *s = get_slot(table, wrap(index + d, capacity));
+
+        if(s[2] == key)
+        {
+            s[1] = 0;
+            h[0] &= ~(1UL << d);
+            return true;
+        }
+
+        hop &= hop - 1;
+    }
+
+    return false;
+
+}
@@ -0,0 +1,24 @@
+
+
+// hopscotch hash table: every item lives within HOP_RANGE slots of its home slot
+#define HOP_RANGE 32 // neighborhood size H (<= 64)
+
+
+typedef struct hopscotch_table_st
+{
+    uint64_t * capacity;       // max number of items
+    uint64_t * nvals_per_item; // number of values per item (status + key + values, same as hashtable_t)
+
+} hopscotch_table_t;
+
+
+// function prototypes
+uint64_t hopscotch_table_bytes(const uint64_t table_capacity, const uint64_t nvals_per_item);
+
+void init_hopscotch_table(hopscotch_table_t *table, void *base_ptr, const uint64_t table_capacity, const uint64_t nvals_per_item);
+
+bool hopscotch_insert_item(hopscotch_table_t *table, const uint64_t key, const uint64_t *values);
+
+uint64_t *hopscotch_lookup_item(const hopscotch_table_t *table, const uint64_t key);
+
+bool hopscotch_delete_item(hopscotch_table_t *table, const uint64_t key);
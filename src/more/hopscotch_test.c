@@ -0,0 +1,80 @@
+/*
+    Test driver for the hopscotch hash table: fill the table to 95% load with
+    sequential keys, then look everything up and delete every other item.
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+# include "hash.h"
+# include "hopscotch.h"
+
+
+#define TABLE_SIZE 10000
+#define ITEM_NVALS 3 // needs to be >= 3
+
+
+
+int main()
+{
+
+    hopscotch_table_t my_table;
+
+    uint64_t table_capacity = TABLE_SIZE;
+    uint64_t nvals_per_item = ITEM_NVALS;
+    uint64_t table_bytes = hopscotch_table_bytes(table_capacity, nvals_per_item);
+    uint64_t nitems = 95 * table_capacity / 100;
+    uint64_t i, ninserted = 0, nfound = 0, nwrong = 0;
+    void * base_ptr;
+
+    printf("\n Table capacity = %lu, nvals_per_item = %lu, table_bytes = %lu \n",table_capacity,nvals_per_item,table_bytes);
+
+    base_ptr = malloc(table_bytes);
+
+    init_hopscotch_table(&my_table, base_ptr, table_capacity, nvals_per_item);
+
+
+    // testing...
+
+    for(i = 1; i <= nitems; i++)
+    {
+        uint64_t val = 3 * i;
+        ninserted += hopscotch_insert_item(&my_table, i, &val);
+    }
+    printf("\n Inserted %lu of %lu items \n",ninserted,nitems);
+
+    for(i = 1; i <= nitems; i++)
+    {
+        uint64_t *vals = hopscotch_lookup_item(&my_table, i);
+        if(vals != NULL)
+        {
+            nfound++;
+            if(vals[0] != 3 * i) nwrong++;
+        }
+    }
+    printf("\n Found %lu items (%lu with wrong values) \n",nfound,nwrong);
+
+    printf("\n Lookup of missing key %lu: %s \n",nitems + 1,hopscotch_lookup_item(&my_table, nitems + 1) ? "found" : "not found");
+    nwrong += (ninserted != nitems || nfound != ninserted || hopscotch_lookup_item(&my_table, nitems + 1) != NULL);
+
+    for(i = 1; i <= nitems; i += 2)
+    {
+        hopscotch_delete_item(&my_table, i);
+    }
+    printf("\n Deleted odd keys: key 7 %s, key 8 %s \n",hopscotch_lookup_item(&my_table, 7) ? "found" : "not found",
+                                                         hopscotch_lookup_item(&my_table, 8) ? "found" : "not found");
+
+    for(i = 1; i <= nitems; i++)
+    {
+        nwrong += ((hopscotch_lookup_item(&my_table, i) != NULL) != (i % 2 == 0));
+    }
+
+    printf("\n %s \n\n",(nwrong == 0) ? "All checks passed." : "Some checks FAILED.");
+
+    free(base_ptr);
+
+	return (nwrong == 0) ? 0 : 1;
+}
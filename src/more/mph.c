@@ -0,0 +1,464 @@
+/*
+    Frozen tables on a minimal perfect hash (PTHash style) for key sets that are built once and
+    only read afterwards.
+
+    Keys are hashed once (murmur, seeded) and split into nbuckets ~ MPH_BUCKET_C * n / log2(n)
+    buckets, skewed so that 60% of the keys land in 30% of the buckets. Every bucket gets a pilot,
+    and a key's position is mix(hash ^ pilot * MPH_PILOT_MULT) reduced to [0, table_size). At build
+    time the buckets are placed biggest first, each one trying pilots 0, 1, 2, ... until all of its
+    keys land on positions that are still free. table_size = nkeys / MPH_ALPHA is a little larger
+    than nkeys, which keeps the search short for the last buckets, and the few keys that end up on
+    positions past nkeys are sent to the free positions below it through the remap array. So every
+    key has its own row in a dense array of exactly nkeys rows: no probing, no empty slots, and a
+    lookup is one key hash plus a pilot and a row read (and a remap read for ~1% of the keys).
+
+    Rows keep the key next to its values, so lookups of keys outside the set return NULL instead
+    of some other key's values.
+
+    The table is a single block of 64-bit words, with pointers to it in mph_table_t, so it can be
+    written to a file as it is and mapped back in read-only (in the byte order of the machine):
+
+        [magic][nkeys][nvals_per_item][table_size][nbuckets][seed][pilots ...][remap ...][rows ...]
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <assert.h>
+
+# include "hash.h"
+# include "mph.h"
+
+
+#define MPH_HEADER_WORDS  6
+#define MPH_ALPHA         0.99                   // nkeys / table_size
+#define MPH_BUCKET_C      6.0                    // average bucket size is about log2(nkeys) / MPH_BUCKET_C
+#define MPH_DENSE_KEYS    0x99999999UL           // 60% of the 32-bit range: keys that go to the dense buckets
+#define MPH_PILOT_MULT    0x9e3779b97f4a7c15UL
+#define MPH_MAX_PILOT     (1UL << 24)            // give up on a seed once a bucket needs more pilots than this
+#define MPH_MAX_ATTEMPTS  16                     // seeds tried before the build fails
+
+
+
+static inline uint64_t
+mix(uint64_t x)
+{
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdUL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53UL;
+    x ^= x >> 33;
+    return x;
+}
+
+
+// x mapped onto [0, n) by a multiply instead of a modulo
+static inline uint64_t
+fast_range(const uint64_t x, const uint64_t n)
+{
+    return (uint64_t) (((unsigned __int128) x * n) >> 64);
+}
+
+
+static inline uint64_t
+table_size_of(const uint64_t nkeys)
+{
+    return (uint64_t) (nkeys / MPH_ALPHA) + 1;
+}
+
+
+static inline uint64_t
+nbuckets_of(const uint64_t nkeys)
+{
+    if(nkeys < 2) return 1;
+
+    uint64_t nbuckets = (uint64_t) (MPH_BUCKET_C * nkeys / (64 - __builtin_clzl(nkeys))) + 1;
+    return (nbuckets < nkeys) ? nbuckets : nkeys;
+}
+
+
+// bucket of a key hash: the high half picks the dense or the sparse buckets, the low half the bucket
+static inline uint64_t
+bucket_of(const uint64_t h, const uint64_t nbuckets)
+{
+    uint64_t ndense = nbuckets * 3 / 10;
+    uint64_t lo = h & 0xffffffffUL;
+
+    if(ndense == 0) return (lo * nbuckets) >> 32;
+
+    if((h >> 32) < MPH_DENSE_KEYS) return (lo * ndense) >> 32;
+
+    return ndense + ((lo * (nbuckets - ndense)) >> 32);
+}
+
+
+static inline uint64_t
+position_of(const uint64_t h, const uint64_t pilot, const uint64_t table_size)
+{
+    return fast_range(mix(h ^ (pilot * MPH_PILOT_MULT)), table_size);
+}
+
+
+// bytes of the table memory for nkeys keys
+uint64_t
+mph_table_bytes(const uint64_t nkeys, const uint64_t nvals_per_item)
+{
+    uint64_t table_size = table_size_of(nkeys);
+
+    return (MPH_HEADER_WORDS + nbuckets_of(nkeys) + (table_size - nkeys) + nkeys * (nvals_per_item - 1)) * sizeof(uint64_t);
+}
+
+
+// point the table struct at the words of a table block
+static void
+map_table(mph_table_t *table, void *base_ptr)
+{
+    uint64_t *words = base_ptr;
+
+    table->nkeys          = words + 1;
+    table->nvals_per_item = words + 2;
+    table->table_size     = words + 3;
+    table->nbuckets       = words + 4;
+    table->seed           = words + 5;
+    table->pilots         = words + MPH_HEADER_WORDS;
+    table->remap          = table->pilots + *(table->nbuckets);
+    table->rows           = table->remap + (*(table->table_size) - *(table->nkeys));
+}
+
+
+/*
+    Find a pilot for every bucket with the given seed. Returns 1 on success, 0 if some bucket
+    needs too many pilots (try another seed) and -1 if the keys aren't unique.
+*/
+static int
+place_buckets(mph_table_t *table, const uint64_t *h, uint64_t *taken, uint64_t *bucket_start, uint64_t *by_bucket, uint64_t *order)
+{
+    uint64_t nkeys = *(table->nkeys);
+    uint64_t table_size = *(table->table_size);
+    uint64_t nbuckets = *(table->nbuckets);
+    uint64_t i, j, k, b, max_size = 0;
+
+    /* counting sort of the keys by bucket */
+    for(b = 0; b <= nbuckets; b++) bucket_start[b] = 0;
+    for(i = 0; i < nkeys; i++) bucket_start[bucket_of(h[i], nbuckets) + 1]++;
+    for(b = 0; b < nbuckets; b++)
+    {
+        if(bucket_start[b + 1] > max_size) max_size = bucket_start[b + 1];
+        bucket_start[b + 1] += bucket_start[b];
+    }
+
+    // bucket b spans [bucket_start[b], bucket_start[b + 1]) of by_bucket, order serves as the fill cursors here
+    for(b = 0; b < nbuckets; b++) order[b] = bucket_start[b];
+    for(i = 0; i < nkeys; i++) by_bucket[order[bucket_of(h[i], nbuckets)]++] = i;
+
+    /* buckets by size, biggest first (counting sort again) */
+    uint64_t size_start[max_size + 2];
+    for(k = 0; k <= max_size + 1; k++) size_start[k] = 0;
+    for(b = 0; b < nbuckets; b++) size_start[max_size - (bucket_start[b + 1] - bucket_start[b]) + 1]++;
+    for(k = 0; k <= max_size; k++) size_start[k + 1] += size_start[k];
+    for(b = 0; b < nbuckets; b++) order[size_start[max_size - (bucket_start[b + 1] - bucket_start[b])]++] = b;
+
+    memset(taken, 0, (table_size + 63) / 64 * sizeof(uint64_t));
+
+    uint64_t pos[max_size + 1];
+
+    for(k = 0; k < nbuckets; k++)
+    {
+        uint64_t first = bucket_start[order[k]], size = bucket_start[order[k] + 1] - first;
+        uint64_t pilot;
+
+        if(size == 0) break; // the rest is empty too
+
+        // the key hash is a bijection, so equal hashes within a bucket mean equal keys
+        for(i = 0; i < size; i++)
+            for(j = 0; j < i; j++)
+                if(h[by_bucket[first + i]] == h[by_bucket[first + j]]) return -1;
+
+        for(pilot = 0; pilot < MPH_MAX_PILOT; pilot++)
+        {
+            for(i = 0; i < size; i++)
+            {
+                pos[i] = position_of(h[by_bucket[first + i]], pilot, table_size);
+
+                if(taken[pos[i] / 64] & (1UL << (pos[i] % 64))) break;
+                for(j = 0; j < i && pos[j] != pos[i]; j++);
+                if(j < i) break;
+            }
+
+            if(i == size) break;
+        }
+
+        if(pilot == MPH_MAX_PILOT) return 0;
+
+        table->pilots[order[k]] = pilot;
+        for(i = 0; i < size; i++) taken[pos[i] / 64] |= 1UL << (pos[i] % 64);
+    }
+
+    // buckets that got no keys keep pilot 0 (a lookup of an absent key may still land there)
+    for(; k < nbuckets; k++) table->pilots[order[k]] = 0;
+
+    return 1;
+}
+
+
+/*
+    Build a frozen table of nkeys unique keys in the memory at base_ptr (mph_table_bytes() bytes),
+    values holds nkeys rows of nvals_per_item - 2 words. Returns false if the keys aren't unique.
+*/
+bool
+mph_build(mph_table_t *table, void *base_ptr, const uint64_t *keys, const uint64_t *values, const uint64_t nkeys, const uint64_t nvals_per_item)
+{
+    assert(table != NULL && base_ptr != NULL);
+
+    uint64_t *words = base_ptr;
+    uint64_t table_size = table_size_of(nkeys);
+    uint64_t nbuckets = nbuckets_of(nkeys);
+    uint64_t row_words = nvals_per_item - 1;
+    uint64_t i, j, attempt;
+    int placed = 0;
+
+    if(nvals_per_item < 3 || (nkeys > 0 && (keys == NULL || values == NULL)))
+    {
+        printf("\n Invalid input or nvals_per_item. Unable to build frozen table. \n");
+        return false;
+    }
+
+    words[0] = MPH_MAGIC;
+    words[1] = nkeys;
+    words[2] = nvals_per_item;
+    words[3] = table_size;
+    words[4] = nbuckets;
+    words[5] = 0;
+    map_table(table, base_ptr);
+
+    uint64_t *h            = malloc(nkeys * sizeof(uint64_t) + 1);
+    uint64_t *by_bucket    = malloc(nkeys * sizeof(uint64_t) + 1);
+    uint64_t *bucket_start = malloc((nbuckets + 1) * sizeof(uint64_t));
+    uint64_t *order        = malloc(nbuckets * sizeof(uint64_t));
+    uint64_t *taken        = malloc((table_size + 63) / 64 * sizeof(uint64_t));
+
+    if(h == NULL || by_bucket == NULL || bucket_start == NULL || order == NULL || taken == NULL)
+    {
+        printf("\n Unable to allocate the work space of the frozen table build. \n");
+        free(h); free(by_bucket); free(bucket_start); free(order); free(taken);
+        return false;
+    }
+
+    for(attempt = 0; attempt < MPH_MAX_ATTEMPTS && placed == 0; attempt++)
+    {
+        *(table->seed) = murmur_hash_64(attempt, MPH_PILOT_MULT);
+
+        for(i = 0; i < nkeys; i++) h[i] = murmur_hash_64(keys[i], *(table->seed));
+
+        placed = place_buckets(table, h, taken, bucket_start, by_bucket, order);
+    }
+
+    if(placed == 1)
+    {
+        /* positions past nkeys go to the free positions below it, in order */
+        uint64_t free_pos = 0;
+        for(i = nkeys; i < table_size; i++)
+        {
+            if(taken[i / 64] & (1UL << (i % 64)))
+            {
+                while(taken[free_pos / 64] & (1UL << (free_pos % 64))) free_pos++;
+                table->remap[i - nkeys] = free_pos++;
+            }
+            else
+            {
+                table->remap[i - nkeys] = 0;
+            }
+        }
+
+        for(i = 0; i < nkeys; i++)
+        {
+            uint64_t pos = position_of(h[i], table->pilots[bucket_of(h[i], nbuckets)], table_size);
+            uint64_t *row = table->rows + ((pos < nkeys) ? pos : table->remap[pos - nkeys]) * row_words;
+
+            row[0] = keys[i];
+            for(j = 0; j < nvals_per_item - 2; j++)
+            {
+                row[1 + j] = values[i * (nvals_per_item - 2) + j];
+            }
+        }
+    }
+    else if(placed == -1)
+    {
+        printf("\n Warning! Duplicate keys, unable to build frozen table. \n");
+    }
+    else
+    {
+        printf("\n Warning! No pilots found after %u seeds, unable to build frozen table. \n",MPH_MAX_ATTEMPTS);
+    }
+
+    free(h); free(by_bucket); free(bucket_start); free(order); free(taken);
+
+    return placed == 1;
+}
+
+
+/*
+    Build a frozen table of the items of a generic hash table (expired items are left out).
+    Returns the base_ptr of the table memory (release with free()), or NULL on failure.
+*/
+void *
+freeze_table(mph_table_t *table, const hashtable_t *src)
+{
+    assert(table != NULL && src != NULL);
+
+    void *src_base = src->capacity;
+    uint64_t capacity = *(src->capacity);
+    uint64_t nvals_per_item = *(src->nvals_per_item);
+    uint64_t size_of_item = (1 + nvals_per_item) * sizeof(uint64_t);
+    uint64_t now = (src->expiry != NULL) ? hash_time_now() : 0;
+    uint64_t i, j, n = 0, *p;
+
+    for(i = 0; i < capacity; i++)
+    {
+        p = src_base + 3*sizeof(uint64_t) + i*size_of_item;
+        if(slot_state(src, p) == 1 && !(src->expiry != NULL && src->expiry[i] != 0 && src->expiry[i] <= now)) n++;
+    }
+
+    uint64_t *keys   = malloc(n * sizeof(uint64_t) + 1);
+    uint64_t *values = malloc(n * (nvals_per_item - 2) * sizeof(uint64_t) + 1);
+    void *base_ptr   = malloc(mph_table_bytes(n, nvals_per_item));
+
+    if(keys == NULL || values == NULL || base_ptr == NULL)
+    {
+        printf("\n Unable to allocate %lu bytes for the frozen table. \n",mph_table_bytes(n, nvals_per_item));
+        free(keys); free(values); free(base_ptr);
+        return NULL;
+    }
+
+    for(i = 0, n = 0; i < capacity; i++)
+    {
+        p = src_base + 3*sizeof(uint64_t) + i*size_of_item;
+        if(slot_state(src, p) != 1 || (src->expiry != NULL && src->expiry[i] != 0 && src->expiry[i] <= now)) continue;
+
+        keys[n] = p[1];
+        for(j = 0; j < nvals_per_item - 2; j++)
+        {
+            values[n * (nvals_per_item - 2) + j] = p[2 + j];
+        }
+        n++;
+    }
+
+    if(!mph_build(table, base_ptr, keys, values, n, nvals_per_item))
+    {
+        free(base_ptr);
+        base_ptr = NULL;
+    }
+
+    free(keys);
+    free(values);
+
+    return base_ptr;
+}
+
+
+// attach to a table block of nbytes bytes (e.g. read from a file), checks the header against the size
+bool
+attach_mph_table(mph_table_t *table, void *base_ptr, const uint64_t nbytes)
+{
+    uint64_t *words = base_ptr;
+
+    if(nbytes < MPH_HEADER_WORDS * sizeof(uint64_t) || words[0] != MPH_MAGIC || words[2] < 3 ||
+       words[3] != table_size_of(words[1]) || words[4] != nbuckets_of(words[1]) || nbytes != mph_table_bytes(words[1], words[2]))
+    {
+        printf("\n Warning! Not a frozen table, or a truncated one. \n");
+        return false;
+    }
+
+    map_table(table, base_ptr);
+
+    return true;
+}
+
+
+// values of key (NULL if absent)
+uint64_t *
+mph_lookup(const mph_table_t *table, const uint64_t key)
+{
+    uint64_t nkeys = *(table->nkeys);
+    uint64_t h = murmur_hash_64(key, *(table->seed));
+    uint64_t pos = position_of(h, table->pilots[bucket_of(h, *(table->nbuckets))], *(table->table_size));
+
+    if(nkeys == 0) return NULL;
+
+    if(pos >= nkeys) pos = table->remap[pos - nkeys];
+
+    uint64_t *row = table->rows + pos * (*(table->nvals_per_item) - 1);
+
+    return (row[0] == key) ? row + 1 : NULL;
+}
+
+
+// write the table block to a file
+bool
+mph_save(const mph_table_t *table, const char *path)
+{
+    uint64_t nbytes = mph_table_bytes(*(table->nkeys), *(table->nvals_per_item));
+    FILE *file = fopen(path, "wb");
+    bool ok;
+
+    if(file == NULL)
+    {
+        printf("\n Warning! Unable to open %s for writing. \n",path);
+        return false;
+    }
+
+    ok = fwrite(table->nkeys - 1, 1, nbytes, file) == nbytes;
+    ok = (fclose(file) == 0) && ok;
+
+    if(!ok) printf("\n Warning! Unable to write the frozen table to %s. \n",path);
+
+    return ok;
+}
+
+
+// map a table file read-only and attach to it, returns the mapping (NULL on failure)
+void *
+mph_map(mph_table_t *table, const char *path)
+{
+    struct stat st;
+    void *map;
+    int fd = open(path, O_RDONLY);
+
+    if(fd < 0 || fstat(fd, &st) != 0)
+    {
+        printf("\n Warning! Unable to open %s. \n",path);
+        if(fd >= 0) close(fd);
+        return NULL;
+    }
+
+    map = (st.st_size > 0) ? mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+    close(fd);
+
+    if(map == MAP_FAILED)
+    {
+        printf("\n Warning! Unable to map %s. \n",path);
+        return NULL;
+    }
+
+    if(!attach_mph_table(table, map, st.st_size))
+    {
+        munmap(map, st.st_size);
+        return NULL;
+    }
+
+    return map;
+}
+
+
+void
+mph_unmap(mph_table_t *table)
+{
+    munmap(table->nkeys - 1, mph_table_bytes(*(table->nkeys), *(table->nvals_per_item)));
+}
@@ -0,0 +1,36 @@
+
+
+// frozen (read-only) table on a minimal perfect hash: n keys map to n dense rows without collisions
+#define MPH_MAGIC 0x6d70687461626c65UL // "mphtable"
+
+
+typedef struct mph_table_st
+{
+    uint64_t * nkeys;          // number of keys (and rows)
+    uint64_t * nvals_per_item; // number of values per item, same meaning as in hashtable_t (rows hold key + nvals_per_item - 2 values)
+    uint64_t * table_size;     // range of the pilot hash (> nkeys, positions past nkeys are remapped)
+    uint64_t * nbuckets;       // number of pilots
+    uint64_t * seed;           // seed of the key hash
+    uint64_t * pilots;         // pilot of every bucket
+    uint64_t * remap;          // row of every position in [nkeys, table_size)
+    uint64_t * rows;           // [key][values...] of every key
+
+} mph_table_t;
+
+
+// function prototypes
+uint64_t mph_table_bytes(const uint64_t nkeys, const uint64_t nvals_per_item);
+
+bool mph_build(mph_table_t *table, void *base_ptr, const uint64_t *keys, const uint64_t *values, const uint64_t nkeys, const uint64_t nvals_per_item);
+
+void *freeze_table(mph_table_t *table, const hashtable_t *src);
+
+bool attach_mph_table(mph_table_t *table, void *base_ptr, const uint64_t nbytes);
+
+uint64_t *mph_lookup(const mph_table_t *table, const uint64_t key);
+
+bool mph_save(const mph_table_t *table, const char *path);
+
+void *mph_map(mph_table_t *table, const char *path);
+
+void mph_unmap(mph_table_t *table);
@@ -0,0 +1,144 @@
+/*
+    Test driver for the frozen (minimal perfect hash) table: build one from a key array, look
+    up every key and some absent ones, save it to a file and map it back in, then freeze a
+    generic hash table and check it against the original.
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <time.h>
+
+# include "hash.h"
+# include "mph.h"
+
+
+#define NKEYS      1000000
+#define ITEM_NVALS 4 // needs to be >= 3
+#define TABLE_FILE "mph_test.bin"
+
+
+
+double
+seconds(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + 1e-9 * t.tv_nsec;
+}
+
+
+// lookups of all keys (and as many absent ones), returns the number of wrong answers
+uint64_t
+check_table(const mph_table_t *table, const uint64_t *keys, const uint64_t nkeys)
+{
+    uint64_t i, nwrong = 0;
+    double t0 = seconds();
+
+    for(i = 0; i < nkeys; i++)
+    {
+        uint64_t *vals = mph_lookup(table, keys[i]);
+        if(vals == NULL || vals[0] != 3 * keys[i] || vals[1] != i) nwrong++;
+    }
+
+    double t1 = seconds();
+
+    for(i = 0; i < nkeys; i++)
+    {
+        if(mph_lookup(table, keys[i] + 1) != NULL) nwrong++; // keys are all even
+    }
+
+    printf("\n Looked up %lu keys (%.1f ns per lookup) and %lu absent keys, %lu wrong answers \n",nkeys,1e9 * (t1 - t0) / nkeys,nkeys,nwrong);
+
+    return nwrong;
+}
+
+
+int main()
+{
+
+    mph_table_t my_table, mapped_table, frozen_table;
+
+    uint64_t nvals_per_item = ITEM_NVALS;
+    uint64_t nkeys = NKEYS;
+    uint64_t table_bytes = mph_table_bytes(nkeys, nvals_per_item);
+    uint64_t i;
+
+    uint64_t *keys = malloc(nkeys * sizeof(uint64_t));
+    uint64_t *values = malloc(nkeys * (nvals_per_item - 2) * sizeof(uint64_t));
+    void *base_ptr = malloc(table_bytes);
+
+    for(i = 0; i < nkeys; i++)
+    {
+        keys[i] = 2 * murmur_hash_64(i, 1);
+        values[i * (nvals_per_item - 2)] = 3 * keys[i];
+        values[i * (nvals_per_item - 2) + 1] = i;
+    }
+
+
+    // testing...
+
+    double t0 = seconds();
+    bool ok = mph_build(&my_table, base_ptr, keys, values, nkeys, nvals_per_item);
+    double t1 = seconds();
+
+    printf("\n Built frozen table of %lu keys: %s in %.3f s, %lu buckets, %.1f bits per key on top of the rows \n",
+           nkeys,ok ? "ok" : "failed",t1 - t0,*(my_table.nbuckets),8.0 * (table_bytes - nkeys * (nvals_per_item - 1) * sizeof(uint64_t)) / nkeys);
+
+    if(!ok) return 1;
+
+    uint64_t nwrong = check_table(&my_table, keys, nkeys);
+
+    keys[1] = keys[0];
+    printf("\n Build with a duplicate key: %s \n",mph_build(&mapped_table, base_ptr, keys, values, nkeys, nvals_per_item) ? "ok" : "failed");
+    keys[1] = 2 * murmur_hash_64(1, 1);
+    mph_build(&my_table, base_ptr, keys, values, nkeys, nvals_per_item);
+
+    /* save and map back in */
+    if(mph_save(&my_table, TABLE_FILE) && mph_map(&mapped_table, TABLE_FILE) != NULL)
+    {
+        printf("\n Mapped %s \n",TABLE_FILE);
+        nwrong += check_table(&mapped_table, keys, nkeys);
+        mph_unmap(&mapped_table);
+    }
+    else
+    {
+        nwrong++;
+    }
+    remove(TABLE_FILE);
+
+    /* freeze a generic hash table holding the same items */
+    hashtable_t src;
+    uint64_t capacity = 2 * nkeys;
+    void *src_ptr = malloc(2 * sizeof(uint64_t) + capacity * (1 + nvals_per_item) * sizeof(uint64_t));
+
+    init_hash_table(&src, src_ptr, capacity, nvals_per_item);
+    for(i = 0; i < nkeys; i++)
+    {
+        uint64_t *vals = find_or_insert(&src, keys[i], NULL);
+        vals[0] = 3 * keys[i];
+        vals[1] = i;
+    }
+
+    void *frozen_ptr = freeze_table(&frozen_table, &src);
+    printf("\n Froze generic table: %s (%lu keys) \n",frozen_ptr ? "ok" : "failed",frozen_ptr ? *(frozen_table.nkeys) : 0);
+    if(frozen_ptr != NULL)
+    {
+        nwrong += check_table(&frozen_table, keys, nkeys);
+    }
+    else
+    {
+        nwrong++;
+    }
+
+    free(frozen_ptr);
+    free(src.items);
+    free(src_ptr);
+    free(base_ptr);
+    free(values);
+    free(keys);
+
+	return nwrong != 0;
+}
@@ -0,0 +1,489 @@
+/*
+    Tiered variant of the generic hash table, for tables larger than memory.
+
+    The slot array lives in a file and is split into fixed size pages of slots_per_page slots.
+    Only a bounded number of pages (ncached frames) are kept in memory; the rest are read in with
+    pread() when a probe needs them, and the page whose frame is taken over (chosen by a CLOCK hand
+    over the frames, the same scheme as the cache mode of the generic table) is written back first
+    if it was modified. This replaces swapping with explicit, counted I/O of whole pages, and
+    keeps the page cache of the kernel out of the way: the file is opened with O_DIRECT (frames,
+    page sizes and file offsets are all multiples of TIERED_BLOCK_BYTES), so pages aren't cached
+    a second time by the kernel. Where the file system doesn't support O_DIRECT the file is
+    opened normally, for random access (no readahead), and the kernel caches what is read.
+
+    A key's home slot is hash(key, capacity) as in the generic table, but the probe sequence
+    stays within its page: it wraps around inside the home page, and only once the whole page is
+    taken does it continue with the next page. So a lookup touches exactly one page unless its
+    page is full, and the pages of a table far below capacity are hardly ever full.
+
+    File layout: a header page, [magic][capacity][nvals_per_item][page_bytes][npages][nitems]
+    [ntombstones] followed by zeros, and then the npages pages of slots. A slot is [status][key]
+    [values...] (nvals_per_item words, status 0 = empty, 1 = occupied, 2 = deleted), so a new,
+    all-zero (sparse) file is an empty table. The header is only brought up to date by
+    tiered_flush() and tiered_close().
+
+    Pointers returned by tiered_lookup_item() point into the page cache and are only good until
+    the next call on the table. Not thread safe.
+*/
+
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <assert.h>
+
+# include "hash.h"
+# include "tiered.h"
+
+
+#define TIERED_BLOCK_BYTES  4096 // page sizes have to be a multiple of this
+
+
+
+static inline uint64_t
+page_offset(const tiered_table_t *table, const uint64_t page)
+{
+    return (1 + page) * table->page_bytes; // page 0 of the file is the header
+}
+
+
+static bool
+write_frame(tiered_table_t *table, const uint64_t frame)
+{
+    uint64_t page = table->frame_page[frame];
+    uint64_t t0 = hash_time_now();
+    ssize_t n = pwrite(table->fd, (char *) table->frames + frame * table->page_bytes, table->page_bytes, page_offset(table, page));
+
+    table->stats.io_ns += hash_time_now() - t0;
+
+    if(n != (ssize_t) table->page_bytes)
+    {
+        printf("\n Warning! Unable to write page %lu of the tiered table. \n",page);
+        return false;
+    }
+
+    table->frame_dirty[frame] = 0;
+    table->stats.pages_written++;
+    table->stats.bytes_written += table->page_bytes;
+
+    return true;
+}
+
+
+// frame to load a page into: an empty one, or the first one the CLOCK hand finds with a clear access bit
+static uint64_t
+victim_frame(tiered_table_t *table)
+{
+    for(;;)
+    {
+        uint64_t frame = table->hand;
+        table->hand = (table->hand + 1 == table->ncached) ? 0 : table->hand + 1;
+
+        if(table->frame_page[frame] == TIERED_NO_PAGE) return frame;
+
+        if(table->frame_ref[frame])
+        {
+            table->frame_ref[frame] = 0;
+            continue;
+        }
+
+        return frame;
+    }
+}
+
+
+// slots of a page, read in if it isn't cached (NULL on I/O errors), write marks the page dirty
+static uint64_t *
+get_page(tiered_table_t *table, const uint64_t page, const bool write)
+{
+    uint64_t frame;
+    uint64_t *slots;
+
+    if(table->page_frame[page] != 0)
+    {
+        frame = table->page_frame[page] - 1;
+        table->stats.page_hits++;
+    }
+    else
+    {
+        frame = victim_frame(table);
+
+        if(table->frame_page[frame] != TIERED_NO_PAGE)
+        {
+            if(table->frame_dirty[frame] && !write_frame(table, frame)) return NULL;
+
+            table->page_frame[table->frame_page[frame]] = 0;
+            table->frame_page[frame] = TIERED_NO_PAGE;
+            table->stats.evictions++;
+        }
+
+        slots = table->frames + frame * (table->page_bytes / sizeof(uint64_t));
+
+        uint64_t t0 = hash_time_now();
+        ssize_t n = pread(table->fd, slots, table->page_bytes, page_offset(table, page));
+        table->stats.io_ns += hash_time_now() - t0;
+
+        if(n < 0)
+        {
+            printf("\n Warning! Unable to read page %lu of the tiered table. \n",page);
+            return NULL;
+        }
+        // past the end of the file reads as empty slots
+        if(n < (ssize_t) table->page_bytes) memset((char *) slots + n, 0, table->page_bytes - n);
+
+        table->frame_page[frame] = page;
+        table->frame_dirty[frame] = 0;
+        table->page_frame[page] = frame + 1;
+        table->stats.page_misses++;
+        table->stats.pages_read++;
+        table->stats.bytes_read += table->page_bytes;
+    }
+
+    table->frame_ref[frame] = 1;
+    if(write) table->frame_dirty[frame] = 1;
+
+    return table->frames + frame * (table->page_bytes / sizeof(uint64_t));
+}
+
+
+// open the table file, bypassing the kernel page cache if the file system allows it
+static int
+open_file(tiered_table_t *table, const char *path, const int flags)
+{
+    table->direct = false;
+
+#ifdef O_DIRECT
+    int fd = open(path, flags | O_DIRECT, 0644);
+
+    if(fd >= 0)
+    {
+        table->direct = true;
+        return fd;
+    }
+#endif
+
+    return open(path, flags, 0644);
+}
+
+
+static bool
+init_cache(tiered_table_t *table, const uint64_t ncached)
+{
+    uint64_t i;
+
+    table->ncached = (ncached < 1) ? 1 : (ncached > table->npages) ? table->npages : ncached;
+    table->hand = 0;
+    table->stats = (tiered_stats_t) {0};
+
+    table->frames      = aligned_alloc(TIERED_BLOCK_BYTES, table->ncached * table->page_bytes);
+    table->frame_page  = malloc(table->ncached * sizeof(uint64_t));
+    table->frame_ref   = calloc(table->ncached, 1);
+    table->frame_dirty = calloc(table->ncached, 1);
+    table->page_frame  = calloc(table->npages, sizeof(uint64_t));
+
+    if(table->frames == NULL || table->frame_page == NULL || table->frame_ref == NULL || table->frame_dirty == NULL || table->page_frame == NULL)
+    {
+        printf("\n Unable to allocate a page cache of %lu pages for the tiered table. \n",table->ncached);
+        free(table->frames); free(table->frame_page); free(table->frame_ref); free(table->frame_dirty); free(table->page_frame);
+        return false;
+    }
+
+    for(i = 0; i < table->ncached; i++) table->frame_page[i] = TIERED_NO_PAGE;
+
+    // the cache does the caching, kernel readahead would only read pages nobody asked for
+    if(!table->direct) posix_fadvise(table->fd, 0, 0, POSIX_FADV_RANDOM);
+
+    return true;
+}
+
+
+/*
+    Create an empty table of (at least) table_capacity slots in a new file at path, with pages of
+    page_bytes bytes (a multiple of 4096) and a cache of ncached pages.
+*/
+bool
+tiered_create(tiered_table_t *table, const char *path, const uint64_t table_capacity, const uint64_t nvals_per_item, const uint64_t page_bytes, const uint64_t ncached)
+{
+    assert(table != NULL && path != NULL);
+
+    if(nvals_per_item < 3 || table_capacity < 1 || page_bytes == 0 || page_bytes % TIERED_BLOCK_BYTES != 0 || page_bytes < nvals_per_item * sizeof(uint64_t))
+    {
+        printf("\n Invalid table_capacity, nvals_per_item or page_bytes. Unable to create tiered table. \n");
+        return false;
+    }
+
+    table->nvals_per_item = nvals_per_item;
+    table->page_bytes = page_bytes;
+    table->slots_per_page = page_bytes / (nvals_per_item * sizeof(uint64_t));
+    table->npages = (table_capacity + table->slots_per_page - 1) / table->slots_per_page;
+    table->capacity = table->npages * table->slots_per_page;
+    table->nitems = 0;
+    table->ntombstones = 0;
+
+    table->fd = open_file(table, path, O_RDWR | O_CREAT | O_TRUNC);
+
+    // a sparse file of zeros, i.e. all slots empty
+    if(table->fd < 0 || ftruncate(table->fd, page_offset(table, table->npages)) != 0)
+    {
+        printf("\n Warning! Unable to create tiered table file %s. \n",path);
+        if(table->fd >= 0) close(table->fd);
+        return false;
+    }
+
+    if(!init_cache(table, ncached))
+    {
+        close(table->fd);
+        return false;
+    }
+
+    return tiered_flush(table);
+}
+
+
+// open a table file written by tiered_create() / tiered_close(), with a cache of ncached pages
+bool
+tiered_open(tiered_table_t *table, const char *path, const uint64_t ncached)
+{
+    assert(table != NULL && path != NULL);
+
+    // O_DIRECT reads whole blocks into aligned memory only
+    uint64_t header[TIERED_BLOCK_BYTES / sizeof(uint64_t)] __attribute__((aligned(TIERED_BLOCK_BYTES)));
+
+    table->fd = open_file(table, path, O_RDWR);
+
+    if(table->fd < 0 || pread(table->fd, header, sizeof(header), 0) != sizeof(header) || header[0] != TIERED_MAGIC ||
+       header[2] < 3 || header[3] == 0 || header[3] % TIERED_BLOCK_BYTES != 0 || header[3] < header[2] * sizeof(uint64_t))
+    {
+        printf("\n Warning! %s is not a tiered table file. \n",path);
+        if(table->fd >= 0) close(table->fd);
+        return false;
+    }
+
+    table->capacity = header[1];
+    table->nvals_per_item = header[2];
+    table->page_bytes = header[3];
+    table->npages = header[4];
+    table->nitems = header[5];
+    table->ntombstones = header[6];
+    table->slots_per_page = table->page_bytes / (table->nvals_per_item * sizeof(uint64_t));
+
+    if(!init_cache(table, ncached))
+    {
+        close(table->fd);
+        return false;
+    }
+
+    return true;
+}
+
+
+/*
+    Probe for key. Returns the page and slot of the key if it's in the table (found = true),
+    or else of the slot a new item with that key goes into (the first deleted slot on the probe
+    path, or else the empty slot that ended it). Returns false if the table is full or on I/O
+    errors.
+*/
+static bool
+probe(tiered_table_t *table, const uint64_t key, uint64_t *page_out, uint64_t *slot_out, bool *found)
+{
+    uint64_t index = hash(key, table->capacity);
+    uint64_t page = index / table->slots_per_page;
+    uint64_t start = index % table->slots_per_page;
+    uint64_t nvals_per_item = table->nvals_per_item;
+    uint64_t i, k, *slots, *p;
+    bool have_deleted = false;
+
+    *found = false;
+
+    for(i = 0; i < table->npages; i++)
+    {
+        slots = get_page(table, page, false);
+        if(slots == NULL) return false;
+
+        for(k = 0; k < table->slots_per_page; k++)
+        {
+            uint64_t slot = (start + k < table->slots_per_page) ? start + k : start + k - table->slots_per_page;
+            p = slots + slot * nvals_per_item;
+
+            if(p[0] == 1 && p[1] == key)
+            {
+                *page_out = page;
+                *slot_out = slot;
+                *found = true;
+                return true;
+            }
+
+            if(p[0] == 2 && !have_deleted)
+            {
+                *page_out = page;
+                *slot_out = slot;
+                have_deleted = true;
+            }
+
+            if(p[0] == 0)
+            {
+                if(!have_deleted)
+                {
+                    *page_out = page;
+                    *slot_out = slot;
+                }
+                return true;
+            }
+        }
+
+        // the whole page is taken, go on with the next one
+        page = (page + 1 == table->npages) ? 0 : page + 1;
+        start = 0;
+    }
+
+    return have_deleted;
+}
+
+
+// insert an item, or update the values of an existing one
+bool
+tiered_insert_item(tiered_table_t *table, const uint64_t key, const uint64_t *values)
+{
+    assert(table != NULL);
+
+    uint64_t page, slot, j, *p;
+    bool found;
+
+    if(!probe(table, key, &page, &slot, &found))
+    {
+        printf("\n Warning! Unable to insert new item with key: %lu. Ran out of empty slots. \n",key);
+        return false;
+    }
+
+    // the probe may have moved on to other pages since, fetch the page again
+    uint64_t *slots = get_page(table, page, true);
+    if(slots == NULL) return false;
+
+    p = slots + slot * table->nvals_per_item;
+
+    if(!found)
+    {
+        if(p[0] == 2) table->ntombstones--;
+        p[0] = 1;
+        p[1] = key;
+        table->nitems++;
+    }
+
+    for(j = 0; j < table->nvals_per_item - 2; j++)
+    {
+        p[2 + j] = values[j];
+    }
+
+    return true;
+}
+
+
+// values of key (NULL if absent), only good until the next call on the table
+uint64_t *
+tiered_lookup_item(tiered_table_t *table, const uint64_t key)
+{
+    assert(table != NULL);
+
+    uint64_t page, slot, *slots;
+    bool found;
+
+    if(!probe(table, key, &page, &slot, &found) || !found) return NULL;
+
+    slots = get_page(table, page, false);
+
+    return (slots != NULL) ? slots + slot * table->nvals_per_item + 2 : NULL;
+}
+
+
+bool
+tiered_delete_item(tiered_table_t *table, const uint64_t key)
+{
+    assert(table != NULL);
+
+    uint64_t page, slot, *slots;
+    bool found;
+
+    if(!probe(table, key, &page, &slot, &found) || !found) return false;
+
+    slots = get_page(table, page, true);
+    if(slots == NULL) return false;
+
+    slots[slot * table->nvals_per_item] = 2;
+    table->nitems--;
+    table->ntombstones++;
+
+    return true;
+}
+
+
+// write all dirty pages and the header to the file
+bool
+tiered_flush(tiered_table_t *table)
+{
+    assert(table != NULL);
+
+    uint64_t header[TIERED_BLOCK_BYTES / sizeof(uint64_t)] __attribute__((aligned(TIERED_BLOCK_BYTES))) =
+        {TIERED_MAGIC, table->capacity, table->nvals_per_item, table->page_bytes, table->npages, table->nitems, table->ntombstones};
+    uint64_t i;
+    bool ok = true;
+
+    for(i = 0; i < table->ncached; i++)
+    {
+        if(table->frame_page[i] != TIERED_NO_PAGE && table->frame_dirty[i]) ok = write_frame(table, i) && ok;
+    }
+
+    if(pwrite(table->fd, header, sizeof(header), 0) != sizeof(header))
+    {
+        printf("\n Warning! Unable to write the header of the tiered table. \n");
+        ok = false;
+    }
+
+    return ok;
+}
+
+
+// flush the table and release the page cache
+bool
+tiered_close(tiered_table_t *table)
+{
+    assert(table != NULL);
+
+    bool ok = tiered_flush(table);
+
+    ok = (close(table->fd) == 0) && ok;
+
+    free(table->frames);
+    free(table->frame_page);
+    free(table->frame_ref);
+    free(table->frame_dirty);
+    free(table->page_frame);
+    table->frames = NULL;
+
+    return ok;
+}
+
+
+void
+tiered_stats(const tiered_table_t *table, tiered_stats_t *stats)
+{
+    *stats = table->stats;
+}
+
+
+void
+print_tiered_stats(const tiered_table_t *table)
+{
+    const tiered_stats_t *s = &table->stats;
+    uint64_t naccesses = s->page_hits + s->page_misses;
+    uint64_t nios = s->pages_read + s->pages_written;
+
+    printf("\n Tiered table: %lu items in %lu pages of %lu slots, %lu pages cached \n",table->nitems,table->npages,table->slots_per_page,table->ncached);
+    printf(" page hit rate = %.4f (%lu hits, %lu misses), %lu evictions \n",naccesses ? (double) s->page_hits / naccesses : 0.0,s->page_hits,s->page_misses,s->evictions);
+    printf(" read %lu pages (%.1f MB), wrote %lu pages (%.1f MB), %.1f us per page I/O \n",s->pages_read,s->bytes_read / 1048576.0,
+           s->pages_written,s->bytes_written / 1048576.0,nios ? s->io_ns / 1000.0 / nios : 0.0);
+}
@@ -0,0 +1,63 @@
+
+
+// tiered table: the slot array lives in a file, split into fixed size pages, with a bounded cache of pages in memory
+#define TIERED_MAGIC 0x7469657265647462UL // "tieredtb"
+#define TIERED_NO_PAGE UINT64_MAX          // frame_page of an empty frame
+
+
+// page cache and I/O counters, as reported by tiered_stats()
+typedef struct tiered_stats_st
+{
+    uint64_t page_hits;        // page accesses served by the cache
+    uint64_t page_misses;      // page accesses that had to read the page
+    uint64_t evictions;        // pages dropped from the cache
+    uint64_t pages_read;
+    uint64_t pages_written;    // dirty pages written back (on eviction or flush)
+    uint64_t bytes_read;
+    uint64_t bytes_written;
+    uint64_t io_ns;            // time spent in pread()/pwrite()
+
+} tiered_stats_t;
+
+
+typedef struct tiered_table_st
+{
+    int fd;                    // table file
+    bool direct;               // fd was opened with O_DIRECT, bypassing the kernel page cache
+    uint64_t capacity;         // number of slots (npages * slots_per_page)
+    uint64_t nvals_per_item;   // number of words per slot (status + key + values, same as hashtable_t)
+    uint64_t page_bytes;       // size of a page in the file and in the cache
+    uint64_t slots_per_page;
+    uint64_t npages;
+    uint64_t nitems;
+    uint64_t ntombstones;      // deleted slots (reused by inserts)
+    uint64_t ncached;          // number of page frames in the cache
+    uint64_t * frames;         // ncached pages worth of memory
+    uint64_t * frame_page;     // page held by every frame (TIERED_NO_PAGE if none)
+    uint8_t * frame_ref;       // CLOCK access bit of every frame
+    uint8_t * frame_dirty;     // frame has been written since it was read
+    uint64_t * page_frame;     // frame of every page + 1 (0 if not cached)
+    uint64_t hand;             // CLOCK hand
+    tiered_stats_t stats;
+
+} tiered_table_t;
+
+
+// function prototypes
+bool tiered_create(tiered_table_t *table, const char *path, const uint64_t table_capacity, const uint64_t nvals_per_item, const uint64_t page_bytes, const uint64_t ncached);
+
+bool tiered_open(tiered_table_t *table, const char *path, const uint64_t ncached);
+
+bool tiered_insert_item(tiered_table_t *table, const uint64_t key, const uint64_t *values);
+
+uint64_t *tiered_lookup_item(tiered_table_t *table, const uint64_t key);
+
+bool tiered_delete_item(tiered_table_t *table, const uint64_t key);
+
+bool tiered_flush(tiered_table_t *table);
+
+bool tiered_close(tiered_table_t *table);
+
+void tiered_stats(const tiered_table_t *table, tiered_stats_t *stats);
+
+void print_tiered_stats(const tiered_table_t *table);
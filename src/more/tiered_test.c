@@ -0,0 +1,90 @@
+/*
+    Test driver for the tiered table: fill a file backed table through a page cache holding an
+    eighth of its pages, look everything up in random order, delete a share of the keys, then
+    close the table, open it again and check that everything is still there.
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+# include "hash.h"
+# include "tiered.h"
+
+
+#define CAPACITY   200000
+#define NITEMS     140000
+#define ITEM_NVALS 4 // needs to be >= 3
+#define PAGE_BYTES 16384
+#define TABLE_FILE "tiered_test.bin"
+
+
+
+// look up every key (the deleted ones, every third, only if deleted is set), returns the number of wrong answers
+uint64_t
+check_table(tiered_table_t *table, const bool deleted)
+{
+    uint64_t i, nfound = 0, nwrong = 0;
+
+    for(i = 0; i < NITEMS; i++)
+    {
+        uint64_t key = 1 + (i * 7919) % NITEMS; // all keys, in a scattered order
+        uint64_t *vals = tiered_lookup_item(table, key);
+        bool expected = !(deleted && key % 3 == 0);
+
+        if(vals != NULL) nfound++;
+        if((vals != NULL) != expected || (vals != NULL && (vals[0] != 3 * key || vals[1] != key + 1))) nwrong++;
+    }
+
+    printf("\n Found %lu of %u keys, %lu wrong answers \n",nfound,NITEMS,nwrong);
+
+    return nwrong;
+}
+
+
+int main()
+{
+
+    tiered_table_t my_table;
+
+    uint64_t npages = (CAPACITY + PAGE_BYTES / (ITEM_NVALS * 8) - 1) / (PAGE_BYTES / (ITEM_NVALS * 8));
+    uint64_t i, ninserted = 0, ndeleted = 0, nwrong = 0;
+
+    if(!tiered_create(&my_table, TABLE_FILE, CAPACITY, ITEM_NVALS, PAGE_BYTES, npages / 8)) return 1;
+    printf("\n %s opened %s \n",TABLE_FILE,my_table.direct ? "with O_DIRECT" : "buffered, O_DIRECT isn't supported here");
+
+
+    // testing...
+
+    for(i = 1; i <= NITEMS; i++)
+    {
+        uint64_t vals[2] = {3 * i, i + 1};
+        ninserted += tiered_insert_item(&my_table, i, vals);
+    }
+    printf("\n Inserted %lu of %u items (load = %.2f) \n",ninserted,NITEMS,(double) my_table.nitems / my_table.capacity);
+    print_tiered_stats(&my_table);
+
+    nwrong += check_table(&my_table, false);
+
+    for(i = 3; i <= NITEMS; i += 3)
+    {
+        ndeleted += tiered_delete_item(&my_table, i);
+    }
+    printf("\n Deleted %lu items \n",ndeleted);
+
+    nwrong += check_table(&my_table, true);
+    print_tiered_stats(&my_table);
+
+    if(!tiered_close(&my_table) || !tiered_open(&my_table, TABLE_FILE, npages / 8)) return 1;
+
+    printf("\n Reopened %s: %lu items, %lu deleted slots \n",TABLE_FILE,my_table.nitems,my_table.ntombstones);
+    nwrong += check_table(&my_table, true);
+    print_tiered_stats(&my_table);
+
+    tiered_close(&my_table);
+    remove(TABLE_FILE);
+
+	return nwrong != 0;
+}